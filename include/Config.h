@@ -5,11 +5,21 @@ constexpr int LCD_ON_TIME = 10;             // [sec.]
 constexpr float LCD_ON_LIGHT_L = 0.489f;    // Light low threshold[%]
 constexpr float LCD_ON_LIGHT_H = 0.978f;    // Light high threshold[%]
 
+constexpr bool DISPLAY_SPRITE = false;      // Compose in RAM and push by DMA
+constexpr int DISPLAY_SPRITE_BUFFER_SIZE = 2 * 320 * 40 * 2;   // RAM budget for 2 strips[byte]
+constexpr bool DISPLAY_GLYPH_CACHE = false; // Draw the numeric readouts from 1bpp glyph sprites (about 15KB, frame time not measured on the device yet)
+constexpr bool DISPLAY_TIMING_LOG = false;  // Print chart and frame timing to the console (shared with the CLI)
+constexpr bool STATS_LOG = false;           // Print scheduler, sensor, Wi-Fi, radio, memory (incl. low water) and publish stats every minute
+
 constexpr float TEMP_OFFSET = 2.2f;		    // Temperature offset[C]
 
+constexpr int SCD30_MEASUREMENT_INTERVAL = 2;   // [sec.] 2-1800
+constexpr int SCD30_POLL_INTERVAL = 50;         // Polling period while waiting for data[msec.]
+
 constexpr int CO2_AVERAGE_NUMBER = 5;
 constexpr int HUMI_AVERAGE_NUMBER = 5;
 constexpr int TEMP_AVERAGE_NUMBER = 5;
+constexpr int AVERAGE_NUMBER_MAX = 30;      // Upper limit of the *AverageNumber properties
 
 constexpr int CO2_SERIES_INVERVAL = 15;     // [sec.]
 constexpr int WBGT_SERIES_INVERVAL = 15;    // [sec.]
@@ -17,9 +27,45 @@ constexpr int WBGT_SERIES_INVERVAL = 15;    // [sec.]
 constexpr int CO2_SERIES_NUMBER = 240;
 constexpr int WBGT_SERIES_NUMBER = 240;
 
+constexpr int SERIES_MIN5_NUMBER = 144;     // 5分毎 12時間分
+constexpr int SERIES_HOUR1_NUMBER = 168;    // 1時間毎 7日分
+constexpr int SERIES_DAY1_NUMBER = 31;      // 1日毎 31日分
+
+constexpr bool RADIO_POWER_SAVE = true;     // Modem-sleep the RTL8720 between wake windows
+constexpr int RADIO_POWER_SAVE_MIN_INTERVAL = 30;   // Power save only when TelemetryInterval is at least this[sec.]
+constexpr unsigned long RADIO_WAKE_WINDOW = 1000;   // Stay awake this long after the last activity[msec.]
+constexpr int HUB_KEEPALIVE = 15;           // MQTT keep-alive without power save[sec.]
+constexpr int RADIO_KEEPALIVE_MAX = 1177;   // Upper limit of MQTT keep-alive accepted by IoT Hub[sec.]
+constexpr bool WIFI_REUSE_IP = false;       // Reuse the cached IP lease on fast reconnect (skips DHCP; the lease may have expired)
+
 extern const char MODEL_ID[];
 extern const char DPS_GLOBAL_DEVICE_ENDPOINT_HOST[];
 constexpr int MQTT_PACKET_SIZE = 1024;
 constexpr int TOKEN_LIFESPAN = 1 * 60 * 60; // [sec.]
 constexpr float RECONNECT_RATE = 0.85;
+constexpr int TOKEN_PREPARE_LEAD = 60;      // Compute the next SAS this long before the reconnect[sec.]
 constexpr int JSON_MAX_SIZE = 1024;
+constexpr int TWIN_CONFIRM_MAX_SIZE = 768;  // One acknowledgement patch (fits in MQTT_PACKET_SIZE with the topic)
+constexpr int TWIN_CONFIRM_PER_PATCH = 8;   // Acknowledgements per patch (about 75 bytes each at most)
+constexpr int TWIN_PROPERTY_MAX = 24;       // Writable properties in the registry
+constexpr int TWIN_LOG_MAX_SIZE = 0;        // Print at most this much of a received twin payload. 0 disables
+constexpr unsigned long TWIN_LOG_INTERVAL = 60000;  // Print a twin payload at most once per interval[msec.]
+constexpr int TELEMETRY_INTERVAL = 15;      // Default of TelemetryInterval[sec.]
+constexpr int TELEMETRY_BATCH_MAX = 10;     // Samples per message (fits in TELEMETRY_PAYLOAD_MAX_SIZE)
+constexpr int TELEMETRY_PAYLOAD_MAX_SIZE = 4096;
+constexpr int TELEMETRY_QOS = 1;            // 0 or 1
+constexpr int TELEMETRY_INFLIGHT_MAX = 4;   // QoS1 messages awaiting PUBACK
+constexpr int TELEMETRY_INFLIGHT_BUFFER_SIZE = TELEMETRY_PAYLOAD_MAX_SIZE + 256;    // Topics and payloads awaiting PUBACK, shared (one largest message must fit)
+
+constexpr unsigned long STORAGE_CACHE_ADDRESS = 0x1000;    // Wi-Fi/DPS caches and writable properties in external flash (settings are at 0)
+constexpr int STORAGE_CACHE_SECTOR_NUMBER = 4;              // 4KB each
+
+constexpr unsigned long TELEMETRY_LOG_ADDRESS = 0x10000;    // Offline telemetry log in external flash
+constexpr int TELEMETRY_LOG_SECTOR_NUMBER = 64;             // 4KB each
+constexpr int TELEMETRY_REPLAY_INTERVAL = 2000;             // Send one batch from the log per interval[msec.]
+
+constexpr int TELEMETRY_DEADBAND_CO2 = 20;      // Send a metric only when it moves this much[ppm]
+constexpr int TELEMETRY_DEADBAND_HUMI = 2;      // [%RH]
+constexpr float TELEMETRY_DEADBAND_TEMP = 0.2f; // [C]
+constexpr float TELEMETRY_DEADBAND_WBGT = 0.2f; // [C]
+constexpr int TELEMETRY_HEARTBEAT = 15 * 60;    // Send every metric at least this often[sec.] 0 disables
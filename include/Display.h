@@ -1,7 +1,24 @@
 #pragma once
 
+enum class DisplayStatusItem
+{
+	WIFI,
+	TIME,
+	HUB,
+	MAX_,
+};
+
+enum class DisplayStatusState
+{
+	NONE,
+	BUSY,
+	OK,
+	ERROR,
+};
+
 void DisplayInit();
 void DisplayClear();
 void DisplaySetBrightness(int brightness);
 void DisplayRefresh(int tick, bool force);
 void DisplayPrintf(const char* format, ...);
+void DisplaySetStatus(DisplayStatusItem item, DisplayStatusState state);
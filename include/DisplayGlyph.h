@@ -0,0 +1,21 @@
+#pragma once
+
+#include <LovyanGFX.hpp>
+
+constexpr int DISPLAY_GLYPH_TEXT_MAX = 12;
+
+// 前回描画した文字列(変化した文字だけを描き直すため)
+struct DisplayGlyphText
+{
+	bool Valid;
+	const lgfx::IFont* Font;
+	float Size;
+	int X;
+	int Y;
+	char Text[DISPLAY_GLYPH_TEXT_MAX + 1];
+	int16_t CharX[DISPLAY_GLYPH_TEXT_MAX];
+	int Width;
+};
+
+void DisplayGlyphPrepare(const lgfx::IFont* font, float size);
+void DisplayGlyphPrint(LovyanGFX* gfx, int x, int y, const lgfx::IFont* font, float size, const char* str, DisplayGlyphText* prev);
@@ -0,0 +1,28 @@
+#pragma once
+
+constexpr int BOOT_TIMELINE_MAX = 16;
+
+// 起動処理の各段階が終わった時刻を記録する
+class BootTimeline
+{
+private:
+	struct Phase
+	{
+		const char* Name;
+		unsigned long Time;		// 電源投入からの時間[msec.]
+	};
+
+	Phase Phases_[BOOT_TIMELINE_MAX];
+	int Count_;
+
+public:
+	BootTimeline();
+	BootTimeline(const BootTimeline&) = delete;
+	BootTimeline& operator=(const BootTimeline&) = delete;
+
+	// 同じ名前は最初の1回だけ記録し、記録したらtrueを返す
+	bool Mark(const char* name);
+	bool IsMarked(const char* name) const;
+	void Print() const;
+
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// ヒープとスタックの間の空き + ヒープ内の解放済み領域[byte]
+size_t FreeMemoryGet();
+
+// 呼ばれた時点の空きで最小値を更新する(ピーク時の使用量の目安)
+size_t FreeMemoryUpdateLowWater();
+size_t FreeMemoryGetLowWater();
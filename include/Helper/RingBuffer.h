@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include "Helper/Nullable.h"
+
+// 固定長リングバッファ(ヒープ未使用)
+// 合計値を差分更新するので average() は O(1)
+// 欠測値(Nullable)も格納するが、合計・平均・最小・最大には含めない
+template<class T, size_t N>
+class RingBuffer
+{
+private:
+	T Data_[N];
+	size_t Head_;		// 最古の要素の位置
+	size_t Size_;
+	size_t LimitSize_;
+	size_t Count_;		// 欠測値を除いた要素数
+	T Sum_;
+	T Min_;
+	T Max_;
+	bool MinMaxValid_;
+
+	void Recalculate()
+	{
+		Sum_ = T();
+		Count_ = 0;
+		for (size_t i = 0; i < Size_; ++i)
+		{
+			const T& x = (*this)[i];
+			if (NullableIsNull(x)) continue;
+
+			Sum_ += x;
+			if (Count_ == 0 || x < Min_) Min_ = x;
+			if (Count_ == 0 || x > Max_) Max_ = x;
+			++Count_;
+		}
+		MinMaxValid_ = true;
+	}
+
+public:
+	RingBuffer() :
+		Head_{ 0 },
+		Size_{ 0 },
+		LimitSize_{ N },
+		Count_{ 0 },
+		Sum_{},
+		Min_{},
+		Max_{},
+		MinMaxValid_{ true }
+	{
+	}
+
+	size_t limitsize() const
+	{
+		return LimitSize_;
+	}
+
+	// 実行時に窓幅を狭める(1～N)
+	void setlimitsize(size_t limitSize)
+	{
+		if (limitSize < 1) limitSize = 1;
+		if (limitSize > N) limitSize = N;
+		while (Size_ > limitSize) pop_front();
+		LimitSize_ = limitSize;
+	}
+
+	size_t size() const
+	{
+		return Size_;
+	}
+
+	bool empty() const
+	{
+		return Size_ == 0;
+	}
+
+	void clear()
+	{
+		Head_ = 0;
+		Size_ = 0;
+		Count_ = 0;
+		Sum_ = T();
+		MinMaxValid_ = true;
+	}
+
+	const T& operator[](size_t index) const
+	{
+		size_t pos = Head_ + index;
+		if (pos >= N) pos -= N;
+		return Data_[pos];
+	}
+
+	const T& front() const
+	{
+		return (*this)[0];
+	}
+
+	const T& back() const
+	{
+		return (*this)[Size_ - 1];
+	}
+
+	void pop_front()
+	{
+		if (Size_ <= 0) return;
+
+		const T& x = Data_[Head_];
+		if (!NullableIsNull(x))
+		{
+			Sum_ -= x;
+			--Count_;
+			if (x <= Min_ || x >= Max_) MinMaxValid_ = false;	// 極値が抜けたら次回参照時に再計算
+		}
+		Head_ = Head_ + 1 >= N ? 0 : Head_ + 1;
+		--Size_;
+	}
+
+	void push_back(const T& x)
+	{
+		while (Size_ >= LimitSize_) pop_front();
+
+		size_t pos = Head_ + Size_;
+		if (pos >= N) pos -= N;
+		Data_[pos] = x;
+		if (!NullableIsNull(x))
+		{
+			Sum_ += x;
+			if (Count_ == 0 && MinMaxValid_)
+			{
+				Min_ = x;
+				Max_ = x;
+			}
+			else if (MinMaxValid_)
+			{
+				if (x < Min_) Min_ = x;
+				if (x > Max_) Max_ = x;
+			}
+			++Count_;
+		}
+		++Size_;
+
+		// 浮動小数点の誤差が蓄積しないよう1周ごとに合計値を取り直す
+		if (pos == N - 1) Recalculate();
+	}
+
+	// 欠測値を除いた要素数
+	size_t count() const
+	{
+		return Count_;
+	}
+
+	T sum() const
+	{
+		return Sum_;
+	}
+
+	// 有効な値が無ければ欠測値
+	T average() const
+	{
+		if (Count_ <= 0) return NullableNullValue<T>();
+		return Sum_ / static_cast<T>(Count_);
+	}
+
+	T min()
+	{
+		if (Count_ <= 0) return NullableNullValue<T>();
+		if (!MinMaxValid_) Recalculate();
+		return Min_;
+	}
+
+	T max()
+	{
+		if (Count_ <= 0) return NullableNullValue<T>();
+		if (!MinMaxValid_) Recalculate();
+		return Max_;
+	}
+
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cmath>
+
+// 値を溜めずに件数/最小/最大/平均/標準偏差を求める(Welfordの方法)
+template<class T>
+class RunningStats
+{
+private:
+	int Count_;
+	T Min_;
+	T Max_;
+	float Mean_;
+	float M2_;			// 平均からの差の2乗和
+
+public:
+	RunningStats()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		Count_ = 0;
+		Min_ = T();
+		Max_ = T();
+		Mean_ = 0;
+		M2_ = 0;
+	}
+
+	void push_back(T x)
+	{
+		if (Count_ == 0 || x < Min_) Min_ = x;
+		if (Count_ == 0 || x > Max_) Max_ = x;
+
+		++Count_;
+		const float delta = x - Mean_;
+		Mean_ += delta / Count_;
+		M2_ += delta * (x - Mean_);
+	}
+
+	int count() const
+	{
+		return Count_;
+	}
+
+	T min() const
+	{
+		return Min_;
+	}
+
+	T max() const
+	{
+		return Max_;
+	}
+
+	float mean() const
+	{
+		return Mean_;
+	}
+
+	// 母分散(区間内の全サンプルが母集団)
+	float variance() const
+	{
+		return Count_ > 0 ? M2_ / Count_ : 0;
+	}
+
+	float stddev() const
+	{
+		return std::sqrt(variance());
+	}
+
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+constexpr int SCHEDULER_TASK_MAX = 16;
+
+// 協調型のタスクスケジューラ
+// 周期タスクは絶対時刻で次回の期限を決めるので、処理時間で周期がずれない
+class Scheduler
+{
+public:
+	struct TaskStats
+	{
+		unsigned long RunCount;
+		unsigned long RunTimeSum;	// [usec.]
+		unsigned long RunTimeMax;	// [usec.]
+		unsigned long LatencyMax;	// 期限からの遅れ[msec.]
+		unsigned long OverrunCount;	// 1周期以上遅れて飛ばした回数
+	};
+
+private:
+	struct Task
+	{
+		const char* Name;
+		void (*Func)();
+		unsigned long Period;		// [msec.] 0ならワンショット
+		unsigned long Deadline;		// [msec.]
+		bool Scheduled;
+		TaskStats Stats;
+	};
+
+	Task Tasks_[SCHEDULER_TASK_MAX];
+	int TaskCount_;
+
+public:
+	Scheduler();
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	int AddPeriodic(const char* name, void (*func)(), unsigned long periodMs, unsigned long delayMs = 0);
+	int AddOneShot(const char* name, void (*func)());
+
+	void Schedule(int id, unsigned long delayMs);
+	void Cancel(int id);
+	bool IsScheduled(int id) const;
+	void SetPeriod(int id, unsigned long periodMs);
+
+	void DoWork();
+
+	const TaskStats& GetStats(int id) const;
+	void PrintStats(bool reset);
+
+};
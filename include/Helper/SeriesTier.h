@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// 時系列の1点
+// Countは元になった有効な測定値の数(0なら欠測で、値はNaN)
+struct SeriesPoint
+{
+	float Min;
+	float Average;
+	float Max;
+	unsigned Count;
+};
+
+// 下位層の点をRatio個ずつまとめて最小/平均/最大を保持する時系列の層
+// 値はScale倍して16ビット整数で持つ(1点8バイト)
+// 平均は下位層の点の平均ではなく、元の測定値の数で重み付けした平均
+template<size_t N>
+class SeriesTier
+{
+private:
+	struct Cell
+	{
+		int16_t Min;
+		int16_t Average;
+		int16_t Max;
+		uint16_t Count;
+	};
+
+	int Ratio_;
+	float Scale_;
+	Cell Data_[N];
+	size_t Head_;
+	size_t Size_;
+
+	// 集計中の値
+	int AccCount_;			// 取り込んだ下位層の点の数(欠測を含む)
+	unsigned long AccValidCount_;	// 元の測定値の数
+	float AccSum_;			// 元の測定値の合計
+	float AccMin_;
+	float AccMax_;
+
+	int16_t Encode(float val) const
+	{
+		const float x = std::floor(val * Scale_ + .5f);	// 四捨五入
+		if (x > INT16_MAX) return INT16_MAX;
+		if (x < -INT16_MAX) return -INT16_MAX;
+		return static_cast<int16_t>(x);
+	}
+
+	float Decode(int16_t val) const
+	{
+		return val / Scale_;
+	}
+
+public:
+	SeriesTier(int ratio, float scale = 1) :
+		Ratio_{ ratio },
+		Scale_{ scale },
+		Head_{ 0 },
+		Size_{ 0 },
+		AccCount_{ 0 },
+		AccValidCount_{ 0 },
+		AccSum_{ 0 },
+		AccMin_{ 0 },
+		AccMax_{ 0 }
+	{
+	}
+
+	size_t limitsize() const
+	{
+		return N;
+	}
+
+	size_t size() const
+	{
+		return Size_;
+	}
+
+	int ratio() const
+	{
+		return Ratio_;
+	}
+
+	void clear()
+	{
+		Head_ = 0;
+		Size_ = 0;
+		AccCount_ = 0;
+		AccValidCount_ = 0;
+		AccSum_ = 0;
+	}
+
+	SeriesPoint operator[](size_t index) const
+	{
+		size_t pos = Head_ + index;
+		if (pos >= N) pos -= N;
+		const Cell& cell = Data_[pos];
+		if (cell.Count == 0) return SeriesPoint{ NAN, NAN, NAN, 0 };
+
+		return SeriesPoint{ Decode(cell.Min), Decode(cell.Average), Decode(cell.Max), cell.Count };
+	}
+
+	// 下位層の点を1つ取り込む
+	// この層の点が確定したらtrueを返しresultに格納する(丸める前の値)
+	bool Add(const SeriesPoint& point, SeriesPoint* result)
+	{
+		if (point.Count > 0)
+		{
+			if (AccValidCount_ == 0 || point.Min < AccMin_) AccMin_ = point.Min;
+			if (AccValidCount_ == 0 || point.Max > AccMax_) AccMax_ = point.Max;
+			AccSum_ += point.Average * point.Count;
+			AccValidCount_ += point.Count;
+		}
+		if (++AccCount_ < Ratio_) return false;
+
+		SeriesPoint p{ NAN, NAN, NAN, 0 };
+		if (AccValidCount_ > 0)
+		{
+			p.Min = AccMin_;
+			p.Average = AccSum_ / AccValidCount_;
+			p.Max = AccMax_;
+			p.Count = AccValidCount_ < UINT16_MAX ? AccValidCount_ : UINT16_MAX;
+		}
+
+		size_t pos = Head_ + Size_;
+		if (pos >= N) pos -= N;
+		Data_[pos] = p.Count > 0 ? Cell{ Encode(p.Min), Encode(p.Average), Encode(p.Max), static_cast<uint16_t>(p.Count) } : Cell{ 0, 0, 0, 0 };
+		if (Size_ < N) ++Size_;
+		else Head_ = Head_ + 1 >= N ? 0 : Head_ + 1;
+
+		AccCount_ = 0;
+		AccValidCount_ = 0;
+		AccSum_ = 0;
+
+		if (result != nullptr) *result = p;
+		return true;
+	}
+
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+constexpr int TONE_SEQUENCER_QUEUE_MAX = 8;
+
+struct ToneStep
+{
+	int Frequency;		// [Hz] 0は無音
+	int DurationMs;		// [msec.]
+};
+
+// 音の並び(パターン)を時刻に従って進める
+// ハードウェアに依存しないので、出力は Update() の戻り値で受け取る
+class ToneSequencer
+{
+private:
+	struct Entry
+	{
+		const ToneStep* Steps;
+		int Count;
+		int Repeat;			// 0なら停止されるまで繰り返す
+		ToneStep Single;	// PlayTone()用
+	};
+
+	Entry Queue_[TONE_SEQUENCER_QUEUE_MAX];
+	int Head_;
+	int Count_;
+
+	bool Playing_;
+	int Step_;
+	int RepeatRemain_;
+	unsigned long StepEnd_;		// [msec.]
+	int Output_;				// [Hz]
+
+	const ToneStep& CurrentStep() const;
+	void NextStep();
+	void Pop();
+
+public:
+	ToneSequencer();
+
+	bool Enqueue(const ToneStep* steps, int count, int repeat);
+	bool Enqueue(int frequency, int durationMs);
+	void Clear();
+	bool IsPlaying() const;
+
+	// 時刻nowまで進め、出力する周波数が変わったらtrueを返し*frequencyに格納
+	bool Update(unsigned long now, int* frequency);
+
+};
@@ -1,14 +1,22 @@
 #pragma once
 
+#include "Helper/ToneSequencer.h"
+
 class Sound
 {
 private:
     int Pin_;
+    ToneSequencer Sequencer_;
 
 public:
     Sound(int pin);
 
     void Init();
+    void DoWork();
+
     void PlayTone(int frequency, int durationMs);
+    void PlayPattern(const ToneStep* steps, int count, int repeat = 1);
+    void Stop();
+    bool IsPlaying() const;
     
 };
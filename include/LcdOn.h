@@ -3,6 +3,7 @@
 #include "Hw/Light.h"
 
 void LcdOnInit(Light* light);
+void LcdOnSetTime(int onTimeSec);
 void LcdOnForce(bool on);
 void LcdOnUpdate();
 bool LcdOnIsOn();
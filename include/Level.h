@@ -0,0 +1,8 @@
+#pragma once
+
+// 測定値の段階(表示色の境目)
+// 0から順に高くなり、無効値や範囲外は-1
+int LevelCo2(int val);
+int LevelHumi(int val);
+int LevelTemp(float val);
+int LevelWbgt(float val);
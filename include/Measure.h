@@ -1,9 +1,33 @@
 #pragma once
 
+#include "Helper/RunningStats.h"
+
 extern int Co2Ave;
 extern int HumiAve;
 extern float TempAve;
 extern float WbgtAve;
 
+struct MeasureStats
+{
+	unsigned long Samples;
+	unsigned long LateSamples;		// 予定より測定間隔の半分以上遅れた
+	unsigned long MissedSamples;	// 測定間隔を過ぎても取れなかった
+	unsigned long Polls;			// ReadyToRead()の回数
+};
+
+// 区間内の全測定値の統計
+struct MeasureInterval
+{
+	RunningStats<float> Co2;
+	RunningStats<float> Humi;
+	RunningStats<float> Temp;
+	RunningStats<float> Wbgt;
+};
+
 void MeasureInit();
-void MeasureRead();
+void MeasureSetInterval(int intervalSec);
+void MeasureSetAverageNumber(int co2, int humi, int temp);
+void MeasureSetTempOffset(float offset);
+void MeasureDoWork();
+const MeasureStats& MeasureGetStats();
+MeasureInterval MeasureTakeInterval();
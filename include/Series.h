@@ -1,9 +1,23 @@
 #pragma once
 
-#include "Helper/DequeLimitSize.h"
+#include "Helper/SeriesTier.h"
 
-extern DequeLimitSize<int> Co2SeriesBuf;
-extern DequeLimitSize<int> WbgtSeriesBuf;
+enum class SeriesKind
+{
+	CO2,
+	WBGT,
+};
+
+enum class SeriesResolution
+{
+	RAW,
+	MIN5,
+	HOUR1,
+	DAY1,
+};
 
 void SeriesInit();
 void SeriesUpdate(int tick);
+
+int SeriesIntervalSec(SeriesKind kind, SeriesResolution resolution);
+int SeriesQuery(SeriesKind kind, SeriesResolution resolution, int windowSec, int endSec, SeriesPoint* out, int outSize);
@@ -1,21 +1,57 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
 
 class Storage
 {
 public:
 	static std::string WiFiSSID;
 	static std::string WiFiPassword;
+	static std::vector<std::string> WiFiExtraSSID;		// WiFiSSIDがつながらないときに優先順に試す
+	static std::vector<std::string> WiFiExtraPassword;
+
+	// 最後に接続できたアクセスポイント(WiFiCacheChannelが0ならキャッシュ無し)
+	// キャッシュは設定とは別の領域に追記する(Save()では書き込まない)
+	static std::string WiFiCacheSSID;
+	static uint8_t WiFiCacheBssid[6];
+	static int32_t WiFiCacheChannel;
+	static uint32_t WiFiCacheIp;
+	static uint32_t WiFiCacheGateway;
+	static uint32_t WiFiCacheSubnet;
+	static uint32_t WiFiCacheDns;
 	static std::string IdScope;
 	static std::string RegistrationId;
 	static std::string SymmetricKey;
 
+	// DPSの割り当て結果のキャッシュ(DpsCacheKeyが接続情報のハッシュと一致するときだけ有効)
+	static std::string HubHost;
+	static std::string DeviceId;
+	static uint32_t DpsCacheKey;
+
+	// 書き込み可能なプロパティの最後の値(JSON、キャッシュと同じ領域に追記する)
+	static std::string Properties;
+
 public:
 	static void Load();
 	static void Save();
 	static void Erase();
 
+	static uint32_t ComputeDpsCacheKey();
+	static bool IsDpsCacheValid();
+	static void SaveDpsCache(const std::string& hubHost, const std::string& deviceId);
+	static void InvalidateDpsCache();
+	static void SaveProperties(const std::string& properties);
+	static void SaveWiFiCache(const std::string& ssid, const uint8_t* bssid, int32_t channel, uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns);
+	static void ClearWiFiCache();	// 消去したことも書き込む
+
+	// 外部フラッシュの直接操作(設定領域以外に使う)
+	static const uint8_t* FlashRead(uint32_t address);
+	static void FlashEraseSector(uint32_t address);
+	static void FlashProgram(uint32_t address, const void* data, size_t size);
+
 private:
 	static int Init;
 
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+// 送信間隔内の統計(平均はTelemetrySampleの値)
+struct TelemetryStats
+{
+	int Count;				// 0なら統計なし
+	float Min;
+	float Max;
+	float StdDev;
+};
+
+struct TelemetrySample
+{
+	unsigned long Time;		// エポック秒
+	int Co2;
+	int Humi;
+	float Temp;
+	float Wbgt;
+	TelemetryStats Co2Stats;
+	TelemetryStats HumiStats;
+	TelemetryStats TempStats;
+	TelemetryStats WbgtStats;
+};
+
+enum class TelemetryEncoding
+{
+	JSON,
+	MSGPACK,
+	MAX_,
+};
+
+void TelemetrySetEncoding(TelemetryEncoding encoding);
+TelemetryEncoding TelemetryGetEncoding();
+const char* TelemetryGetContentType();
+const char* TelemetryGetContentEncoding();
+
+void TelemetrySetBatch(int size, int maxAgeSec);
+int TelemetryGetBatchSize();
+int TelemetryGetBatchMaxAge();
+
+TelemetrySample TelemetryCapture(unsigned long epochTime);
+void TelemetryAdd(const TelemetrySample& sample);
+bool TelemetryIsFlushDue(unsigned long epochTime);
+int TelemetrySerialize(char* buf, size_t size);
+int TelemetrySerializeSamples(const TelemetrySample* samples, int count, char* buf, size_t size);
+int TelemetryPopAll(TelemetrySample* samples, int maxCount);
+void TelemetryClear();
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Telemetry.h"
+
+// 送信する変化幅(0なら毎回送る)
+struct TelemetryDeadband
+{
+	int Co2;
+	int Humi;
+	float Temp;
+	float Wbgt;
+};
+
+void TelemetryFilterSetDeadband(const TelemetryDeadband& deadband);
+const TelemetryDeadband& TelemetryFilterGetDeadband();
+void TelemetryFilterSetHeartbeat(int heartbeatSec);
+int TelemetryFilterGetHeartbeat();
+
+bool TelemetryFilterApply(TelemetrySample* sample);
+void TelemetryFilterReset();
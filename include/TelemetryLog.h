@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Telemetry.h"
+
+// ログを置くフラッシュの操作(実機はStorage::Flash*、テストはファイル)
+struct TelemetryLogFlash
+{
+	const uint8_t* (*Read)(uint32_t address);
+	void (*EraseSector)(uint32_t address);
+	void (*Program)(uint32_t address, const void* data, size_t size);
+};
+
+void TelemetryLogInit(const TelemetryLogFlash& flash);
+bool TelemetryLogAppend(const TelemetrySample& sample);
+int TelemetryLogPeek(TelemetrySample* samples, int maxCount);
+void TelemetryLogMarkSent(int count);
+int TelemetryLogPendingCount();
+unsigned long TelemetryLogDroppedCount();
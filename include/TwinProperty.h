@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+enum class TwinPropertyType
+{
+	INT,
+	FLOAT,
+};
+
+// 書き込み可能なプロパティの定義
+// 値は範囲内に収まることを確認してからApplyに渡す
+struct TwinPropertyDef
+{
+	const char* Name;
+	TwinPropertyType Type;
+	float Min;
+	float Max;
+	float Default;
+	void (*Apply)(float value);
+};
+
+// ackCode: 200=適用 400=範囲外などで不採用(現在値を返す)
+struct TwinPropertyAck
+{
+	const TwinPropertyDef* Def;
+	float Value;
+	int AckCode;
+};
+
+// 受信した内容を全て処理し終えてから1回だけ呼ぶ
+// 受信バッファの上で解析しているので、途中で送信するとバッファが上書きされて残りを読めない
+using TwinPropertyConfirm = void (*)(const TwinPropertyAck* acks, int count, int ackVersion);
+
+void TwinPropertyInit(const TwinPropertyDef* defs, int count, TwinPropertyConfirm confirm);
+void TwinPropertyRestore();
+void TwinPropertyReceived(JsonVariantConst desired, bool confirmAll, int version);
@@ -1,8 +1,18 @@
 #pragma once
 
 #include <string>
+#include <functional>
 #include <Aziot/EasyAziotDpsClient.h>
 
+enum class AziotDpsState
+{
+    IDLE,
+    CONNECTING,
+    WAITING,
+    ASSIGNED,
+    FAILED,
+};
+
 class AziotDps
 {
 public:
@@ -11,11 +21,24 @@ public:
     AziotDps& operator=(const AziotDps&) = delete;
 
     void SetMqttPacketSize(int size);
+    void SetTimeout(unsigned long timeoutMs);
 
-    int RegisterDevice(const std::string& endpointHost, const std::string& idScope, const std::string& registrationId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime, std::string* hubHost, std::string* deviceId);
+    int Begin(const std::string& endpointHost, const std::string& idScope, const std::string& registrationId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime);
+    AziotDpsState DoWork();
+    AziotDpsState GetState() const;
+    int GetResult(std::string* hubHost, std::string* deviceId);
+
+    std::function<void(AziotDpsState state)> StateChangedCallback;
 
 private:
     uint16_t MqttPacketSize_;
+    unsigned long TimeoutMs_;
+    AziotDpsState State_;
+    unsigned long StartTime_;
+    std::string EndpointHost_;
+    std::string ModelId_;
+
+    void SetState(AziotDpsState state);
 
     static EasyAziotDpsClient DpsClient_;
     static unsigned long DpsPublishTimeOfQueryStatus_;
@@ -1,8 +1,23 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <functional>
+#include <Aziot/EasyAziotConfig.h>
 #include <Aziot/EasyAziotHubClient.h>
+#include <Network/Backoff.h>
+#include <Network/PublishWindow.h>
+
+enum class AziotHubState
+{
+    STOPPED,
+    DISCONNECTED,
+    CONNECTING,
+    BACKOFF,
+    CONNECTED,
+};
+
+using AziotHubPublishStats = PublishWindowStats;
 
 class AziotHub
 {
@@ -12,22 +27,72 @@ public:
     AziotHub& operator=(const AziotHub&) = delete;
 
     void SetMqttPacketSize(int size);
+    void SetPublishBufferSize(int size);
+    void SetPublishQos(int qos, int window, size_t bufferSize);
+    void SetKeepAlive(uint16_t keepAlive);
+
+    void Start(const std::string& host, const std::string& deviceId, const std::string& symmetricKey, const std::string& modelId, std::function<uint64_t()> expirationEpochTime);
+    void Stop();
+    AziotHubState GetState() const;
+    bool IsConnectRejected() const;
 
     void DoWork();
     bool IsConnected();
     int Connect(const std::string& host, const std::string& deviceId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime);
     void Disconnect();
-    void SendTelemetry(const char* payload);
+    int PrepareReconnect(const uint64_t& expirationEpochTime);
+    bool SendTelemetry(const char* payload);
+    bool SendTelemetry(const char* payload, size_t length);
+    void SetTelemetryProperties(const char* contentType, const char* contentEncoding);
+    char* GetPublishBuffer();
+    size_t GetPublishBufferSize() const;
+    int GetInFlightCount() const;
+    const AziotHubPublishStats& GetPublishStats() const;
+    void ResetPublishStats();
     void RequestTwinDocument(const char* requestId);
     void SendTwinPatch(const char* requestId, const char* payload);
 
-    static std::function<void(const char* json, const char* requestId)> ReceivedTwinDocumentCallback;
-    static std::function<void(const char* json, const char* version)> ReceivedTwinDesiredPatchCallback;
+    std::function<void(AziotHubState state)> StateChangedCallback;
+    // jsonはPubSubClientの受信バッファを指す(終端の'\0'は無い)
+    // コールバックの中でだけ有効で、その場で書き換えてもよい
+    // 送信(SendTwinPatch()など)は同じバッファを使うので、jsonを読み終えてから行うこと
+    static std::function<void(char* json, size_t length, az_span requestId)> ReceivedTwinDocumentCallback;
+    static std::function<void(char* json, size_t length, az_span version)> ReceivedTwinDesiredPatchCallback;
+    static void SetTwinLog(size_t maxLength, unsigned long minInterval);
 
 private:
     uint16_t MqttPacketSize_;
+    uint16_t KeepAlive_;
+    std::vector<char> PublishBuffer_;
+    char TelemetryTopic_[TELEMETRY_PUBLISH_TOPIC_MAX_SIZE];    // 接続ごとに1回だけ作る
+    std::string TelemetryContentType_;
+    std::string TelemetryContentEncoding_;
+
+    int UpdateTelemetryTopic();
+
+    int PublishQos_;
+    PublishWindow InFlight_;        // QoS1で送ってPUBACKを待っているテレメトリ
+
+    bool WritePublish(const char* topic, uint16_t packetId, const uint8_t* payload, size_t length, bool duplicate);
+    void RetransmitInFlight(bool timeoutOnly);
+    void ReceivedPubAck(uint16_t packetId);
+
+    AziotHubState State_;
+    std::string Host_;
+    std::string DeviceId_;
+    std::string SymmetricKey_;
+    std::string ModelId_;
+    std::function<uint64_t()> ExpirationEpochTime_;
+    Backoff Backoff_;
+    unsigned long RetryTime_;
+    unsigned long ConnectStartTime_;
+    bool ConnectRejected_;
+
+    void SetState(AziotHubState state);
 
     static EasyAziotHubClient HubClient_;
+    static size_t TwinLogMaxLength_;
+    static unsigned long TwinLogMinInterval_;
     static void MqttSubscribeCallback(char* topic, uint8_t* payload, unsigned int length);
 
 };
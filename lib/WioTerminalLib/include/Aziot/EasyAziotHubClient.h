@@ -8,12 +8,13 @@
 class EasyAziotHubClient
 {
 public:
+    // RequestIdとVersionは受信したトピックの中を指す(コピーしない)
     struct TwinResponse
     {
-        std::string RequestId;
+        az_span RequestId;
         az_iot_status Status;
         az_iot_hub_client_twin_response_type ResponseType;
-        std::string Version;
+        az_span Version;
     };
 
 public:
@@ -23,16 +24,18 @@ public:
 
     int Init(const char* host, const char* deviceId, const char* modelId);
     int SetSAS(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature);
+    int PrepareSAS(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature);
+    bool UsePreparedSAS(const uint64_t& minExpirationEpochTime);
 
     const std::string& GetMqttUsername() const;
     const std::string& GetMqttClientId() const;
     const std::string& GetMqttPassword() const;
 
-    std::string GetTelemetryPublishTopic();
+    int GetTelemetryPublishTopic(char* topic, size_t size, const char* contentType = nullptr, const char* contentEncoding = nullptr);
     std::string GetTwinDocumentPublishTopic(const char* requestId);
     std::string GetTwinPatchPublishTopic(const char* requestId);
 
-    int ParseTwinTopic(const char* topic, TwinResponse& twinResponse);
+    int ParseTwinTopic(char* topic, TwinResponse& twinResponse);
 
 private:
     std::string Host_;
@@ -45,4 +48,10 @@ private:
     std::string MqttClientId_;
     std::string MqttPassword_;
 
+    // 次回接続用に先に計算しておいたパスワード
+    std::string PreparedMqttPassword_;
+    uint64_t PreparedExpirationEpochTime_;
+
+    int GeneratePassword(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature, std::string* password);
+
 };
@@ -0,0 +1,17 @@
+#pragma once
+
+// 指数バックオフ(ジッタ付き)
+class Backoff
+{
+public:
+    Backoff(unsigned long initialMs, unsigned long maxMs);
+
+    void Reset();
+    unsigned long Next();
+
+private:
+    unsigned long InitialMs_;
+    unsigned long MaxMs_;
+    unsigned long CurrentMs_;
+
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Client.h>
+#include <functional>
+
+// 受信したMQTTパケットを覗き見てPUBACKを通知するClient
+// PubSubClientはQoS1のPUBACKを読み捨てるので、下位のClientとの間に挟んで使う
+class MqttAckClient : public Client
+{
+public:
+    explicit MqttAckClient(Client& client);
+    MqttAckClient(const MqttAckClient&) = delete;
+    MqttAckClient& operator=(const MqttAckClient&) = delete;
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override;
+
+    std::function<void(uint16_t packetId)> PubAckCallback;
+
+    // QoS1のPUBLISHの本文より前(固定ヘッダ、トピック、パケットID)をbufに書き、長さを返す
+    // bufには PUBLISH_HEADER_OVERHEAD + トピックの長さ が必要
+    static constexpr size_t PUBLISH_HEADER_OVERHEAD = 1 + 4 + 2 + 2;
+    static size_t EncodePublishHeader(uint8_t* buf, const char* topic, uint16_t packetId, size_t payloadLength, bool duplicate);
+
+private:
+    enum class ParseState
+    {
+        HEADER,
+        LENGTH,
+        BODY,
+    };
+
+    Client& Client_;
+
+    ParseState State_;
+    uint8_t Type_;
+    uint32_t Remaining_;
+    uint32_t Multiplier_;
+    uint32_t BodyPos_;
+    uint16_t PacketId_;
+
+    void ResetParser();
+    void Parse(uint8_t data);
+
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct PublishWindowStats
+{
+    unsigned long Published;        // 新規に送信した数
+    unsigned long Acked;
+    unsigned long Retransmitted;
+    unsigned long WindowFull;       // 空きが無く受け付けなかった数
+    unsigned long LatencySum;       // PUBACKまでの時間[msec.]
+    unsigned long LatencyMax;       // [msec.]
+};
+
+// QoS1で送ってPUBACKを待っているメッセージ
+// トピックと本文は全てのメッセージで共有する1つのリングバッファに詰めて置く
+// (領域は古いものから順に解放されるので、古いものにPUBACKが来るまで後ろの領域は空かない)
+class PublishWindow
+{
+public:
+    struct Entry
+    {
+        bool Used;
+        uint16_t PacketId;
+        unsigned long FirstSendTime;    // [msec.]
+        unsigned long SendTime;         // [msec.]
+        size_t Offset;                  // リングバッファ内のトピックの位置(本文はその後ろ)
+        size_t TopicLength;             // 終端の'\0'を含まない
+        size_t Length;                  // 本文
+    };
+
+    using Sender = std::function<bool(const char* topic, uint16_t packetId, const uint8_t* payload, size_t length)>;
+
+    PublishWindow();
+
+    void Init(int window, size_t bufferSize);
+    void Clear();
+
+    const Entry* Add(const char* topic, const void* payload, size_t length, unsigned long now);
+    bool Ack(uint16_t packetId, unsigned long now);
+    int Retransmit(unsigned long now, unsigned long timeout, bool timeoutOnly, const Sender& send);
+
+    const char* GetTopic(const Entry& entry) const;
+    const uint8_t* GetPayload(const Entry& entry) const;
+    int GetCount() const;
+    int GetWindow() const;
+    size_t GetBufferSize() const;
+    const PublishWindowStats& GetStats() const;
+    void ResetStats();
+
+private:
+    std::vector<Entry> Entries_;    // 送った順のリング
+    int First_;
+    int Count_;
+    std::vector<uint8_t> Buffer_;
+    uint16_t NextPacketId_;
+    PublishWindowStats Stats_;
+
+    Entry& At(int index);
+    bool Allocate(size_t size, size_t* offset) const;
+
+};
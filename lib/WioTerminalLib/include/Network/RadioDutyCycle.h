@@ -0,0 +1,38 @@
+#pragma once
+
+// 送信などをまとめた起床窓の間だけ無線を起こし、それ以外はモデムスリープにする
+struct RadioDutyCycleStats
+{
+    unsigned long Wakes;
+    unsigned long AwakeMsThisHour;      // 今の1時間の起床時間[msec.]
+    unsigned long AwakeMsLastHour;      // 直前の1時間の起床時間[msec.]
+};
+
+class RadioDutyCycle
+{
+public:
+    RadioDutyCycle(unsigned long windowMs);
+    RadioDutyCycle(const RadioDutyCycle&) = delete;
+    RadioDutyCycle& operator=(const RadioDutyCycle&) = delete;
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+    void Wake();
+    void DoWork(bool busy);
+    bool IsAwake() const;
+
+    const RadioDutyCycleStats& GetStats() const;
+
+private:
+    unsigned long WindowMs_;
+    bool Enabled_;
+    bool Awake_;
+    unsigned long LastActiveTime_;      // [msec.]
+    unsigned long AwakeStartTime_;      // [msec.]
+    unsigned long HourStartTime_;       // [msec.]
+    RadioDutyCycleStats Stats_;
+
+    void SetSleep(bool sleep);
+    void UpdateHour(unsigned long now);
+
+};
@@ -2,6 +2,31 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <mbedtls/md.h>
 
+// HMAC-SHA256の署名器
+// 鍵のデコードとHMACの準備はSetKey()で1回だけ行い、Sign()で使い回す
+class SasSigner
+{
+public:
+    SasSigner();
+    ~SasSigner();
+    SasSigner(const SasSigner&) = delete;
+    SasSigner& operator=(const SasSigner&) = delete;
+
+    int SetKey(const std::string& base64Key);
+    void Clear();
+    int Sign(const uint8_t* data, size_t size, std::string* base64Signature);
+
+private:
+    std::string Key_;               // SetKey()に渡された鍵(Base64)
+    bool Ready_;
+    mbedtls_md_context_t Ctx_;
+
+};
+
+// 失敗したときは空文字列を返す
 std::string GenerateEncryptedSignature(const std::string& symmetricKey, const std::vector<uint8_t>& signature);
 std::string ComputeDerivedSymmetricKey(const std::string& masterKey, const std::string& registrationId);
@@ -11,6 +11,7 @@ public:
     TimeManager& operator=(const TimeManager&) = delete;
     
     bool Update();
+    bool IsSynced() const;
     unsigned long GetEpochTime() const;
 
 private:
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Client.h>
+#include <string>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/x509_crt.h>
+
+// 下位のClient(TCP)の上にmbedTLSでTLSを張るClient
+// 最後に張ったセッションを覚えておき、同じホストへ再接続するときは省略したハンドシェイクで再開する
+// (サーバーが再開を断れば、通常のハンドシェイクになる)
+// CA証明書は最初の接続で1回だけ解析し、切断しても解放しない
+class TlsClient : public Client
+{
+public:
+    TlsClient(Client& client, const char* caCerts);
+    ~TlsClient();
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override;
+
+    int ConnectStep(const char* host, uint16_t port);
+    bool IsConnecting() const;
+
+    void SetHandshakeTimeout(unsigned long timeout);    // [msec.]
+    bool IsResumed() const;         // 直前の接続でセッションを再開できたか
+    void ForgetSession();
+
+private:
+    Client& Client_;
+    const char* CaCerts_;
+    unsigned long HandshakeTimeout_;
+    bool Ready_;
+    bool Handshaking_;
+    unsigned long HandshakeStartTime_;
+    bool Connected_;
+    bool Verified_;                 // ハンドシェイクで証明書を検証した(=再開しなかった)
+    int Peek_;
+
+    mbedtls_entropy_context Entropy_;
+    mbedtls_ctr_drbg_context Drbg_;
+    mbedtls_x509_crt Ca_;
+    mbedtls_ssl_config Conf_;
+    mbedtls_ssl_context Ssl_;
+
+    bool SessionValid_;
+    std::string SessionHost_;
+    mbedtls_ssl_session Session_;
+
+    bool Setup();
+    bool BeginHandshake(const char* host, uint16_t port);
+    void SaveSession();
+    void Close();
+
+    static int Send(void* ctx, const unsigned char* buf, size_t len);
+    static int Recv(void* ctx, unsigned char* buf, size_t len);
+    static int Verify(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Client.h>
+
+// DPSとIoT Hubで共有するTLSクライアント
+// 同時に使えるのは1つだけなので、借り手が替わるときは前の接続を切る
+// 同じホストへの再接続では前回のTLSセッションを再開する
+class TlsTransport
+{
+public:
+    static Client& GetClient();
+    static int ConnectStep(const char* host, uint16_t port);
+    static bool IsSessionResumed();
+    static void Lend(const void* borrower);
+    static void Return(const void* borrower);
+
+private:
+    static const void* Borrower_;
+
+};
@@ -1,15 +1,68 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <cstdint>
+
+// 最後に接続できたアクセスポイント(次回はスキャンせずに直接つなぐ)
+struct WiFiConnectCache
+{
+	std::string Ssid;
+	uint8_t Bssid[6];
+	int32_t Channel;		// 0ならキャッシュ無し
+	uint32_t Ip;			// 0ならDHCP
+	uint32_t Gateway;
+	uint32_t Subnet;
+	uint32_t Dns;
+};
+
+struct WiFiConnectStats
+{
+	unsigned long Connects;
+	unsigned long FastConnects;		// キャッシュしたBSSIDでつながった数
+	unsigned long Failures;			// タイムアウトした試行の数
+	unsigned long LatencyLast;		// 切断を検出してからつながるまで[msec.]
+	unsigned long LatencyMax;		// [msec.]
+	unsigned long LatencySum;		// [msec.]
+};
 
 class WiFiManager
 {
 public:
+	WiFiManager();
+	WiFiManager(const WiFiManager&) = delete;
+	WiFiManager& operator=(const WiFiManager&) = delete;
+
 	void Connect(const char* ssid, const char* password);
+	void AddNetwork(const char* ssid, const char* password);
+	void SetCache(const WiFiConnectCache& cache, bool reuseIp);
 	bool IsConnected(bool reconnect = true);
 
+	const WiFiConnectCache& GetCache() const;
+	bool TakeCacheChanged();
+	const WiFiConnectStats& GetStats() const;
+
 private:
-	std::string Ssid_;
-	std::string Password_;
+	struct Network
+	{
+		std::string Ssid;
+		std::string Password;
+	};
+
+	std::vector<Network> Networks_;		// 優先順
+	WiFiConnectCache Cache_;
+	bool ReuseIp_;
+	bool CacheChanged_;
+	WiFiConnectStats Stats_;
+
+	bool Connected_;
+	bool Attempting_;
+	bool AttemptFast_;
+	unsigned long AttemptTime_;			// [msec.]
+	unsigned long DisconnectTime_;		// [msec.]
+	int NetworkIndex_;					// 次に試すネットワーク(-1ならキャッシュ)
+
+	void Begin();
+	void Connected();
 
 };
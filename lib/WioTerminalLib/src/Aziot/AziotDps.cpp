@@ -1,16 +1,20 @@
 #include "Aziot/AziotDps.h"
-#include <rpcWiFiClientSecure.h>
 #include <PubSubClient.h>
-#include <Network/Certificates.h>
 #include <Network/Signature.h>
+#include <Network/TlsTransport.h>
 
-static WiFiClientSecure Tcp_;	// TODO
+static PubSubClient Mqtt_(TlsTransport::GetClient());
+
+constexpr uint16_t SOCKET_TIMEOUT = 10;     // CONNACKを待つ時間(TLSの接続は含まない)[sec.]
 
 EasyAziotDpsClient AziotDps::DpsClient_;
 unsigned long AziotDps::DpsPublishTimeOfQueryStatus_ = 0;
 
 AziotDps::AziotDps() :
-    MqttPacketSize_(256)
+    MqttPacketSize_(256),
+    TimeoutMs_(60000),
+    State_(AziotDpsState::IDLE),
+    StartTime_(0)
 {
 }
 
@@ -19,7 +23,20 @@ void AziotDps::SetMqttPacketSize(int size)
     MqttPacketSize_ = size;
 }
 
-int AziotDps::RegisterDevice(const std::string& endpointHost, const std::string& idScope, const std::string& registrationId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime, std::string* hubHost, std::string* deviceId)
+void AziotDps::SetTimeout(unsigned long timeoutMs)
+{
+    TimeoutMs_ = timeoutMs;
+}
+
+void AziotDps::SetState(AziotDpsState state)
+{
+    if (state == State_) return;
+
+    State_ = state;
+    if (StateChangedCallback != nullptr) StateChangedCallback(state);
+}
+
+int AziotDps::Begin(const std::string& endpointHost, const std::string& idScope, const std::string& registrationId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime)
 {
     std::string endpointAndPort = endpointHost;
     endpointAndPort += ":";
@@ -28,30 +45,93 @@ int AziotDps::RegisterDevice(const std::string& endpointHost, const std::string&
     if (DpsClient_.Init(endpointAndPort.c_str(), idScope.c_str(), registrationId.c_str()) != 0) return -1;
     if (DpsClient_.SetSAS(symmetricKey.c_str(), expirationEpochTime, GenerateEncryptedSignature) != 0) return -2;
 
-	PubSubClient mqtt(Tcp_);
-    Tcp_.setCACert(CA_CERTS);
-    mqtt.setBufferSize(MqttPacketSize_);
-    mqtt.setServer(endpointHost.c_str(), 8883);
-    mqtt.setCallback(AziotDps::MqttSubscribeCallback);
-    if (!mqtt.connect(DpsClient_.GetMqttClientId().c_str(), DpsClient_.GetMqttUsername().c_str(), DpsClient_.GetMqttPassword().c_str())) return -3;
+    EndpointHost_ = endpointHost;
+    ModelId_ = modelId;
+    DpsPublishTimeOfQueryStatus_ = 0;
+    StartTime_ = millis();
+    SetState(AziotDpsState::CONNECTING);
 
-    mqtt.subscribe(DpsClient_.GetRegisterSubscribeTopic().c_str());
-    
-    mqtt.publish(DpsClient_.GetRegisterPublishTopic().c_str(), String::format("{payload:{\"modelId\":\"%s\"}}", modelId.c_str()).c_str());
+    return 0;
+}
 
-    while (!DpsClient_.IsRegisterOperationCompleted())
+// 呼ばれるたびに1ステップだけ進める
+AziotDpsState AziotDps::DoWork()
+{
+    switch (State_)
     {
-        mqtt.loop();
+    case AziotDpsState::CONNECTING:
+    {
+        // TLSのハンドシェイクは1回に1ステップずつ進める(時間の上限はTlsClientのハンドシェイクのタイムアウト)
+        TlsTransport::Lend(this);
+        const int tls = TlsTransport::ConnectStep(EndpointHost_.c_str(), 8883);
+        if (tls == 0) break;
+        if (tls < 0)
+        {
+            TlsTransport::Return(this);
+            SetState(AziotDpsState::FAILED);
+            break;
+        }
+
+        Mqtt_.setBufferSize(MqttPacketSize_);
+        Mqtt_.setServer(EndpointHost_.c_str(), 8883);
+        Mqtt_.setCallback(AziotDps::MqttSubscribeCallback);
+        Mqtt_.setSocketTimeout(SOCKET_TIMEOUT);
+        if (!Mqtt_.connect(DpsClient_.GetMqttClientId().c_str(), DpsClient_.GetMqttUsername().c_str(), DpsClient_.GetMqttPassword().c_str()))
+        {
+            TlsTransport::Return(this);
+            SetState(AziotDpsState::FAILED);
+            break;
+        }
+
+        Mqtt_.subscribe(DpsClient_.GetRegisterSubscribeTopic().c_str());
+        Mqtt_.publish(DpsClient_.GetRegisterPublishTopic().c_str(), String::format("{payload:{\"modelId\":\"%s\"}}", ModelId_.c_str()).c_str());
+        SetState(AziotDpsState::WAITING);
+        break;
+    }
+
+    case AziotDpsState::WAITING:
+        Mqtt_.loop();
         if (DpsPublishTimeOfQueryStatus_ > 0 && millis() >= DpsPublishTimeOfQueryStatus_)
         {
-            mqtt.publish(DpsClient_.GetQueryStatusPublishTopic().c_str(), "");
+            Mqtt_.publish(DpsClient_.GetQueryStatusPublishTopic().c_str(), "");
             DpsPublishTimeOfQueryStatus_ = 0;
         }
+
+        if (DpsClient_.IsRegisterOperationCompleted())
+        {
+            Mqtt_.disconnect();
+            TlsTransport::Return(this);
+            SetState(DpsClient_.IsAssigned() ? AziotDpsState::ASSIGNED : AziotDpsState::FAILED);
+        }
+        else if (!Mqtt_.connected())
+        {
+            TlsTransport::Return(this);
+            SetState(AziotDpsState::FAILED);
+        }
+        else if (millis() - StartTime_ >= TimeoutMs_)
+        {
+            Serial.printf("DPS registration timed out\n");
+            Mqtt_.disconnect();
+            TlsTransport::Return(this);
+            SetState(AziotDpsState::FAILED);
+        }
+        break;
+
+    default:
+        break;
     }
 
-    if (!DpsClient_.IsAssigned()) return -4;
+    return State_;
+}
+
+AziotDpsState AziotDps::GetState() const
+{
+    return State_;
+}
 
-    mqtt.disconnect();
+int AziotDps::GetResult(std::string* hubHost, std::string* deviceId)
+{
+    if (State_ != AziotDpsState::ASSIGNED) return -4;
 
     *hubHost = DpsClient_.GetHubHost();
     *deviceId = DpsClient_.GetDeviceId();
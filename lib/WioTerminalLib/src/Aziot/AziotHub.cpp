@@ -1,29 +1,167 @@
 #include "Aziot/AziotHub.h"
-#include <rpcWiFiClientSecure.h>
 #include <PubSubClient.h>
-#include <Network/Certificates.h>
+#include <cstring>
 #include <Network/Signature.h>
+#include <Network/MqttAckClient.h>
+#include <Network/TlsTransport.h>
 
-static WiFiClientSecure Tcp_;	// TODO
-static PubSubClient Mqtt_(Tcp_);
+static MqttAckClient AckClient_(TlsTransport::GetClient());
+static PubSubClient Mqtt_(AckClient_);
 
-std::function<void(const char* json, const char* requestId)> AziotHub::ReceivedTwinDocumentCallback;
-std::function<void(const char* json, const char* version)> AziotHub::ReceivedTwinDesiredPatchCallback;
+std::function<void(char* json, size_t length, az_span requestId)> AziotHub::ReceivedTwinDocumentCallback;
+std::function<void(char* json, size_t length, az_span version)> AziotHub::ReceivedTwinDesiredPatchCallback;
 EasyAziotHubClient AziotHub::HubClient_;
+size_t AziotHub::TwinLogMaxLength_ = 0;
+unsigned long AziotHub::TwinLogMinInterval_ = 0;
+
+constexpr unsigned long BACKOFF_INITIAL = 5000;        // [msec.]
+constexpr unsigned long BACKOFF_MAX = 5 * 60 * 1000;    // [msec.]
+constexpr uint16_t SOCKET_TIMEOUT = 10;                 // CONNACKを待つ時間(TLSの接続は含まない)[sec.]
+constexpr uint64_t PREPARED_SAS_TOLERANCE = 10 * 60;    // 事前計算したSASの有効期限の許容差[sec.]
+constexpr unsigned long PUBACK_TIMEOUT = 30000;         // これを過ぎたらPUBACKを待たずに再送[msec.]
 
 AziotHub::AziotHub() :
-    MqttPacketSize_(256)
+    MqttPacketSize_(256),
+    KeepAlive_(MQTT_KEEPALIVE),
+    PublishBuffer_(256),
+    PublishQos_(0),
+    State_(AziotHubState::STOPPED),
+    Backoff_(BACKOFF_INITIAL, BACKOFF_MAX),
+    RetryTime_(0),
+    ConnectStartTime_(0),
+    ConnectRejected_(false)
 {
+    TelemetryTopic_[0] = '\0';
+    AckClient_.PubAckCallback = [this](uint16_t packetId) { ReceivedPubAck(packetId); };
 }
 
 void AziotHub::SetMqttPacketSize(int size)
 {
     MqttPacketSize_ = size;
+    if (PublishBuffer_.size() < MqttPacketSize_) PublishBuffer_.resize(MqttPacketSize_);
+}
+
+// テレメトリはPubSubClientのバッファを通らないので、MQTTパケットサイズより大きくできる
+void AziotHub::SetPublishBufferSize(int size)
+{
+    PublishBuffer_.resize(size);
+}
+
+// 次の接続から有効[sec.]
+// 送信間隔より長くすれば、送信の合間にPINGで無線を起こさずに済む
+void AziotHub::SetKeepAlive(uint16_t keepAlive)
+{
+    KeepAlive_ = keepAlive;
+}
+
+// qos=1ならwindow個までPUBACKを待たずに続けて送る
+// 送信待ちのトピックと本文は合わせてbufferSizeバイトの領域に置く(ここで確保)
+void AziotHub::SetPublishQos(int qos, int window, size_t bufferSize)
+{
+    PublishQos_ = qos >= 1 ? 1 : 0;
+    if (PublishQos_ == 0)
+    {
+        InFlight_.Init(1, 0);
+        return;
+    }
+
+    InFlight_.Init(window, bufferSize);
+}
+
+void AziotHub::SetState(AziotHubState state)
+{
+    if (state == State_) return;
+
+    State_ = state;
+    if (state == AziotHubState::CONNECTING) ConnectStartTime_ = millis();
+    if (StateChangedCallback != nullptr) StateChangedCallback(state);
+}
+
+// 接続を維持する(DoWork()から1ステップずつ接続、失敗したらバックオフして再試行)
+void AziotHub::Start(const std::string& host, const std::string& deviceId, const std::string& symmetricKey, const std::string& modelId, std::function<uint64_t()> expirationEpochTime)
+{
+    Host_ = host;
+    DeviceId_ = deviceId;
+    SymmetricKey_ = symmetricKey;
+    ModelId_ = modelId;
+    ExpirationEpochTime_ = expirationEpochTime;
+    Backoff_.Reset();
+    SetState(AziotHubState::DISCONNECTED);
+}
+
+void AziotHub::Stop()
+{
+    Mqtt_.disconnect();
+    TlsTransport::Return(this);
+    SetState(AziotHubState::STOPPED);
+}
+
+AziotHubState AziotHub::GetState() const
+{
+    return State_;
+}
+
+// 直前の接続失敗がハブからの拒否(割り当てや資格情報が無効というCONNACK)だったか
+// サーバー不可(MQTT_CONNECT_UNAVAILABLE)などの一時的なエラーは含めない
+bool AziotHub::IsConnectRejected() const
+{
+    return ConnectRejected_;
 }
 
 void AziotHub::DoWork()
 {
-    Mqtt_.loop();
+    switch (State_)
+    {
+    case AziotHubState::DISCONNECTED:
+        SetState(AziotHubState::CONNECTING);
+        break;
+
+    case AziotHubState::CONNECTING:
+    {
+        // TLSのハンドシェイクは1回に1ステップずつ進め、その合間に他のタスクを動かす
+        TlsTransport::Lend(this);
+        const int tls = TlsTransport::ConnectStep(Host_.c_str(), 8883);
+        if (tls == 0) break;
+        if (tls > 0) Serial.printf("Hub TLS: %lu ms%s\n", millis() - ConnectStartTime_, TlsTransport::IsSessionResumed() ? " (resumed)" : "");
+
+        const int result = tls < 0 ? -4 : Connect(Host_, DeviceId_, SymmetricKey_, ModelId_, ExpirationEpochTime_());
+        ConnectRejected_ = result == -3 &&
+            (Mqtt_.state() == MQTT_CONNECT_BAD_CLIENT_ID ||
+             Mqtt_.state() == MQTT_CONNECT_BAD_CREDENTIALS ||
+             Mqtt_.state() == MQTT_CONNECT_UNAUTHORIZED);
+        if (result == 0)
+        {
+            Backoff_.Reset();
+            RetransmitInFlight(false);      // 前の接続でPUBACKが来なかったものを送り直す
+            SetState(AziotHubState::CONNECTED);
+        }
+        else
+        {
+            const unsigned long wait = Backoff_.Next();
+            Serial.printf("> ERROR. Try again in %lu msec.\n", wait);
+            RetryTime_ = millis() + wait;
+            SetState(AziotHubState::BACKOFF);
+        }
+        break;
+    }
+
+    case AziotHubState::BACKOFF:
+        if (static_cast<long>(millis() - RetryTime_) >= 0) SetState(AziotHubState::CONNECTING);
+        break;
+
+    case AziotHubState::CONNECTED:
+        if (!Mqtt_.loop())
+        {
+            Serial.printf("Hub connection lost (state %d)\n", Mqtt_.state());
+            SetState(AziotHubState::DISCONNECTED);
+            break;
+        }
+        RetransmitInFlight(true);
+        break;
+
+    default:
+        break;
+    }
 }
 
 bool AziotHub::IsConnected()
@@ -33,8 +171,12 @@ bool AziotHub::IsConnected()
 
 int AziotHub::Connect(const std::string& host, const std::string& deviceId, const std::string& symmetricKey, const std::string& modelId, const uint64_t& expirationEpochTime)
 {
+    const unsigned long startTime = millis();
     if (HubClient_.Init(host.c_str(), deviceId.c_str(),  modelId.c_str()) != 0) return -1;
-    if (HubClient_.SetSAS(symmetricKey.c_str(), expirationEpochTime, GenerateEncryptedSignature) != 0) return -2;
+    if (UpdateTelemetryTopic() != 0) return -1;
+    const bool prepared = HubClient_.UsePreparedSAS(expirationEpochTime - PREPARED_SAS_TOLERANCE);
+    if (!prepared && HubClient_.SetSAS(symmetricKey.c_str(), expirationEpochTime, GenerateEncryptedSignature) != 0) return -2;
+    const unsigned long sasTime = millis() - startTime;
 
     Serial.println("Hub:");
     Serial.print(" Host = ");
@@ -46,11 +188,16 @@ int AziotHub::Connect(const std::string& host, const std::string& deviceId, cons
     Serial.print(" MQTT username = ");
     Serial.println(HubClient_.GetMqttUsername().c_str());
 
-    Tcp_.setCACert(CA_CERTS);
+    TlsTransport::Lend(this);
     Mqtt_.setBufferSize(MqttPacketSize_);
     Mqtt_.setServer(host.c_str(), 8883);
     Mqtt_.setCallback(MqttSubscribeCallback);
-    if (!Mqtt_.connect(HubClient_.GetMqttClientId().c_str(), HubClient_.GetMqttUsername().c_str(), HubClient_.GetMqttPassword().c_str())) return -3;
+    Mqtt_.setSocketTimeout(SOCKET_TIMEOUT);
+    Mqtt_.setKeepAlive(KeepAlive_);
+    const unsigned long connectStartTime = millis();
+    const bool connected = Mqtt_.connect(HubClient_.GetMqttClientId().c_str(), HubClient_.GetMqttUsername().c_str(), HubClient_.GetMqttPassword().c_str());
+    Serial.printf("Hub connect: SAS %lu ms%s, MQTT %lu ms\n", sasTime, prepared ? " (prepared)" : "", millis() - connectStartTime);
+    if (!connected) return -3;
 
     Mqtt_.subscribe(AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_SUBSCRIBE_TOPIC);
     Mqtt_.subscribe(AZ_IOT_HUB_CLIENT_TWIN_PATCH_SUBSCRIBE_TOPIC);
@@ -61,25 +208,136 @@ int AziotHub::Connect(const std::string& host, const std::string& deviceId, cons
 void AziotHub::Disconnect()
 {
     Mqtt_.disconnect();
+    if (State_ != AziotHubState::STOPPED) SetState(AziotHubState::DISCONNECTED);
 }
 
-void AziotHub::SendTelemetry(const char* payload)
+// トークン更新の前に次のSASを計算しておき、再接続時の処理を短くする
+int AziotHub::PrepareReconnect(const uint64_t& expirationEpochTime)
 {
-    std::string telemetryTopic = HubClient_.GetTelemetryPublishTopic();
+    if (State_ != AziotHubState::CONNECTED) return -1;
+
+    return HubClient_.PrepareSAS(SymmetricKey_.c_str(), expirationEpochTime, GenerateEncryptedSignature);
+}
 
+bool AziotHub::SendTelemetry(const char* payload)
+{
+    return SendTelemetry(payload, strlen(payload));
+}
+
+// PubSubClientのバッファにコピーせず、トピックと本文を直接送る(ヒープを使わない)
+// QoS1のときは送信待ちの領域にコピーし、PUBACKが来るまで保持する
+bool AziotHub::SendTelemetry(const char* payload, size_t length)
+{
     static int sendCount = 0;
-    if (!Mqtt_.publish(telemetryTopic.c_str(), payload, false))
+    const unsigned long startTime = micros();
+    bool sent;
+    if (PublishQos_ == 0)
+    {
+        sent =
+            TelemetryTopic_[0] != '\0' &&
+            Mqtt_.beginPublish(TelemetryTopic_, length, false) &&
+            Mqtt_.write(reinterpret_cast<const uint8_t*>(payload), length) == length &&
+            Mqtt_.endPublish();
+    }
+    else
+    {
+        if (TelemetryTopic_[0] == '\0') return false;
+
+        const PublishWindow::Entry* entry = InFlight_.Add(TelemetryTopic_, payload, length, millis());
+        if (entry == nullptr)
+        {
+            Serial.printf("ERROR: Send telemetry %d (window full)\n", sendCount);
+            return false;
+        }
+
+        // 送れなくても保持しているので、再接続後に送り直す
+        sent = true;
+        if (!WritePublish(InFlight_.GetTopic(*entry), entry->PacketId, InFlight_.GetPayload(*entry), entry->Length, false)) Serial.printf("Send telemetry %d deferred\n", sendCount + 1);
+    }
+
+    if (!sent)
     {
         Serial.printf("ERROR: Send telemetry %d\n", sendCount);
-        return; // TODO
+        return false;
     }
     else
     {
         ++sendCount;
-        Serial.printf("Sent telemetry %d\n", sendCount);
+        Serial.printf("Sent telemetry %d (%u bytes, %lu us)\n", sendCount, static_cast<unsigned>(length), micros() - startTime);
+        return true;
     }
 }
 
+// QoS1のPUBLISHパケットを組み立てて送る
+bool AziotHub::WritePublish(const char* topic, uint16_t packetId, const uint8_t* payload, size_t length, bool duplicate)
+{
+    if (!Mqtt_.connected()) return false;
+
+    uint8_t header[MqttAckClient::PUBLISH_HEADER_OVERHEAD + TELEMETRY_PUBLISH_TOPIC_MAX_SIZE];
+    const size_t headerLength = MqttAckClient::EncodePublishHeader(header, topic, packetId, length, duplicate);
+
+    return
+        AckClient_.write(header, headerLength) == headerLength &&
+        AckClient_.write(payload, length) == length;
+}
+
+// timeoutOnly=falseなら全て、trueならPUBACKが遅れているものだけ送り直す
+void AziotHub::RetransmitInFlight(bool timeoutOnly)
+{
+    InFlight_.Retransmit(millis(), PUBACK_TIMEOUT, timeoutOnly, [this](const char* topic, uint16_t packetId, const uint8_t* payload, size_t length)
+    {
+        if (!WritePublish(topic, packetId, payload, length, true)) return false;
+        Serial.printf("Retransmit telemetry (packet id %u)\n", packetId);
+        return true;
+    });
+}
+
+void AziotHub::ReceivedPubAck(uint16_t packetId)
+{
+    InFlight_.Ack(packetId, millis());
+}
+
+int AziotHub::GetInFlightCount() const
+{
+    return InFlight_.GetCount();
+}
+
+const AziotHubPublishStats& AziotHub::GetPublishStats() const
+{
+    return InFlight_.GetStats();
+}
+
+void AziotHub::ResetPublishStats()
+{
+    InFlight_.ResetStats();
+}
+
+// テレメトリのメッセージプロパティ(URLエンコード済み、空なら付けない)
+void AziotHub::SetTelemetryProperties(const char* contentType, const char* contentEncoding)
+{
+    TelemetryContentType_ = contentType != nullptr ? contentType : "";
+    TelemetryContentEncoding_ = contentEncoding != nullptr ? contentEncoding : "";
+    if (State_ == AziotHubState::CONNECTED) UpdateTelemetryTopic();
+}
+
+int AziotHub::UpdateTelemetryTopic()
+{
+    return HubClient_.GetTelemetryPublishTopic(TelemetryTopic_, sizeof(TelemetryTopic_),
+        TelemetryContentType_.empty() ? nullptr : TelemetryContentType_.c_str(),
+        TelemetryContentEncoding_.empty() ? nullptr : TelemetryContentEncoding_.c_str());
+}
+
+// テレメトリを直接シリアライズするための領域(SetPublishBufferSize()で確保)
+char* AziotHub::GetPublishBuffer()
+{
+    return PublishBuffer_.data();
+}
+
+size_t AziotHub::GetPublishBufferSize() const
+{
+    return PublishBuffer_.size();
+}
+
 void AziotHub::RequestTwinDocument(const char* requestId)
 {
     Mqtt_.publish(HubClient_.GetTwinDocumentPublishTopic(requestId).c_str(), nullptr);
@@ -90,29 +348,46 @@ void AziotHub::SendTwinPatch(const char* requestId, const char* payload)
     Mqtt_.publish(HubClient_.GetTwinPatchPublishTopic(requestId).c_str(), payload);
 }
 
-void AziotHub::MqttSubscribeCallback(char* topic, uint8_t* payload, unsigned int length)
+// 本文の表示はmaxLengthバイトまで、minInterval[msec.]に1回まで
+// maxLength=0なら表示しない
+void AziotHub::SetTwinLog(size_t maxLength, unsigned long minInterval)
 {
-    Serial.printf("Received twin\n");
-    Serial.printf(" topic  :%s\n", topic);
-    Serial.print("payload:");
-    for (int i = 0; i < static_cast<int>(length); i++) Serial.print(static_cast<char>(payload[i]));
-    Serial.println();
+    TwinLogMaxLength_ = maxLength;
+    TwinLogMinInterval_ = minInterval;
+}
 
+// 受信バッファの上でそのまま処理する(コピーしない)
+void AziotHub::MqttSubscribeCallback(char* topic, uint8_t* payload, unsigned int length)
+{
     EasyAziotHubClient::TwinResponse response;
-    if (HubClient_.ParseTwinTopic(topic, response) == 0)
+    const bool parsed = HubClient_.ParseTwinTopic(topic, response) == 0;
+    Serial.printf("Received twin (type %d, %u bytes)\n", parsed ? static_cast<int>(response.ResponseType) : -1, length);
+
+    static bool logged = false;
+    static unsigned long logTime;
+    if (TwinLogMaxLength_ > 0 && (!logged || millis() - logTime >= TwinLogMinInterval_))
     {
-        std::string json(reinterpret_cast<char*>(payload), reinterpret_cast<char*>(payload) + length);
+        logged = true;
+        logTime = millis();
+        Serial.printf(" topic  :%s\n", topic);
+        Serial.print(" payload:");
+        Serial.write(payload, length < TwinLogMaxLength_ ? length : TwinLogMaxLength_);
+        if (length > TwinLogMaxLength_) Serial.print("...");
+        Serial.println();
+    }
 
-        switch (response.ResponseType)
-        {
-        case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_GET:
-            if (ReceivedTwinDocumentCallback != nullptr) ReceivedTwinDocumentCallback(json.c_str(), response.RequestId.c_str());
-            break;
-        case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_DESIRED_PROPERTIES:
-            if (ReceivedTwinDesiredPatchCallback != nullptr) ReceivedTwinDesiredPatchCallback(json.c_str(), response.Version.c_str());
-            break;
-        case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_REPORTED_PROPERTIES:
-            break;
-        }
+    if (!parsed) return;
+
+    char* json = reinterpret_cast<char*>(payload);
+    switch (response.ResponseType)
+    {
+    case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_GET:
+        if (ReceivedTwinDocumentCallback != nullptr) ReceivedTwinDocumentCallback(json, length, response.RequestId);
+        break;
+    case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_DESIRED_PROPERTIES:
+        if (ReceivedTwinDesiredPatchCallback != nullptr) ReceivedTwinDesiredPatchCallback(json, length, response.Version);
+        break;
+    case AZ_IOT_HUB_CLIENT_TWIN_RESPONSE_TYPE_REPORTED_PROPERTIES:
+        break;
     }
 }
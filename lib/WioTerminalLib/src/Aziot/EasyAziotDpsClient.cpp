@@ -61,6 +61,7 @@ int EasyAziotDpsClient::SetSAS(const char* symmetricKey, const uint64_t& expirat
             signature.assign(az_span_ptr(signatureValidSpan), az_span_ptr(signatureValidSpan) + az_span_size(signatureValidSpan));
         }
         encryptedSignature = generateEncryptedSignature(symmetricKey, signature);
+        if (encryptedSignature.empty()) return -6;  // SIGNATURE
     }
 
     {
@@ -7,12 +7,14 @@ static inline const az_span az_span_create_from_string(const std::string& str)
     return az_span_create(reinterpret_cast<uint8_t*>(const_cast<char*>(str.c_str())), str.size());
 }
 
-EasyAziotHubClient::EasyAziotHubClient()
+EasyAziotHubClient::EasyAziotHubClient() :
+    PreparedExpirationEpochTime_(0)
 {
 }
 
 int EasyAziotHubClient::Init(const char* host, const char* deviceId, const char* modelId)
 {
+    const bool sameDevice = Host_ == host && DeviceId_ == deviceId;
     Host_ = host;
     DeviceId_ = deviceId;
     ModelId_ = modelId;
@@ -39,11 +41,48 @@ int EasyAziotHubClient::Init(const char* host, const char* deviceId, const char*
     }
 
     MqttPassword_.clear();
+    if (!sameDevice)
+    {
+        // 署名は接続先とデバイスIDに依存する
+        PreparedMqttPassword_.clear();
+        PreparedExpirationEpochTime_ = 0;
+    }
 
     return 0;
 }
 
 int EasyAziotHubClient::SetSAS(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature)
+{
+    return GeneratePassword(symmetricKey, expirationEpochTime, generateEncryptedSignature, &MqttPassword_);
+}
+
+// 次回接続用のパスワードを事前に計算しておく(接続時の署名計算を省く)
+int EasyAziotHubClient::PrepareSAS(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature)
+{
+    PreparedMqttPassword_.clear();
+    PreparedExpirationEpochTime_ = 0;
+
+    const int result = GeneratePassword(symmetricKey, expirationEpochTime, generateEncryptedSignature, &PreparedMqttPassword_);
+    if (result != 0) return result;
+
+    PreparedExpirationEpochTime_ = expirationEpochTime;
+
+    return 0;
+}
+
+// 事前に計算したパスワードの有効期限がminExpirationEpochTime以降なら、それに切り替える
+bool EasyAziotHubClient::UsePreparedSAS(const uint64_t& minExpirationEpochTime)
+{
+    if (PreparedMqttPassword_.empty() || PreparedExpirationEpochTime_ < minExpirationEpochTime) return false;
+
+    MqttPassword_.swap(PreparedMqttPassword_);
+    PreparedMqttPassword_.clear();
+    PreparedExpirationEpochTime_ = 0;
+
+    return true;
+}
+
+int EasyAziotHubClient::GeneratePassword(const char* symmetricKey, const uint64_t& expirationEpochTime, std::function<std::string(const std::string& symmetricKey, const std::vector<uint8_t>& signature)> generateEncryptedSignature, std::string* password)
 {
     ////////////////////
     // SAS auth
@@ -59,13 +98,14 @@ int EasyAziotHubClient::SetSAS(const char* symmetricKey, const uint64_t& expirat
             signature.assign(az_span_ptr(signatureValidSpan), az_span_ptr(signatureValidSpan) + az_span_size(signatureValidSpan));
         }
         encryptedSignature = generateEncryptedSignature(symmetricKey, signature);
+        if (encryptedSignature.empty()) return -6;  // SIGNATURE
     }
 
     {
         char mqttPassword[MQTT_PASSWORD_MAX_SIZE];
         const az_span encryptedSignatureSpan = az_span_create_from_string(encryptedSignature);
         if (az_result_failed(az_iot_hub_client_sas_get_password(&HubClient_, expirationEpochTime, encryptedSignatureSpan, AZ_SPAN_EMPTY, mqttPassword, sizeof(mqttPassword), nullptr))) return -5;  // SDK_API
-        MqttPassword_ = mqttPassword;
+        *password = mqttPassword;
     }
 
     return 0;
@@ -86,12 +126,18 @@ const std::string& EasyAziotHubClient::GetMqttPassword() const
     return MqttPassword_;
 }
 
-std::string EasyAziotHubClient::GetTelemetryPublishTopic()
+// contentType, contentEncodingはURLエンコード済みの値(nullptrなら付けない)
+int EasyAziotHubClient::GetTelemetryPublishTopic(char* topic, size_t size, const char* contentType, const char* contentEncoding)
 {
-    char telemetryPublishTopic[TELEMETRY_PUBLISH_TOPIC_MAX_SIZE];
-    if (az_result_failed(az_iot_hub_client_telemetry_get_publish_topic(&HubClient_, nullptr, telemetryPublishTopic, sizeof(telemetryPublishTopic), nullptr))) return std::string(); // SDK_API
+    uint8_t propertiesBuf[TELEMETRY_PROPERTIES_MAX_SIZE];
+    az_iot_message_properties properties;
+    if (az_result_failed(az_iot_message_properties_init(&properties, AZ_SPAN_FROM_BUFFER(propertiesBuf), 0))) return -1;    // SDK_API
+    if (contentType != nullptr && az_result_failed(az_iot_message_properties_append(&properties, AZ_SPAN_FROM_STR(AZ_IOT_MESSAGE_PROPERTIES_CONTENT_TYPE), az_span_create_from_str(const_cast<char*>(contentType))))) return -1;             // SDK_API
+    if (contentEncoding != nullptr && az_result_failed(az_iot_message_properties_append(&properties, AZ_SPAN_FROM_STR(AZ_IOT_MESSAGE_PROPERTIES_CONTENT_ENCODING), az_span_create_from_str(const_cast<char*>(contentEncoding))))) return -1; // SDK_API
 
-    return telemetryPublishTopic;
+    if (az_result_failed(az_iot_hub_client_telemetry_get_publish_topic(&HubClient_, &properties, topic, size, nullptr))) return -1; // SDK_API
+
+    return 0;
 }
 
 std::string EasyAziotHubClient::GetTwinDocumentPublishTopic(const char* requestId)
@@ -110,36 +156,16 @@ std::string EasyAziotHubClient::GetTwinPatchPublishTopic(const char* requestId)
     return twinPatchPublishTopic;
 }
 
-int EasyAziotHubClient::ParseTwinTopic(const char* topic, EasyAziotHubClient::TwinResponse& twinResponse)
+int EasyAziotHubClient::ParseTwinTopic(char* topic, EasyAziotHubClient::TwinResponse& twinResponse)
 {
     az_iot_hub_client_twin_response response;
-    const az_span topicSpan = az_span_create_from_str(const_cast<char*>(topic));
+    const az_span topicSpan = az_span_create_from_str(topic);
     if (az_result_failed(az_iot_hub_client_twin_parse_received_topic(&HubClient_, topicSpan, &response))) return -1;
 
-    if (az_span_size(response.request_id) <= 0)
-    {
-        twinResponse.RequestId.clear();
-    }
-    else
-    {
-        char requestId[az_span_size(response.request_id) + 1];
-        az_span_to_str(requestId, sizeof(requestId), response.request_id);
-        twinResponse.RequestId = requestId;
-    }
-
+    twinResponse.RequestId = response.request_id;
     twinResponse.Status = response.status;
     twinResponse.ResponseType = response.response_type;
-
-    if (az_span_size(response.version) <= 0)
-    {
-        twinResponse.Version.clear();
-    }
-    else
-    {
-        char version[az_span_size(response.version) + 1];
-        az_span_to_str(version, sizeof(version), response.version);
-        twinResponse.Version = version;
-    }
+    twinResponse.Version = response.version;
 
     return 0;
 }
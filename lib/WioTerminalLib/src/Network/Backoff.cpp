@@ -0,0 +1,24 @@
+#include "Network/Backoff.h"
+#include <Arduino.h>
+
+Backoff::Backoff(unsigned long initialMs, unsigned long maxMs) :
+    InitialMs_(initialMs),
+    MaxMs_(maxMs),
+    CurrentMs_(initialMs)
+{
+}
+
+void Backoff::Reset()
+{
+    CurrentMs_ = InitialMs_;
+}
+
+// 次の待ち時間を返す(±25%のジッタ)
+unsigned long Backoff::Next()
+{
+    const unsigned long base = CurrentMs_;
+    CurrentMs_ = CurrentMs_ * 2 > MaxMs_ ? MaxMs_ : CurrentMs_ * 2;
+
+    const long jitter = static_cast<long>(base / 4);
+    return base + random(-jitter, jitter + 1);
+}
@@ -0,0 +1,150 @@
+#include "Network/MqttAckClient.h"
+#include <cstring>
+
+constexpr uint8_t MQTT_PUBLISH = 3;
+constexpr uint8_t MQTT_PUBACK = 4;
+constexpr uint8_t MQTT_FLAG_DUP = 0x08;
+constexpr uint8_t MQTT_FLAG_QOS1 = 0x02;
+
+constexpr size_t MqttAckClient::PUBLISH_HEADER_OVERHEAD;
+
+MqttAckClient::MqttAckClient(Client& client) :
+    Client_(client)
+{
+    ResetParser();
+}
+
+void MqttAckClient::ResetParser()
+{
+    State_ = ParseState::HEADER;
+    Type_ = 0;
+    Remaining_ = 0;
+    Multiplier_ = 1;
+    BodyPos_ = 0;
+    PacketId_ = 0;
+}
+
+// 固定ヘッダ → 残りの長さ(可変長) → 本体 の順に1バイトずつ追う
+void MqttAckClient::Parse(uint8_t data)
+{
+    switch (State_)
+    {
+    case ParseState::HEADER:
+        Type_ = data >> 4;
+        Remaining_ = 0;
+        Multiplier_ = 1;
+        BodyPos_ = 0;
+        PacketId_ = 0;
+        State_ = ParseState::LENGTH;
+        break;
+
+    case ParseState::LENGTH:
+        Remaining_ += (data & 0x7f) * Multiplier_;
+        Multiplier_ *= 128;
+        if (data & 0x80) break;
+        State_ = Remaining_ > 0 ? ParseState::BODY : ParseState::HEADER;
+        break;
+
+    case ParseState::BODY:
+        if (Type_ == MQTT_PUBACK && BodyPos_ < 2) PacketId_ = (PacketId_ << 8) | data;
+        if (++BodyPos_ < Remaining_) break;
+
+        if (Type_ == MQTT_PUBACK && PubAckCallback != nullptr) PubAckCallback(PacketId_);
+        State_ = ParseState::HEADER;
+        break;
+    }
+}
+
+size_t MqttAckClient::EncodePublishHeader(uint8_t* buf, const char* topic, uint16_t packetId, size_t payloadLength, bool duplicate)
+{
+    const size_t topicLength = strlen(topic);
+    uint32_t remaining = 2 + topicLength + 2 + payloadLength;
+
+    size_t pos = 0;
+    buf[pos++] = MQTT_PUBLISH << 4 | MQTT_FLAG_QOS1 | (duplicate ? MQTT_FLAG_DUP : 0x00);
+    do
+    {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        if (remaining > 0) digit |= 0x80;
+        buf[pos++] = digit;
+    }
+    while (remaining > 0);
+    buf[pos++] = topicLength >> 8;
+    buf[pos++] = topicLength;
+    memcpy(&buf[pos], topic, topicLength);
+    pos += topicLength;
+    buf[pos++] = packetId >> 8;
+    buf[pos++] = packetId;
+
+    return pos;
+}
+
+int MqttAckClient::connect(IPAddress ip, uint16_t port)
+{
+    ResetParser();
+    return Client_.connect(ip, port);
+}
+
+int MqttAckClient::connect(const char* host, uint16_t port)
+{
+    ResetParser();
+    return Client_.connect(host, port);
+}
+
+size_t MqttAckClient::write(uint8_t data)
+{
+    return Client_.write(data);
+}
+
+size_t MqttAckClient::write(const uint8_t* buf, size_t size)
+{
+    return Client_.write(buf, size);
+}
+
+int MqttAckClient::available()
+{
+    return Client_.available();
+}
+
+int MqttAckClient::read()
+{
+    const int data = Client_.read();
+    if (data >= 0) Parse(static_cast<uint8_t>(data));
+
+    return data;
+}
+
+int MqttAckClient::read(uint8_t* buf, size_t size)
+{
+    const int length = Client_.read(buf, size);
+    for (int i = 0; i < length; ++i) Parse(buf[i]);
+
+    return length;
+}
+
+int MqttAckClient::peek()
+{
+    return Client_.peek();
+}
+
+void MqttAckClient::flush()
+{
+    Client_.flush();
+}
+
+void MqttAckClient::stop()
+{
+    Client_.stop();
+    ResetParser();
+}
+
+uint8_t MqttAckClient::connected()
+{
+    return Client_.connected();
+}
+
+MqttAckClient::operator bool()
+{
+    return static_cast<bool>(Client_);
+}
@@ -0,0 +1,189 @@
+#include "Network/PublishWindow.h"
+#include <cstring>
+
+PublishWindow::PublishWindow() :
+    First_(0),
+    Count_(0),
+    NextPacketId_(1)
+{
+    ResetStats();
+}
+
+// window個までPUBACKを待たずに送る
+// bufferSizeは全てのメッセージのトピックと本文の合計の上限(1つのメッセージもこれを越えられない)
+void PublishWindow::Init(int window, size_t bufferSize)
+{
+    Entries_.assign(window >= 1 ? window : 1, Entry());
+    Buffer_.assign(bufferSize, 0);
+    Clear();
+}
+
+void PublishWindow::Clear()
+{
+    for (auto& entry : Entries_) entry.Used = false;
+    First_ = 0;
+    Count_ = 0;
+}
+
+PublishWindow::Entry& PublishWindow::At(int index)
+{
+    return Entries_[(First_ + index) % Entries_.size()];
+}
+
+// 最後のメッセージの後ろに続けて置き、足りなければ先頭に折り返す
+bool PublishWindow::Allocate(size_t size, size_t* offset) const
+{
+    if (size > Buffer_.size()) return false;
+    if (Count_ == 0)
+    {
+        *offset = 0;
+        return true;
+    }
+
+    const Entry& first = Entries_[First_];
+    const Entry& last = Entries_[(First_ + Count_ - 1) % Entries_.size()];
+    const size_t head = first.Offset;
+    const size_t tail = last.Offset + last.TopicLength + 1 + last.Length;
+    if (last.Offset >= head)
+    {
+        if (tail + size <= Buffer_.size())
+        {
+            *offset = tail;
+            return true;
+        }
+        if (size <= head)
+        {
+            *offset = 0;
+            return true;
+        }
+        return false;
+    }
+    if (tail + size <= head)
+    {
+        *offset = tail;
+        return true;
+    }
+
+    return false;
+}
+
+// 空きが無いときや大きすぎるときはnullptrを返す
+const PublishWindow::Entry* PublishWindow::Add(const char* topic, const void* payload, size_t length, unsigned long now)
+{
+    if (Entries_.empty()) return nullptr;
+
+    const size_t topicLength = strlen(topic);
+    const size_t size = topicLength + 1 + length;
+    if (size > Buffer_.size()) return nullptr;
+
+    size_t offset;
+    if (Count_ >= static_cast<int>(Entries_.size()) || !Allocate(size, &offset))
+    {
+        ++Stats_.WindowFull;
+        return nullptr;
+    }
+
+    Entry& entry = At(Count_++);
+    entry.Used = true;
+    entry.PacketId = NextPacketId_;
+    NextPacketId_ = NextPacketId_ == 0xffff ? 1 : NextPacketId_ + 1;
+    entry.FirstSendTime = now;
+    entry.SendTime = now;
+    entry.Offset = offset;
+    entry.TopicLength = topicLength;
+    entry.Length = length;
+    memcpy(Buffer_.data() + offset, topic, topicLength + 1);
+    if (length > 0) memcpy(Buffer_.data() + offset + topicLength + 1, payload, length);
+    ++Stats_.Published;
+
+    return &entry;
+}
+
+// 知らないパケットIDならfalse
+bool PublishWindow::Ack(uint16_t packetId, unsigned long now)
+{
+    for (int i = 0; i < Count_; ++i)
+    {
+        Entry& entry = At(i);
+        if (!entry.Used || entry.PacketId != packetId) continue;
+
+        const unsigned long latency = now - entry.FirstSendTime;
+        entry.Used = false;
+        ++Stats_.Acked;
+        Stats_.LatencySum += latency;
+        if (latency > Stats_.LatencyMax) Stats_.LatencyMax = latency;
+
+        // 先頭から続けてPUBACKが来たものの領域を空ける
+        while (Count_ > 0 && !At(0).Used)
+        {
+            First_ = (First_ + 1) % Entries_.size();
+            --Count_;
+        }
+        if (Count_ == 0) First_ = 0;
+        return true;
+    }
+
+    return false;
+}
+
+// timeoutOnly=falseなら全て、trueならtimeout[msec.]過ぎてもPUBACKが来ないものを送った順に送り直す
+// sendがfalseを返したらそこで止める。送り直した数を返す
+int PublishWindow::Retransmit(unsigned long now, unsigned long timeout, bool timeoutOnly, const Sender& send)
+{
+    int count = 0;
+    for (int i = 0; i < Count_; ++i)
+    {
+        Entry& entry = At(i);
+        if (!entry.Used) continue;
+        if (timeoutOnly && now - entry.SendTime < timeout) continue;
+
+        if (!send(GetTopic(entry), entry.PacketId, GetPayload(entry), entry.Length)) break;
+        entry.SendTime = now;
+        ++Stats_.Retransmitted;
+        ++count;
+    }
+
+    return count;
+}
+
+const char* PublishWindow::GetTopic(const Entry& entry) const
+{
+    return reinterpret_cast<const char*>(Buffer_.data() + entry.Offset);
+}
+
+const uint8_t* PublishWindow::GetPayload(const Entry& entry) const
+{
+    return Buffer_.data() + entry.Offset + entry.TopicLength + 1;
+}
+
+// PUBACKを待っている数
+int PublishWindow::GetCount() const
+{
+    int count = 0;
+    for (int i = 0; i < Count_; ++i)
+    {
+        if (Entries_[(First_ + i) % Entries_.size()].Used) ++count;
+    }
+
+    return count;
+}
+
+int PublishWindow::GetWindow() const
+{
+    return static_cast<int>(Entries_.size());
+}
+
+size_t PublishWindow::GetBufferSize() const
+{
+    return Buffer_.size();
+}
+
+const PublishWindowStats& PublishWindow::GetStats() const
+{
+    return Stats_;
+}
+
+void PublishWindow::ResetStats()
+{
+    memset(&Stats_, 0, sizeof(Stats_));
+}
@@ -0,0 +1,91 @@
+#include "Network/RadioDutyCycle.h"
+#include <rpcWiFiClientSecure.h>
+
+constexpr unsigned long HOUR = 60UL * 60 * 1000;    // [msec.]
+
+RadioDutyCycle::RadioDutyCycle(unsigned long windowMs) :
+    WindowMs_(windowMs),
+    Enabled_(false),
+    Awake_(true),
+    LastActiveTime_(0),
+    AwakeStartTime_(0),
+    HourStartTime_(0),
+    Stats_{ 0, 0, 0 }
+{
+}
+
+// 無効にしたら起きたままにする(起床時間は数え続ける)
+void RadioDutyCycle::SetEnabled(bool enabled)
+{
+    if (enabled == Enabled_) return;
+
+    Enabled_ = enabled;
+    if (!Enabled_) Wake();
+}
+
+bool RadioDutyCycle::IsEnabled() const
+{
+    return Enabled_;
+}
+
+// 窓を開く(すでに開いていれば延長する)
+void RadioDutyCycle::Wake()
+{
+    const unsigned long now = millis();
+    LastActiveTime_ = now;
+    if (Awake_) return;
+
+    SetSleep(false);
+    Awake_ = true;
+    AwakeStartTime_ = now;
+    ++Stats_.Wakes;
+}
+
+// busy=trueの間(接続中やPUBACK待ちなど)は窓を閉じない
+void RadioDutyCycle::DoWork(bool busy)
+{
+    const unsigned long now = millis();
+    UpdateHour(now);
+
+    if (busy || !Enabled_)
+    {
+        Wake();
+        return;
+    }
+    if (!Awake_ || now - LastActiveTime_ < WindowMs_) return;
+
+    Stats_.AwakeMsThisHour += now - AwakeStartTime_;
+    SetSleep(true);
+    Awake_ = false;
+}
+
+bool RadioDutyCycle::IsAwake() const
+{
+    return Awake_;
+}
+
+const RadioDutyCycleStats& RadioDutyCycle::GetStats() const
+{
+    return Stats_;
+}
+
+void RadioDutyCycle::SetSleep(bool sleep)
+{
+    WiFi.setSleep(sleep);
+}
+
+// 1時間ごとに起床時間を締める
+void RadioDutyCycle::UpdateHour(unsigned long now)
+{
+    if (now - HourStartTime_ < HOUR) return;
+
+    const unsigned long hourEnd = HourStartTime_ + HOUR;
+    if (Awake_)
+    {
+        Stats_.AwakeMsThisHour += hourEnd - AwakeStartTime_;
+        AwakeStartTime_ = hourEnd;
+    }
+    Stats_.AwakeMsLastHour = Stats_.AwakeMsThisHour;
+    Stats_.AwakeMsThisHour = 0;
+    HourStartTime_ = hourEnd;
+}
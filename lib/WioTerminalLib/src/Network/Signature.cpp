@@ -1,71 +1,103 @@
 #include "Network/Signature.h"
 #include <string.h>
 #include <mbedtls/base64.h>
-#include <mbedtls/md.h>
 #include <mbedtls/sha256.h>
 
-std::string GenerateEncryptedSignature(const std::string& symmetricKey, const std::vector<uint8_t>& signature)
+constexpr size_t KEY_MAX_SIZE = 128;    // デコードした鍵の最大長[byte]
+
+SasSigner::SasSigner() :
+    Ready_(false)
+{
+    mbedtls_md_init(&Ctx_);
+}
+
+SasSigner::~SasSigner()
+{
+    Clear();
+}
+
+// 同じ鍵なら何もしない
+int SasSigner::SetKey(const std::string& base64Key)
 {
-    unsigned char base64DecodedSymmetricKey[symmetricKey.size() + 1];
+    if (Ready_ && Key_ == base64Key) return 0;
+    Clear();
 
     // Base64-decode device key
-    // <-- symmetricKey
-    // --> base64DecodedSymmetricKey
-    size_t base64DecodedSymmetricKeyLength;
-    if (mbedtls_base64_decode(base64DecodedSymmetricKey, sizeof(base64DecodedSymmetricKey), &base64DecodedSymmetricKeyLength, reinterpret_cast<const unsigned char*>(&symmetricKey[0]), symmetricKey.size()) != 0) abort();
-    if (base64DecodedSymmetricKeyLength == 0) abort();
+    // <-- base64Key
+    // --> key
+    unsigned char key[KEY_MAX_SIZE];
+    size_t keyLength;
+    if (mbedtls_base64_decode(key, sizeof(key), &keyLength, reinterpret_cast<const unsigned char*>(base64Key.data()), base64Key.size()) != 0) return -1;
+    if (keyLength == 0) return -1;
+
+    // 鍵はHMACのコンテキストに取り込まれるので、デコードした鍵は残さない
+    int result = 0;
+    if (mbedtls_md_setup(&Ctx_, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0) result = -2;
+    else if (mbedtls_md_hmac_starts(&Ctx_, key, keyLength) != 0) result = -3;
+    memset(key, 0, sizeof(key));
+    if (result != 0)
+    {
+        Clear();
+        return result;
+    }
+
+    Key_ = base64Key;
+    Ready_ = true;
+
+    return 0;
+}
+
+void SasSigner::Clear()
+{
+    mbedtls_md_free(&Ctx_);
+    mbedtls_md_init(&Ctx_);
+    Key_.clear();
+    Ready_ = false;
+}
+
+int SasSigner::Sign(const uint8_t* data, size_t size, std::string* base64Signature)
+{
+    if (!Ready_) return -1;
 
     // SHA-256 encrypt
-    // <-- base64DecodedSymmetricKey
-    // <-- signature
+    // <-- data
     // --> encryptedSignature
     uint8_t encryptedSignature[32]; // SHA-256
-    mbedtls_md_context_t ctx;
-    const mbedtls_md_type_t mdType{ MBEDTLS_MD_SHA256 };
-    if (mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(mdType), 1) != 0) abort();
-    if (mbedtls_md_hmac_starts(&ctx, base64DecodedSymmetricKey, base64DecodedSymmetricKeyLength) != 0) abort();
-    if (mbedtls_md_hmac_update(&ctx, &signature[0], signature.size()) != 0) abort();
-    if (mbedtls_md_hmac_finish(&ctx, encryptedSignature) != 0) abort();
+    if (mbedtls_md_hmac_reset(&Ctx_) != 0) return -2;
+    if (mbedtls_md_hmac_update(&Ctx_, data, size) != 0) return -2;
+    if (mbedtls_md_hmac_finish(&Ctx_, encryptedSignature) != 0) return -2;
 
     // Base64 encode encrypted signature
     // <-- encryptedSignature
     // --> b64encHmacsha256Signature
-    char b64encHmacsha256Signature[static_cast<size_t>(sizeof(encryptedSignature) * 1.5f) + 1];
+    char b64encHmacsha256Signature[(sizeof(encryptedSignature) + 2) / 3 * 4 + 1];
     size_t b64encHmacsha256SignatureLength;
-    if (mbedtls_base64_encode(reinterpret_cast<unsigned char*>(b64encHmacsha256Signature), sizeof(b64encHmacsha256Signature), &b64encHmacsha256SignatureLength, encryptedSignature, mbedtls_md_get_size(mbedtls_md_info_from_type(mdType))) != 0) abort();
+    if (mbedtls_base64_encode(reinterpret_cast<unsigned char*>(b64encHmacsha256Signature), sizeof(b64encHmacsha256Signature), &b64encHmacsha256SignatureLength, encryptedSignature, sizeof(encryptedSignature)) != 0) return -3;
+
+    base64Signature->assign(b64encHmacsha256Signature, b64encHmacsha256SignatureLength);
 
-    return std::string(b64encHmacsha256Signature, b64encHmacsha256SignatureLength);
+    return 0;
 }
 
-std::string ComputeDerivedSymmetricKey(const std::string& masterKey, const std::string& registrationId)
+// SASトークンの更新ごとに呼ばれるので、鍵が変わらない限り署名器を使い回す
+std::string GenerateEncryptedSignature(const std::string& symmetricKey, const std::vector<uint8_t>& signature)
 {
-    unsigned char base64DecodedMasterKey[masterKey.size() + 1];
+    static SasSigner signer;
 
-    // Base64-decode device key
-    // <-- masterKey
-    // --> base64DecodedMasterKey
-    size_t base64DecodedMasterKeyLength;
-    if (mbedtls_base64_decode(base64DecodedMasterKey, sizeof(base64DecodedMasterKey), &base64DecodedMasterKeyLength, reinterpret_cast<const unsigned char*>(&masterKey[0]), masterKey.size()) != 0) abort();
-    if (base64DecodedMasterKeyLength == 0) abort();
+    std::string encryptedSignature;
+    if (signer.SetKey(symmetricKey) != 0) return std::string();
+    if (signer.Sign(signature.data(), signature.size(), &encryptedSignature) != 0) return std::string();
 
-    // SHA-256 encrypt
-    // <-- base64DecodedMasterKey
-    // <-- registrationId
-    // --> derivedSymmetricKey
-    uint8_t derivedSymmetricKey[32]; // SHA-256
-    mbedtls_md_context_t ctx;
-    const mbedtls_md_type_t mdType{ MBEDTLS_MD_SHA256 };
-    if (mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(mdType), 1) != 0) abort();
-    if (mbedtls_md_hmac_starts(&ctx, base64DecodedMasterKey, base64DecodedMasterKeyLength) != 0) abort();
-    if (mbedtls_md_hmac_update(&ctx, reinterpret_cast<const unsigned char*>(&registrationId[0]), registrationId.size()) != 0) abort();
-    if (mbedtls_md_hmac_finish(&ctx, derivedSymmetricKey) != 0) abort();
+    return encryptedSignature;
+}
 
-    // Base64 encode encrypted signature
-    // <-- derivedSymmetricKey
-    // --> b64encDerivedSymmetricKey
-    char b64encDerivedSymmetricKey[static_cast<size_t>(sizeof(derivedSymmetricKey) * 1.5f) + 1];
-    size_t b64encDerivedSymmetricKeyLength;
-    if (mbedtls_base64_encode(reinterpret_cast<unsigned char*>(b64encDerivedSymmetricKey), sizeof(b64encDerivedSymmetricKey), &b64encDerivedSymmetricKeyLength, derivedSymmetricKey, mbedtls_md_get_size(mbedtls_md_info_from_type(mdType))) != 0) abort();
+std::string ComputeDerivedSymmetricKey(const std::string& masterKey, const std::string& registrationId)
+{
+    SasSigner signer;
+
+    std::string derivedSymmetricKey;
+    if (signer.SetKey(masterKey) != 0) return std::string();
+    if (signer.Sign(reinterpret_cast<const uint8_t*>(registrationId.data()), registrationId.size(), &derivedSymmetricKey) != 0) return std::string();
 
-    return std::string(b64encDerivedSymmetricKey, b64encDerivedSymmetricKeyLength);
+    return derivedSymmetricKey;
 }
@@ -2,7 +2,9 @@
 #include <Arduino.h>
 
 TimeManager::TimeManager() :
-    Client_(Udp_)
+    Client_(Udp_),
+    CaptureTime_(0),
+    EpochTime_(0)
 {
 }
 
@@ -22,6 +24,11 @@ bool TimeManager::Update()
     return result;
 }
 
+bool TimeManager::IsSynced() const
+{
+    return EpochTime_ != 0;
+}
+
 unsigned long TimeManager::GetEpochTime() const
 {
     return EpochTime_ + (millis() - CaptureTime_) / 1000;
@@ -0,0 +1,322 @@
+#include "Network/TlsClient.h"
+#include <Arduino.h>
+#include <cstring>
+#include <mbedtls/net_sockets.h>
+
+constexpr unsigned long HANDSHAKE_TIMEOUT = 15000;     // [msec.]
+
+TlsClient::TlsClient(Client& client, const char* caCerts) :
+    Client_(client),
+    CaCerts_(caCerts),
+    HandshakeTimeout_(HANDSHAKE_TIMEOUT),
+    Ready_(false),
+    Handshaking_(false),
+    HandshakeStartTime_(0),
+    Connected_(false),
+    Verified_(false),
+    Peek_(-1),
+    SessionValid_(false)
+{
+    mbedtls_entropy_init(&Entropy_);
+    mbedtls_ctr_drbg_init(&Drbg_);
+    mbedtls_x509_crt_init(&Ca_);
+    mbedtls_ssl_config_init(&Conf_);
+    mbedtls_ssl_init(&Ssl_);
+    mbedtls_ssl_session_init(&Session_);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    ForgetSession();
+    mbedtls_ssl_config_free(&Conf_);
+    mbedtls_x509_crt_free(&Ca_);
+    mbedtls_ctr_drbg_free(&Drbg_);
+    mbedtls_entropy_free(&Entropy_);
+}
+
+void TlsClient::SetHandshakeTimeout(unsigned long timeout)
+{
+    HandshakeTimeout_ = timeout;
+}
+
+bool TlsClient::IsResumed() const
+{
+    return Connected_ && !Verified_;
+}
+
+void TlsClient::ForgetSession()
+{
+    mbedtls_ssl_session_free(&Session_);
+    mbedtls_ssl_session_init(&Session_);
+    SessionValid_ = false;
+    SessionHost_.clear();
+}
+
+// 乱数の初期化、CA証明書の解析、設定は最初の接続で1回だけ行い、以降の接続で使い回す
+bool TlsClient::Setup()
+{
+    if (Ready_) return true;
+
+    static const char PERS[] = "TlsClient";
+    int ret = mbedtls_ctr_drbg_seed(&Drbg_, mbedtls_entropy_func, &Entropy_, reinterpret_cast<const unsigned char*>(PERS), sizeof(PERS) - 1);
+    if (ret == 0) ret = mbedtls_x509_crt_parse(&Ca_, reinterpret_cast<const unsigned char*>(CaCerts_), strlen(CaCerts_) + 1);
+    if (ret == 0) ret = mbedtls_ssl_config_defaults(&Conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0)
+    {
+        Serial.printf("TLS: setup failed (-0x%04x)\n", static_cast<unsigned>(-ret));
+        mbedtls_x509_crt_free(&Ca_);
+        mbedtls_x509_crt_init(&Ca_);
+        mbedtls_ssl_config_free(&Conf_);
+        mbedtls_ssl_config_init(&Conf_);
+        return false;
+    }
+    mbedtls_ssl_conf_authmode(&Conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&Conf_, &Ca_, nullptr);
+    mbedtls_ssl_conf_rng(&Conf_, mbedtls_ctr_drbg_random, &Drbg_);
+    mbedtls_ssl_conf_verify(&Conf_, Verify, this);
+    Ready_ = true;
+
+    return true;
+}
+
+// 証明書の検証にはホスト名が要るので、IPアドレスでは接続しない
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    (void)ip;
+    (void)port;
+    Serial.printf("TLS: connect by IP address is not supported\n");
+
+    return 0;
+}
+
+// 接続し終えるまで戻らない(ハンドシェイクの時間はSetHandshakeTimeout()まで)
+int TlsClient::connect(const char* host, uint16_t port)
+{
+    int result;
+    while ((result = ConnectStep(host, port)) == 0) delay(1);
+
+    return result > 0 ? 1 : 0;
+}
+
+// 呼ばれるたびにハンドシェイクを1ステップだけ進め、受信を待たずに戻る
+// 戻り値 1:接続した 0:途中 負:失敗
+// 接続の途中でないときは前の接続を切って最初から始める(hostとportはこのときだけ使う)
+int TlsClient::ConnectStep(const char* host, uint16_t port)
+{
+    if (!Handshaking_)
+    {
+        if (!BeginHandshake(host, port)) return -1;
+        return 0;
+    }
+
+    const int ret = mbedtls_ssl_handshake_step(&Ssl_);
+    if (ret == 0)
+    {
+        if (Ssl_.state != MBEDTLS_SSL_HANDSHAKE_OVER) return 0;
+
+        Handshaking_ = false;
+        Connected_ = true;
+        SaveSession();
+        return 1;
+    }
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+        Serial.printf("TLS: handshake failed (-0x%04x)\n", static_cast<unsigned>(-ret));
+        // 再開を断られたのではなく失敗したときは、次は最初からやり直す
+        ForgetSession();
+        Close();
+        return -1;
+    }
+    if (millis() - HandshakeStartTime_ >= HandshakeTimeout_)
+    {
+        Serial.printf("TLS: handshake timed out\n");
+        Close();
+        return -1;
+    }
+
+    return 0;
+}
+
+bool TlsClient::IsConnecting() const
+{
+    return Handshaking_;
+}
+
+// 名前解決とTCPの接続はこの中で済ませる(下位のClientのタイムアウトまで待つことがある)
+bool TlsClient::BeginHandshake(const char* host, uint16_t port)
+{
+    stop();
+    HandshakeStartTime_ = millis();
+    if (!Setup()) return false;
+    if (!Client_.connect(host, port)) return false;
+
+    int ret = mbedtls_ssl_setup(&Ssl_, &Conf_);
+    const bool resume = SessionValid_ && SessionHost_ == host;
+    if (ret == 0) ret = mbedtls_ssl_set_hostname(&Ssl_, host);
+    if (ret == 0 && resume) ret = mbedtls_ssl_set_session(&Ssl_, &Session_);
+    if (ret != 0)
+    {
+        Serial.printf("TLS: setup failed (-0x%04x)\n", static_cast<unsigned>(-ret));
+        Close();
+        return false;
+    }
+    mbedtls_ssl_set_bio(&Ssl_, this, Send, Recv, nullptr);
+    if (!resume) ForgetSession();
+    SessionHost_ = host;
+
+    Verified_ = false;
+    Handshaking_ = true;
+
+    return true;
+}
+
+// 次の接続で再開できるよう、張ったセッションを覚えておく(ホストはBeginHandshake()で記録済み)
+void TlsClient::SaveSession()
+{
+    mbedtls_ssl_session_free(&Session_);
+    mbedtls_ssl_session_init(&Session_);
+    SessionValid_ = mbedtls_ssl_get_session(&Ssl_, &Session_) == 0;
+}
+
+size_t TlsClient::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size)
+{
+    if (!Connected_) return 0;
+
+    size_t written = 0;
+    while (written < size)
+    {
+        const int ret = mbedtls_ssl_write(&Ssl_, buf + written, size - written);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) continue;
+        if (ret < 0)
+        {
+            stop();
+            break;
+        }
+        written += ret;
+    }
+
+    return written;
+}
+
+// 届いているレコードだけを復号する(待たない)
+int TlsClient::available()
+{
+    const int peek = Peek_ >= 0 ? 1 : 0;
+    if (!Connected_) return peek;
+
+    if (mbedtls_ssl_get_bytes_avail(&Ssl_) == 0)
+    {
+        const int ret = mbedtls_ssl_read(&Ssl_, nullptr, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            stop();
+            return peek;
+        }
+    }
+
+    return static_cast<int>(mbedtls_ssl_get_bytes_avail(&Ssl_)) + peek;
+}
+
+int TlsClient::read()
+{
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size)
+{
+    if (size == 0) return 0;
+
+    int count = 0;
+    if (Peek_ >= 0)
+    {
+        buf[count++] = static_cast<uint8_t>(Peek_);
+        Peek_ = -1;
+        if (--size == 0) return count;
+    }
+    if (!Connected_) return count > 0 ? count : -1;
+
+    const int ret = mbedtls_ssl_read(&Ssl_, buf + count, size);
+    if (ret > 0) return count + ret;
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) stop();
+
+    return count > 0 ? count : -1;
+}
+
+int TlsClient::peek()
+{
+    if (Peek_ < 0) Peek_ = read();
+
+    return Peek_;
+}
+
+void TlsClient::flush()
+{
+    Client_.flush();
+}
+
+// セッションは次の接続のために残す
+void TlsClient::stop()
+{
+    if (Connected_) mbedtls_ssl_close_notify(&Ssl_);
+    Close();
+    Peek_ = -1;
+}
+
+void TlsClient::Close()
+{
+    Handshaking_ = false;
+    Connected_ = false;
+    Client_.stop();
+    mbedtls_ssl_free(&Ssl_);
+    mbedtls_ssl_init(&Ssl_);
+}
+
+uint8_t TlsClient::connected()
+{
+    if (!Connected_) return Peek_ >= 0 ? 1 : 0;
+    if (Client_.connected()) return 1;
+
+    return available() > 0 ? 1 : 0;
+}
+
+TlsClient::operator bool()
+{
+    return connected() != 0;
+}
+
+int TlsClient::Send(void* ctx, const unsigned char* buf, size_t len)
+{
+    Client& client = static_cast<TlsClient*>(ctx)->Client_;
+    const size_t written = client.write(buf, len);
+
+    return written > 0 ? static_cast<int>(written) : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+// 届いていなければ待たずに戻る(mbedTLSは後でもう一度呼ぶ)
+int TlsClient::Recv(void* ctx, unsigned char* buf, size_t len)
+{
+    Client& client = static_cast<TlsClient*>(ctx)->Client_;
+    if (client.available() <= 0) return client.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+
+    const int read = client.read(buf, len);
+
+    return read > 0 ? read : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+// 証明書の検証は通常のハンドシェイクでだけ呼ばれる
+int TlsClient::Verify(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags)
+{
+    (void)crt;
+    (void)depth;
+    (void)flags;
+    static_cast<TlsClient*>(ctx)->Verified_ = true;
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "Network/TlsTransport.h"
+#include <rpcWiFi.h>
+#include <Network/Certificates.h>
+#include <Network/TlsClient.h>
+
+const void* TlsTransport::Borrower_ = nullptr;
+
+// 他のファイルの静的オブジェクトの初期化から呼ばれても良いよう、最初の呼び出しで作る
+static TlsClient& SecureClient()
+{
+    static WiFiClient tcp;
+    static TlsClient client(tcp, CA_CERTS);
+
+    return client;
+}
+
+Client& TlsTransport::GetClient()
+{
+    return SecureClient();
+}
+
+// 呼ばれるたびにTLSの接続を1ステップだけ進める(待たないので、協調的なループから呼べる)
+// 戻り値 1:接続した 0:途中 負:失敗
+// 1が返ったらPubSubClient::connect()はこの接続をそのまま使い、MQTTのCONNECTから始める
+int TlsTransport::ConnectStep(const char* host, uint16_t port)
+{
+    return SecureClient().ConnectStep(host, port);
+}
+
+// 直前の接続で前回のセッションを再開できたか(ハンドシェイクを省略できたか)
+bool TlsTransport::IsSessionResumed()
+{
+    return SecureClient().IsResumed();
+}
+
+void TlsTransport::Lend(const void* borrower)
+{
+    if (Borrower_ == borrower) return;
+
+    if (Borrower_ != nullptr && (SecureClient().connected() || SecureClient().IsConnecting()))
+    {
+        Serial.printf("TLS transport: closing the previous connection\n");
+        SecureClient().stop();
+    }
+    Borrower_ = borrower;
+}
+
+void TlsTransport::Return(const void* borrower)
+{
+    if (Borrower_ == borrower) Borrower_ = nullptr;
+}
@@ -1,19 +1,155 @@
 #include "Network/WiFiManager.h"
 #include <rpcWiFiClientSecure.h>
+#include <cstring>
+
+constexpr unsigned long FAST_CONNECT_TIMEOUT = 3000;    // キャッシュしたBSSIDへの接続を諦めるまで[msec.]
+constexpr unsigned long CONNECT_TIMEOUT = 15000;        // [msec.]
+
+WiFiManager::WiFiManager() :
+    ReuseIp_(false),
+    CacheChanged_(false),
+    Connected_(false),
+    Attempting_(false),
+    AttemptFast_(false),
+    AttemptTime_(0),
+    DisconnectTime_(0),
+    NetworkIndex_(-1)
+{
+    Cache_.Channel = 0;
+    memset(&Stats_, 0, sizeof(Stats_));
+}
 
 void WiFiManager::Connect(const char* ssid, const char* password)
 {
-    Ssid_ = ssid;
-    Password_ = password;
+    Networks_.clear();
+    AddNetwork(ssid, password);
+}
+
+// 先に追加したものほど優先する
+void WiFiManager::AddNetwork(const char* ssid, const char* password)
+{
+    if (ssid == nullptr || ssid[0] == '\0') return;
+
+    Networks_.push_back(Network{ ssid, password != nullptr ? password : "" });
+}
+
+// reuseIp=trueならキャッシュしたIPアドレスを使いDHCPを省く
+void WiFiManager::SetCache(const WiFiConnectCache& cache, bool reuseIp)
+{
+    Cache_ = cache;
+    ReuseIp_ = reuseIp;
+    NetworkIndex_ = -1;
 }
 
+// 呼ばれるたびに状態を確認し、必要なら次の接続を試みる(接続の完了は待たない)
 bool WiFiManager::IsConnected(bool reconnect)
 {
-    if (Ssid_.empty()) return false;
+    if (Networks_.empty()) return false;
+
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        if (!Connected_) Connected();
+        return true;
+    }
 
-    if (WiFi.status() == WL_CONNECTED) return true;
+    if (Connected_)
+    {
+        Connected_ = false;
+        DisconnectTime_ = millis();
+        NetworkIndex_ = -1;
+    }
+    if (!reconnect) return false;
 
-    if (reconnect) WiFi.begin(Ssid_.c_str(), Password_.c_str());
+    if (Attempting_ && millis() - AttemptTime_ < (AttemptFast_ ? FAST_CONNECT_TIMEOUT : CONNECT_TIMEOUT)) return false;
+    if (Attempting_) ++Stats_.Failures;
+
+    Begin();
 
     return false;
 }
+
+const WiFiConnectCache& WiFiManager::GetCache() const
+{
+    return Cache_;
+}
+
+// 接続してキャッシュが変わったら1回だけtrueを返す(保存のきっかけ)
+bool WiFiManager::TakeCacheChanged()
+{
+    const bool changed = CacheChanged_;
+    CacheChanged_ = false;
+
+    return changed;
+}
+
+const WiFiConnectStats& WiFiManager::GetStats() const
+{
+    return Stats_;
+}
+
+// キャッシュがあればそのBSSIDとチャネルに直接つなぎ、だめなら優先順に試す
+void WiFiManager::Begin()
+{
+    const Network* cached = nullptr;
+    if (NetworkIndex_ < 0 && Cache_.Channel > 0)
+    {
+        for (const auto& network : Networks_)
+        {
+            if (network.Ssid == Cache_.Ssid) cached = &network;
+        }
+    }
+
+    if (DisconnectTime_ == 0) DisconnectTime_ = millis();     // 起動直後
+    Attempting_ = true;
+    AttemptTime_ = millis();
+
+    if (cached != nullptr)
+    {
+        AttemptFast_ = true;
+        NetworkIndex_ = 0;
+        if (ReuseIp_ && Cache_.Ip != 0) WiFi.config(IPAddress(Cache_.Ip), IPAddress(Cache_.Gateway), IPAddress(Cache_.Subnet), IPAddress(Cache_.Dns));
+        Serial.printf("Wi-Fi: fast connect to %s (channel %ld)\n", cached->Ssid.c_str(), static_cast<long>(Cache_.Channel));
+        WiFi.begin(cached->Ssid.c_str(), cached->Password.c_str(), Cache_.Channel, Cache_.Bssid);
+        return;
+    }
+
+    if (NetworkIndex_ < 0 || NetworkIndex_ >= static_cast<int>(Networks_.size())) NetworkIndex_ = 0;
+    const Network& network = Networks_[NetworkIndex_];
+    NetworkIndex_ = (NetworkIndex_ + 1) % Networks_.size();
+
+    AttemptFast_ = false;
+    if (ReuseIp_) WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u));    // DHCPに戻す
+    Serial.printf("Wi-Fi: connect to %s\n", network.Ssid.c_str());
+    WiFi.begin(network.Ssid.c_str(), network.Password.c_str());
+}
+
+void WiFiManager::Connected()
+{
+    const unsigned long latency = millis() - DisconnectTime_;
+    Connected_ = true;
+    Attempting_ = false;
+    DisconnectTime_ = 0;
+
+    ++Stats_.Connects;
+    if (AttemptFast_) ++Stats_.FastConnects;
+    Stats_.LatencyLast = latency;
+    Stats_.LatencySum += latency;
+    if (latency > Stats_.LatencyMax) Stats_.LatencyMax = latency;
+    Serial.printf("Wi-Fi: connected to %s in %lu ms%s\n", WiFi.SSID().c_str(), latency, AttemptFast_ ? " (fast)" : "");
+
+    WiFiConnectCache cache;
+    cache.Ssid = WiFi.SSID().c_str();
+    memcpy(cache.Bssid, WiFi.BSSID(), sizeof(cache.Bssid));
+    cache.Channel = WiFi.channel();
+    cache.Ip = WiFi.localIP();
+    cache.Gateway = WiFi.gatewayIP();
+    cache.Subnet = WiFi.subnetMask();
+    cache.Dns = WiFi.dnsIP();
+
+    if (cache.Ssid != Cache_.Ssid || memcmp(cache.Bssid, Cache_.Bssid, sizeof(cache.Bssid)) != 0 || cache.Channel != Cache_.Channel ||
+        cache.Ip != Cache_.Ip || cache.Gateway != Cache_.Gateway || cache.Subnet != Cache_.Subnet || cache.Dns != Cache_.Dns)
+    {
+        Cache_ = cache;
+        CacheChanged_ = true;
+    }
+}
@@ -29,10 +29,14 @@ static void reset_factory_settings_command(int argc, char** argv);
 static void display_settings_command(int argc, char** argv);
 static void wifissid_command(int argc, char** argv);
 static void wifipwd_command(int argc, char** argv);
+static void add_wifi_command(int argc, char** argv);
+static void clear_wifi_command(int argc, char** argv);
 static void az_idscope_command(int argc, char** argv);
 static void az_regid_command(int argc, char** argv);
 static void az_symkey_command(int argc, char** argv);
 static void az_iotc_command(int argc, char** argv);
+static void az_clear_dps_cache_command(int argc, char** argv);
+static void clear_properties_command(int argc, char** argv);
 
 static const struct console_command cmds[] = 
 {
@@ -42,10 +46,14 @@ static const struct console_command cmds[] =
   {"show_settings"         , "Display settings"                               , display_settings_command       },
   {"set_wifissid"          , "Set Wi-Fi SSID"                                 , wifissid_command               },
   {"set_wifipwd"           , "Set Wi-Fi password"                             , wifipwd_command                },
+  {"add_wifi"              , "Add a fallback Wi-Fi network"                   , add_wifi_command               },
+  {"clear_wifi"            , "Clear fallback Wi-Fi networks and cached AP"    , clear_wifi_command             },
   {"set_az_idscope"        , "Set id scope of Azure IoT DPS"                  , az_idscope_command             },
   {"set_az_regid"          , "Set registration id of Azure IoT DPS"           , az_regid_command               },
   {"set_az_symkey"         , "Set symmetric key of Azure IoT DPS"             , az_symkey_command              },
-  {"set_az_iotc"           , "Set connection information of Azure IoT Central", az_iotc_command                }
+  {"set_az_iotc"           , "Set connection information of Azure IoT Central", az_iotc_command                },
+  {"clear_az_dps_cache"    , "Clear cached assignment of Azure IoT DPS"       , az_clear_dps_cache_command     },
+  {"clear_properties"      , "Clear saved writable properties"                , clear_properties_command       }
 };
 
 static const int cmd_count = sizeof(cmds) / sizeof(cmds[0]);
@@ -127,9 +135,28 @@ static void display_settings_command(int argc, char** argv)
 {
     Serial.print(String::format("Wi-Fi SSID = %s" DLM, Storage::WiFiSSID.c_str()));
     Serial.print(String::format("Wi-Fi password = %s" DLM, Storage::WiFiPassword.c_str()));
+    for (size_t i = 0; i < Storage::WiFiExtraSSID.size(); ++i)
+    {
+        Serial.print(String::format("Fallback Wi-Fi %u = %s / %s" DLM, static_cast<unsigned>(i + 1), Storage::WiFiExtraSSID[i].c_str(), Storage::WiFiExtraPassword[i].c_str()));
+    }
+    if (Storage::WiFiCacheChannel > 0)
+    {
+        const uint8_t* bssid = Storage::WiFiCacheBssid;
+        Serial.print(String::format("Cached Wi-Fi AP = %s %02x:%02x:%02x:%02x:%02x:%02x channel %d" DLM, Storage::WiFiCacheSSID.c_str(), bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], static_cast<int>(Storage::WiFiCacheChannel)));
+    }
     Serial.print(String::format("Id scope of Azure IoT DPS = %s" DLM, Storage::IdScope.c_str()));
     Serial.print(String::format("Registration id of Azure IoT DPS = %s" DLM, Storage::RegistrationId.c_str()));
     Serial.print(String::format("Symmetric key of Azure IoT DPS = %s" DLM, Storage::SymmetricKey.c_str()));
+    if (Storage::IsDpsCacheValid())
+    {
+        Serial.print(String::format("Cached hub host = %s" DLM, Storage::HubHost.c_str()));
+        Serial.print(String::format("Cached device id = %s" DLM, Storage::DeviceId.c_str()));
+    }
+    else
+    {
+        Serial.print("Cached assignment of Azure IoT DPS = (none)" DLM);
+    }
+    Serial.print(String::format("Saved properties = %s" DLM, Storage::Properties.empty() ? "(none)" : Storage::Properties.c_str()));
 }
 
 static void wifissid_command(int argc, char** argv)
@@ -160,6 +187,31 @@ static void wifipwd_command(int argc, char** argv)
     Serial.print("Set Wi-Fi password successfully." DLM);
 }
 
+static void add_wifi_command(int argc, char** argv)
+{
+    if (argc != 3) 
+    {
+        Serial.print(String::format("ERROR: Usage: %s <SSID> <Password>. Please provide the SSID and password of the Wi-Fi." DLM, argv[0]));
+        return;
+    }
+
+    Storage::WiFiExtraSSID.push_back(argv[1]);
+    Storage::WiFiExtraPassword.push_back(argv[2]);
+    Storage::Save();
+
+    Serial.print("Add fallback Wi-Fi network successfully." DLM);
+}
+
+static void clear_wifi_command(int argc, char** argv)
+{
+    Storage::WiFiExtraSSID.clear();
+    Storage::WiFiExtraPassword.clear();
+    Storage::ClearWiFiCache();
+    Storage::Save();
+
+    Serial.print("Clear fallback Wi-Fi networks successfully." DLM);
+}
+
 static void az_idscope_command(int argc, char** argv)
 {
     if (argc != 2) 
@@ -210,14 +262,35 @@ static void az_iotc_command(int argc, char** argv)
         return;
     }
 
+    const std::string symmetricKey = ComputeDerivedSymmetricKey(argv[2], argv[3]);
+    if (symmetricKey.empty())
+    {
+        Serial.print("ERROR: Invalid SAS key." DLM);
+        return;
+    }
+
     Storage::IdScope = argv[1];
     Storage::RegistrationId = argv[3];
-    Storage::SymmetricKey = ComputeDerivedSymmetricKey(argv[2], argv[3]);
+    Storage::SymmetricKey = symmetricKey;
     Storage::Save();
 
     Serial.print("Set connection information of Azure IoT Central successfully." DLM);
 }
 
+static void az_clear_dps_cache_command(int argc, char** argv)
+{
+    Storage::InvalidateDpsCache();
+
+    Serial.print("Clear cached assignment of Azure IoT DPS successfully." DLM);
+}
+
+static void clear_properties_command(int argc, char** argv)
+{
+    Storage::SaveProperties("");
+
+    Serial.print("Clear saved writable properties successfully." DLM);
+}
+
 static bool CliGetInput(char* inbuf, int* bp)
 {
     if (inbuf == nullptr) 
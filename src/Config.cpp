@@ -1,5 +1,5 @@
 #include "Config.h"
 
-const char MODEL_ID[] = "dtmi:seeedkk:wioterminal:wioterminal_co2checker;2";
+const char MODEL_ID[] = "dtmi:seeedkk:wioterminal:wioterminal_co2checker;3";
 
 const char DPS_GLOBAL_DEVICE_ENDPOINT_HOST[] = "global.azure-devices-provisioning.net";
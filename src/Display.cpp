@@ -6,6 +6,7 @@
 #include "Helper/Nullable.h"
 #include "Mode.h"
 #include "DisplayColor.h"
+#include "DisplayGlyph.h"
 #include "Measure.h"
 #include "Series.h"
 
@@ -20,7 +21,7 @@
 #define P16	16./55.
 #define P40	40./55.
 #define P48	48./55.
-#define setCursorFont(x,y,font,mag)	{Lcd_.setCursor(x, y); Lcd_.setFont(font); Lcd_.setTextSize(mag); }
+#define setCursorFont(x,y,font,mag)	{Gfx_->setCursor(x, (y) - OriginY_); Gfx_->setFont(font); Gfx_->setTextSize(mag); }
 
 // seeedstudio_280_31_w.png
 // https://lang-ship.com/tools/image2data/
@@ -65,6 +66,31 @@ static const unsigned short SeeedstudioBitmap[8680] = {
 
 static LGFX Lcd_;
 
+// 描画先(LCDまたは合成用スプライト)
+static LovyanGFX* Gfx_ = &Lcd_;
+static int OriginY_ = 0;				// 描画先の原点のy座標
+
+// 合成用スプライト(短冊2枚を交互に使い、片方をDMA転送中にもう片方を合成する)
+static LGFX_Sprite Strip_[2] = { LGFX_Sprite(&Lcd_), LGFX_Sprite(&Lcd_) };
+static int StripHeight_ = 0;			// 0ならスプライト未使用
+static int StripIndex_ = 0;
+static bool StripPending_ = false;		// 最後の短冊を転送中(次にLCDを使う前に待つ)
+
+// 大きな数値表示の前回描画内容
+static DisplayGlyphText TempText_;
+static DisplayGlyphText HumiText_;
+static DisplayGlyphText Co2Text_;
+static DisplayGlyphText WbgtText_;
+
+// 描画時間の計測
+static unsigned long FrameCount_ = 0;
+static unsigned long FrameTimeSum_ = 0;		// [usec.]
+static unsigned long FrameTimeMax_ = 0;		// [usec.]
+
+// 右下のステータス表示
+static DisplayStatusState Status_[static_cast<int>(DisplayStatusItem::MAX_)];
+static bool StatusDirty_ = false;
+
 static String StringVFormat(const char* format, va_list arg)
 {
     const int len = vsnprintf(nullptr, 0, format, arg);
@@ -109,6 +135,28 @@ static String WbgtString(float val)
 	return String::format("%4.1f", val);
 }
 
+// y座標の範囲[y, y + h)が合成中の短冊にかかるか(LCDへ直接描くときは常にtrue)
+static bool DisplayVisible(int y, int h)
+{
+	if (Gfx_ == &Lcd_) return true;
+	return y < OriginY_ + StripHeight_ && OriginY_ < y + h;
+}
+
+// 数値をグリフキャッシュで描画(前回から変化した文字のみ)
+// キャッシュを使わないときは通常の描画
+static void DisplayPrintGlyph(int x, int y, const lgfx::IFont* font, float size, const String& str, DisplayGlyphText* prev)
+{
+	if (!DISPLAY_GLYPH_CACHE)
+	{
+		setCursorFont(x, y, font, size);
+		Gfx_->print(str);
+		return;
+	}
+
+	if (Gfx_ != &Lcd_) prev->Valid = false;	// スプライトへは毎回全体を描く
+	DisplayGlyphPrint(Gfx_, x, y - OriginY_, font, size, str.c_str(), prev);
+}
+
 // co2値のy座標
 static int SeriesCo2YPos(int val)
 {
@@ -127,162 +175,439 @@ static int SeriesWbgtYPos(float val)
 static void DisplayWinter(int tick, bool force)
 {
 	// Temp
-	setCursorFont(128, 10, FONT123, P40);
-	Lcd_.print(TempString(TempAve));
-	setCursorFont(296, 0, FONTABC, P14);
-	Lcd_.print("C");
-	setCursorFont(0, 10, FONT123, P40);
-	Lcd_.fillRect(0, 0, 110, 76, DisplayColorTemp(TempAve));
+	if (DisplayVisible(0, 82))
+	{
+		DisplayPrintGlyph(128, 10, FONT123, P40, TempString(TempAve), &TempText_);
+		setCursorFont(296, 0, FONTABC, P14);
+		Gfx_->print("C");
+		setCursorFont(0, 10, FONT123, P40);
+		Gfx_->fillRect(0, 0 - OriginY_, 110, 76, DisplayColorTemp(TempAve));
+	}
 
 	// Humi
-	setCursorFont(150, 92, FONT123, P40);
-	Lcd_.print(HumiString(HumiAve));
-	setCursorFont(260, 82, FONTABC, P14);
-	Lcd_.print("%RH");
-	Lcd_.fillRect(0, 82, 110, 76, DisplayColorHumi(HumiAve));
-
+	if (DisplayVisible(82, 82))
+	{
+		DisplayPrintGlyph(150, 92, FONT123, P40, HumiString(HumiAve), &HumiText_);
+		setCursorFont(260, 82, FONTABC, P14);
+		Gfx_->print("%RH");
+		Gfx_->fillRect(0, 82 - OriginY_, 110, 76, DisplayColorHumi(HumiAve));
+	}
 
-	if (force || tick % 5 == 0)
+	if ((force || tick % 5 == 0) && DisplayVisible(164, 76))
 	{
 		// Co2
-		setCursorFont(132, 174, FONT123, P40);
-		Lcd_.print(Co2String(Co2Ave));
+		DisplayPrintGlyph(132, 174, FONT123, P40, Co2String(Co2Ave), &Co2Text_);
 		setCursorFont(260, 144, FONTABC, P14);
-		Lcd_.print("ppm");
-		Lcd_.fillRect(0, 164, 110, 76, DisplayColorCo2(Co2Ave));
+		Gfx_->print("ppm");
+		Gfx_->fillRect(0, 164 - OriginY_, 110, 76, DisplayColorCo2(Co2Ave));
 	}
 }
 
 static void DisplaySummer(int tick, bool force)
 {
 	// Wbgt
-	setCursorFont(138, 24, FONT123, P48);
-	Lcd_.print(WbgtString(WbgtAve));
-	setCursorFont(296, 0, FONTABC, P14);
-	Lcd_.print("C");
-	Lcd_.fillRect(0, 0, 110, 116, DisplayColorWbgt(WbgtAve));
+	if (DisplayVisible(0, 120))
+	{
+		DisplayPrintGlyph(138, 24, FONT123, P48, WbgtString(WbgtAve), &WbgtText_);
+		setCursorFont(296, 0, FONTABC, P14);
+		Gfx_->print("C");
+		Gfx_->fillRect(0, 0 - OriginY_, 110, 116, DisplayColorWbgt(WbgtAve));
+	}
 
-	if (force || tick % 5 == 0)
+	if ((force || tick % 5 == 0) && DisplayVisible(120, 120))
 	{
 		// Co2
-		setCursorFont(120, 150, FONT123, P48);
-		Lcd_.print(Co2String(Co2Ave));
+		DisplayPrintGlyph(120, 150, FONT123, P48, Co2String(Co2Ave), &Co2Text_);
 		setCursorFont(260, 120, FONTABC, P14);
-		Lcd_.print("ppm");
-		Lcd_.fillRect(0, 123, 110, 116, DisplayColorCo2(Co2Ave));
+		Gfx_->print("ppm");
+		Gfx_->fillRect(0, 123 - OriginY_, 110, 116, DisplayColorCo2(Co2Ave));
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Chart
+//
+// 列ごとに前回描画した内容を覚えておき、変化した範囲だけを描き直す
+
+constexpr int CHART_WIDTH = CO2_SERIES_NUMBER > WBGT_SERIES_NUMBER ? CO2_SERIES_NUMBER : WBGT_SERIES_NUMBER;
+constexpr int CHART_GRID_MAX = 8;
+constexpr int CHART_NULL_TOP = 239;		// 無効データ(棒なし)
+
+struct ChartGrid
+{
+	int Y;
+	int Color;
+};
+
+struct ChartColumn
+{
+	int16_t Top;						// 棒の上端のy座標
+	int Color;
+	int GridColor[CHART_GRID_MAX];
+};
+
+static ChartColumn ChartColumns_[CHART_WIDTH + 1];
+static bool ChartValid_ = false;
+
+static unsigned long ChartTransactions_;
+static unsigned long ChartPixels_;
+
+static void ChartVLine(int x, int y, int h, int color)
+{
+	if (h <= 0 || !DisplayVisible(y, h)) return;
+	Gfx_->drawFastVLine(x, y - OriginY_, h, color);
+	++ChartTransactions_;
+	ChartPixels_ += h;
+}
+
+static void ChartPixel(int x, int y, int color)
+{
+	if (!DisplayVisible(y, 1)) return;
+	Gfx_->drawPixel(x, y - OriginY_, color);
+	++ChartTransactions_;
+	++ChartPixels_;
+}
+
+static void ChartFrameBegin(bool force)
+{
+	if (force) ChartValid_ = false;
+	ChartTransactions_ = 0;
+	ChartPixels_ = 0;
+}
+
+static void ChartFrameEnd(const char* name, unsigned long startTime)
+{
+	ChartValid_ = true;
+	if (DISPLAY_TIMING_LOG && Gfx_ == &Lcd_) Serial.printf("Chart %s: %lu transactions, %lu pixels, %lu us\n", name, ChartTransactions_, ChartPixels_, micros() - startTime);
+}
+
+// 1列分の棒と補助線を描画し、何か描いたらtrueを返す
+static bool ChartDrawColumn(int i, int top, int color, const ChartGrid* grids, int gridCount)
+{
+	ChartColumn& col = ChartColumns_[i];
+	const int x = i + XOF;
+	if (top > CHART_NULL_TOP) top = CHART_NULL_TOP;
+
+	int from = 0;	// 描き直した範囲[from, to)
+	int to = 0;
+	if (!ChartValid_ || col.Color != color)
+	{
+		ChartVLine(x, 1  , top - 1  , TFT_BLACK);
+		ChartVLine(x, top, 238 - top, color    );
+		from = 0;
+		to = 240;
+	}
+	else if (top < col.Top)
+	{
+		ChartVLine(x, top, col.Top - top, color);
+		from = top;
+		to = col.Top;
+	}
+	else if (top > col.Top)
+	{
+		ChartVLine(x, col.Top, top - col.Top, TFT_BLACK);
+		from = col.Top;
+		to = top;
+	}
+
+	bool drawn = from < to;
+	for (int g = 0; g < gridCount; ++g)
+	{
+		if ((from <= grids[g].Y && grids[g].Y < to) || col.GridColor[g] != grids[g].Color)
+		{
+			ChartPixel(x, grids[g].Y, grids[g].Color);
+			drawn = true;
+		}
+		col.GridColor[g] = grids[g].Color;
+	}
+
+	col.Top = top;
+	col.Color = color;
+
+	return drawn;
+}
+
 static void DisplayChartCo2(int tick, bool force)
 {
-	if (force || tick % 5 == 0)
+	if ((force || tick % 5 == 0) && DisplayVisible(0, 106))
 	{
 		// Co2
 		setCursorFont(241 + XOF, 10, FONTABC, P14);
-		Lcd_.print(" CO2");
-		setCursorFont(241 + XOF, 80, FONT123, P16);
-		Lcd_.print(Co2String(Co2Ave));
+		Gfx_->print(" CO2");
+		DisplayPrintGlyph(241 + XOF, 80, FONT123, P16, Co2String(Co2Ave), &Co2Text_);
 		setCursorFont(280, 60, FONTABC, P10);
-		Lcd_.print("ppm");
+		Gfx_->print("ppm");
 	}
 
 	if (force || tick % 15 == 0)
 	{
 		// Co2
-		Lcd_.setFont(FONTABC);
-		Lcd_.setTextSize(P8);
-		for (int i = 0; i <= static_cast<typeof(i)>(Co2SeriesBuf.limitsize()); ++i)
+		const unsigned long startTime = micros();
+		ChartFrameBegin(force);
+		Gfx_->setFont(FONTABC);
+		Gfx_->setTextSize(P8);
+		bool labelDirty = !ChartValid_;
+		const int interval = SeriesIntervalSec(SeriesKind::CO2, SeriesResolution::RAW);
+		for (int i = 0; i <= CO2_SERIES_NUMBER; ++i)
 		{
 			if (i % (10 * 4) == 0)				// 縦の補助線
 			{
-				Lcd_.drawFastVLine(i + XOF, 0, 239 - YOF, (i == 0 ? TFT_WHITE : TFT_DARKGREY));
-				if (i == 40)
+				if (!ChartValid_) ChartVLine(i + XOF, 0, 239 - YOF, (i == 0 ? TFT_WHITE : TFT_DARKGREY));
+				if (i == 40 && labelDirty)
 				{
 					for (int co2 = 1000; co2 <= 3000; co2 += 1000)
 					{
-						Lcd_.setCursor(1 + XOF, SeriesCo2YPos(co2) + 1);
-						Lcd_.print(co2);
+						Gfx_->setCursor(1 + XOF, SeriesCo2YPos(co2) + 1 - OriginY_);
+						Gfx_->print(co2);
+						++ChartTransactions_;
 					}
 				}
 			}
 			else
 			{
-				const int blankSize = Co2SeriesBuf.limitsize() - Co2SeriesBuf.size();
-				const int co2 = i < blankSize ? -1 : Co2SeriesBuf[i - blankSize];
-				if (!NullableIsNull(co2))
-				{
-					Lcd_.drawFastVLine(i + XOF, 1                 , SeriesCo2YPos(co2)      , TFT_BLACK           );
-					Lcd_.drawFastVLine(i + XOF, SeriesCo2YPos(co2), 238 - SeriesCo2YPos(co2), DisplayColorCo2(co2));
-				}
-				else
+				// 右端が最新の点
+				SeriesPoint point;
+				int co2 = -1;
+				if (SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, interval, (CO2_SERIES_NUMBER - 1 - i) * interval, &point, 1) == 1)
 				{
-					Lcd_.drawFastVLine(i + XOF, 1, 238 - YOF, TFT_BLACK);	// 無効データ
+					co2 = point.Count > 0 ? static_cast<int>(point.Average) : NullableNullValue<int>();
 				}
+
+				ChartGrid grids[7];
+				int gridCount = 0;
 				for (int u = 0; u <= 3000; u += 500)
 				{
-					if (u == 0)                    Lcd_.drawPixel(i + XOF, SeriesCo2YPos(u), TFT_WHITE   );	// X軸
-					else if (u == 1000 && co2 < u) Lcd_.drawPixel(i + XOF, SeriesCo2YPos(u), TFT_YELLOW  );	// 1000ppm
-					else if (u == 1500 && co2 < u) Lcd_.drawPixel(i + XOF, SeriesCo2YPos(u), TFT_RED     );	// 1500ppm
-					else                           Lcd_.drawPixel(i + XOF, SeriesCo2YPos(u), TFT_DARKGREY);
+					int color;
+					if (u == 0)                    color = TFT_WHITE;		// X軸
+					else if (u == 1000 && co2 < u) color = TFT_YELLOW;		// 1000ppm
+					else if (u == 1500 && co2 < u) color = TFT_RED;			// 1500ppm
+					else                           color = TFT_DARKGREY;
+					grids[gridCount++] = ChartGrid{ SeriesCo2YPos(u), color };
 				}
+
+				const bool drawn = !NullableIsNull(co2) ?
+					ChartDrawColumn(i, SeriesCo2YPos(co2), DisplayColorCo2(co2), grids, gridCount) :
+					ChartDrawColumn(i, CHART_NULL_TOP, TFT_BLACK, grids, gridCount);	// 無効データ
+				if (drawn && i < 40) labelDirty = true;
 			}
 		}
+		ChartFrameEnd("CO2", startTime);
 	}
 }
 
 static void DisplayChartWbgt(int tick, bool force)
 {
-	// Wbgt
-	setCursorFont(241 + XOF, 10, FONTABC, P14);
-	Lcd_.print("WBGT");
-	setCursorFont(241 + XOF, 80, FONT123, P16);
-	Lcd_.print(WbgtString(WbgtAve));
-	setCursorFont(300, 70, FONTABC, P10);
-	Lcd_.print("C");
+	if (DisplayVisible(0, 106))
+	{
+		// Wbgt
+		setCursorFont(241 + XOF, 10, FONTABC, P14);
+		Gfx_->print("WBGT");
+		DisplayPrintGlyph(241 + XOF, 80, FONT123, P16, WbgtString(WbgtAve), &WbgtText_);
+		setCursorFont(300, 70, FONTABC, P10);
+		Gfx_->print("C");
+	}
 
 	if (force || tick % 15 == 0)
 	{
 		// Wbgt
-		Lcd_.setFont(FONTABC);
-		Lcd_.setTextSize(P8);
-		for (int i = 0; i <= static_cast<typeof(i)>(WbgtSeriesBuf.limitsize()); ++i)
+		const unsigned long startTime = micros();
+		ChartFrameBegin(force);
+		Gfx_->setFont(FONTABC);
+		Gfx_->setTextSize(P8);
+		bool labelDirty = !ChartValid_;
+		const int interval = SeriesIntervalSec(SeriesKind::WBGT, SeriesResolution::RAW);
+		for (int i = 0; i <= WBGT_SERIES_NUMBER; ++i)
 		{
 			if (i % (10 * 4) == 0)				// 縦の補助線
 			{
-				Lcd_.drawFastVLine(i + XOF, 0, 239 - YOF, (i == 0 ? TFT_WHITE : TFT_DARKGREY));
-				if (i == 40)
+				if (!ChartValid_) ChartVLine(i + XOF, 0, 239 - YOF, (i == 0 ? TFT_WHITE : TFT_DARKGREY));
+				if (i == 40 && labelDirty)
 				{
 					for (int val = 10; val <= 40; val += 10)
 					{
-						Lcd_.setCursor(1 + XOF, SeriesWbgtYPos(val) + (val == 10 ? -18 : 1));
-						Lcd_.print(val);
+						Gfx_->setCursor(1 + XOF, SeriesWbgtYPos(val) + (val == 10 ? -18 : 1) - OriginY_);
+						Gfx_->print(val);
+						++ChartTransactions_;
 					}
 				}
 			}
 			else
 			{
-				const int blankSize = WbgtSeriesBuf.limitsize() - WbgtSeriesBuf.size();
-				const float val = i < blankSize ? -1 : WbgtSeriesBuf[i - blankSize];
-				if (!NullableIsNull(val))
+				// 右端が最新の点
+				SeriesPoint point;
+				float val = -1;
+				if (SeriesQuery(SeriesKind::WBGT, SeriesResolution::RAW, interval, (WBGT_SERIES_NUMBER - 1 - i) * interval, &point, 1) == 1)
 				{
-					Lcd_.drawFastVLine(i + XOF, 1                  , SeriesWbgtYPos(val)      , TFT_BLACK            );
-					Lcd_.drawFastVLine(i + XOF, SeriesWbgtYPos(val), 238 - SeriesWbgtYPos(val), DisplayColorWbgt(val));
-				}
-				else
-				{
-					Lcd_.drawFastVLine(i + XOF, 1, 238 - YOF, TFT_BLACK);			// 無効データ
+					val = point.Average;
 				}
+
+				ChartGrid grids[7];
+				int gridCount = 0;
 				for (int u = 10; u <= 40; u += 10)
 				{
-					if (u == 10) Lcd_.drawPixel(i + XOF, SeriesWbgtYPos(u), TFT_WHITE   );					// X軸
-					else         Lcd_.drawPixel(i + XOF, SeriesWbgtYPos(u), TFT_DARKGREY);					// 20,30,40度
-					Lcd_.drawPixel(i + XOF, SeriesWbgtYPos(25), (val < 25 ? TFT_YELLOW : TFT_DARKGREY));	// 25度
-					Lcd_.drawPixel(i + XOF, SeriesWbgtYPos(28), (val < 28 ? TFT_ORANGE : TFT_DARKGREY));	// 28度
-					Lcd_.drawPixel(i + XOF, SeriesWbgtYPos(31), (val < 31 ? TFT_RED    : TFT_DARKGREY));	// 31度
+					grids[gridCount++] = ChartGrid{ SeriesWbgtYPos(u), (u == 10 ? TFT_WHITE : TFT_DARKGREY) };	// X軸, 20,30,40度
 				}
+				grids[gridCount++] = ChartGrid{ SeriesWbgtYPos(25), (val < 25 ? TFT_YELLOW : TFT_DARKGREY) };	// 25度
+				grids[gridCount++] = ChartGrid{ SeriesWbgtYPos(28), (val < 28 ? TFT_ORANGE : TFT_DARKGREY) };	// 28度
+				grids[gridCount++] = ChartGrid{ SeriesWbgtYPos(31), (val < 31 ? TFT_RED    : TFT_DARKGREY) };	// 31度
+
+				const bool drawn = !NullableIsNull(val) ?
+					ChartDrawColumn(i, SeriesWbgtYPos(val), DisplayColorWbgt(val), grids, gridCount) :
+					ChartDrawColumn(i, CHART_NULL_TOP, TFT_BLACK, grids, gridCount);	// 無効データ
+				if (drawn && i < 40) labelDirty = true;
 			}
 		}
+		ChartFrameEnd("WBGT", startTime);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Status
+
+static int DisplayColorStatus(DisplayStatusState state)
+{
+	switch (state)
+	{
+	case DisplayStatusState::BUSY:  return TFT_YELLOW;
+	case DisplayStatusState::OK:    return TFT_GREEN;
+	case DisplayStatusState::ERROR: return TFT_RED;
+	default:                        return TFT_DARKGREY;
+	}
+}
+
+static void DisplayStatus(bool force)
+{
+	if (!force && !StatusDirty_) return;
+	if (!DisplayVisible(231, 9)) return;
+
+	static const char StatusLetter[] = { 'W', 'T', 'H' };
+	static_assert(sizeof(StatusLetter) == static_cast<int>(DisplayStatusItem::MAX_), "StatusLetter");
+
+	setCursorFont(296, 231, &fonts::Font0, 1);
+	for (int i = 0; i < static_cast<int>(DisplayStatusItem::MAX_); ++i)
+	{
+		Gfx_->setTextColor(DisplayColorStatus(Status_[i]), TFT_BLACK);
+		Gfx_->print(StatusLetter[i]);
+		Gfx_->print(' ');
 	}
+	Gfx_->setTextColor(TFT_WHITE, TFT_BLACK);
+}
+
+static void DisplayDraw(int tick, bool force)
+{
+	switch (ModeCurrent())
+	{
+	case Mode::WINTER:
+		DisplayWinter(tick, force);
+		break;
+	case Mode::SUMMER:
+		DisplaySummer(tick, force);
+		break;
+	case Mode::CHART_CO2:
+		DisplayChartCo2(tick, force);
+		break;
+	case Mode::CHART_WBGT:
+		DisplayChartWbgt(tick, force);
+		break;
+	default:
+		return;
+	}
+
+	DisplayStatus(force);
+}
+
+// スプライト使用時に合成し直すy座標の範囲[*y0, *y1)
+static void DisplayDirtyRange(int tick, bool force, int* y0, int* y1)
+{
+	*y0 = 0;
+	*y1 = 0;
+	switch (ModeCurrent())
+	{
+	case Mode::WINTER:
+		*y1 = force || tick % 5 == 0 ? 240 : 164;	// Temp, Humi は毎秒、Co2 は5秒毎
+		break;
+	case Mode::SUMMER:
+		*y1 = force || tick % 5 == 0 ? 240 : 120;	// Wbgt は毎秒、Co2 は5秒毎
+		break;
+	case Mode::CHART_CO2:
+		if (force || tick % 15 == 0) *y1 = 240;
+		else if (tick % 5 == 0)      *y1 = 106;		// 右側の数値のみ
+		break;
+	case Mode::CHART_WBGT:
+		*y1 = force || tick % 15 == 0 ? 240 : 106;
+		break;
+	default:
+		break;
+	}
+	if (StatusDirty_ && ModeCurrent() != Mode::OFF) *y1 = 240;	// ステータスは最下段
+}
+
+static bool DisplaySpriteInit()
+{
+	if (!DISPLAY_SPRITE) return false;
+
+	// 予算に収まる高さで確保し、確保できなければ半分ずつ減らす
+	int height = DISPLAY_SPRITE_BUFFER_SIZE / (2 * Lcd_.width() * 2);
+	if (height > Lcd_.height()) height = Lcd_.height();
+	for (; height >= 8; height /= 2)
+	{
+		Strip_[0].setColorDepth(16);
+		Strip_[1].setColorDepth(16);
+		if (Strip_[0].createSprite(Lcd_.width(), height) != nullptr && Strip_[1].createSprite(Lcd_.width(), height) != nullptr) break;
+		Strip_[0].deleteSprite();
+		Strip_[1].deleteSprite();
+	}
+	if (height < 8) return false;
+
+	for (auto& strip : Strip_)
+	{
+		strip.setTextColor(TFT_WHITE, TFT_BLACK);
+	}
+	StripHeight_ = height;
+	Serial.printf("Display sprite: 2 x %dx%d\n", Lcd_.width(), StripHeight_);
+
+	return true;
+}
+
+// 最後の短冊の転送完了を待つ
+static void DisplaySpriteWait()
+{
+	if (!StripPending_) return;
+
+	Lcd_.waitDMA();
+	Lcd_.endWrite();
+	StripPending_ = false;
+}
+
+// 短冊単位でRAM上に合成し、DMAで転送する
+// 各短冊にはかかる部分だけを描く
+// 最後の短冊は転送の完了を待たずに戻る(次のフレームで合成する短冊はもう片方なので、転送中の短冊は書き換えない)
+static void DisplaySpriteRefresh(int tick, bool force)
+{
+	int y0;
+	int y1;
+	DisplayDirtyRange(tick, force, &y0, &y1);
+	if (y0 >= y1) return;
+
+	if (!StripPending_) Lcd_.startWrite();
+	for (int y = y0; y < y1; y += StripHeight_)
+	{
+		LGFX_Sprite& strip = Strip_[StripIndex_];
+		StripIndex_ ^= 1;
+
+		strip.fillScreen(TFT_BLACK);
+		Gfx_ = &strip;
+		OriginY_ = y;
+		DisplayDraw(tick, true);
+
+		const int height = y1 - y < StripHeight_ ? y1 - y : StripHeight_;
+		Lcd_.waitDMA();				// もう片方の短冊の転送完了を待つ
+		Lcd_.pushImageDMA(0, y, Lcd_.width(), height, static_cast<const lgfx::swap565_t*>(strip.getBuffer()));
+	}
+	StripPending_ = true;
+
+	Gfx_ = &Lcd_;
+	OriginY_ = 0;
 }
 
 void DisplayInit()
@@ -291,17 +616,24 @@ void DisplayInit()
 
     Lcd_.fillScreen(TFT_WHITE);
     Lcd_.pushImage((Lcd_.width() - SeeedstudioBitmapWidth) / 2, (Lcd_.height() - SeeedstudioBitmapHeight) / 2, SeeedstudioBitmapWidth, SeeedstudioBitmapHeight, SeeedstudioBitmap);
-	delay(2000);
 
-    Lcd_.fillScreen(TFT_BLACK);
     Lcd_.setTextScroll(true);
     Lcd_.setTextColor(TFT_WHITE, TFT_BLACK);
     Lcd_.setFont(&fonts::Font2);
 	Lcd_.setBrightness(LCD_BRIGHTNESS);
+
+	if (DisplaySpriteInit()) Lcd_.initDMA();
 }
 
 void DisplayClear()
 {
+	DisplaySpriteWait();
+	ChartValid_ = false;
+	TempText_.Valid = false;
+	HumiText_.Valid = false;
+	Co2Text_.Valid = false;
+	WbgtText_.Valid = false;
+	StatusDirty_ = true;
 	Lcd_.clear();
 }
 
@@ -312,22 +644,28 @@ void DisplaySetBrightness(int brightness)
 
 void DisplayRefresh(int tick, bool force)
 {
-	switch (ModeCurrent())
+	const unsigned long startTime = micros();
+
+	if (StripHeight_ > 0)
 	{
-	case Mode::WINTER:
-		DisplayWinter(tick, force);
-		break;
-	case Mode::SUMMER:
-		DisplaySummer(tick, force);
-		break;
-	case Mode::CHART_CO2:
-		DisplayChartCo2(tick, force);
-		break;
-	case Mode::CHART_WBGT:
-		DisplayChartWbgt(tick, force);
-		break;
-	default:
-		break;
+		DisplaySpriteRefresh(tick, force);
+	}
+	else
+	{
+		DisplayDraw(tick, force);
+	}
+	StatusDirty_ = false;
+
+	const unsigned long frameTime = micros() - startTime;
+	++FrameCount_;
+	FrameTimeSum_ += frameTime;
+	if (frameTime > FrameTimeMax_) FrameTimeMax_ = frameTime;
+	if (FrameCount_ >= 60)
+	{
+		if (DISPLAY_TIMING_LOG) Serial.printf("Display: %lu frames, avg %lu us, max %lu us\n", FrameCount_, FrameTimeSum_ / FrameCount_, FrameTimeMax_);
+		FrameCount_ = 0;
+		FrameTimeSum_ = 0;
+		FrameTimeMax_ = 0;
 	}
 }
 
@@ -338,5 +676,15 @@ void DisplayPrintf(const char* format, ...)
     String str{ StringVFormat(format, arg) };
     va_end(arg);
 
+	DisplaySpriteWait();
 	Lcd_.print(str);
 }
+
+void DisplaySetStatus(DisplayStatusItem item, DisplayStatusState state)
+{
+	DisplayStatusState& current = Status_[static_cast<int>(item)];
+	if (current == state) return;
+
+	current = state;
+	StatusDirty_ = true;
+}
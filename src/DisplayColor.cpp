@@ -2,40 +2,29 @@
 #include "DisplayColor.h"
 
 #include <LovyanGFX.hpp>
-#include "Helper/Nullable.h"
+#include "Level.h"
 
+// COLORSは段階ごとの色(先頭は無効値)
 int DisplayColorCo2(int val)
 {
-	if (NullableIsNull(val)) return TFT_BLACK;
-	else if (val >= 1500)	 return TFT_RED;		// 1500～
-	else if (val >= 1000)	 return TFT_YELLOW;		// 1000～1500
-	else if (val >= 0)		 return TFT_GREEN;		// ～1000
-	else					 return TFT_BLACK;
+	static const int COLORS[] = { TFT_BLACK, TFT_GREEN, TFT_YELLOW, TFT_RED };
+	return COLORS[LevelCo2(val) + 1];
 }
 
 int DisplayColorHumi(int val)
 {
-	if (NullableIsNull(val)) return TFT_BLACK;
-	else if (val >= 80)		 return TFT_CYAN;		// 80～
-	else if (val >= 30)		 return TFT_GREEN;		// 30～80
-	else if (val >= 0)		 return TFT_WHITE;		// 0～30
-	else					 return TFT_BLACK;
+	static const int COLORS[] = { TFT_BLACK, TFT_WHITE, TFT_GREEN, TFT_CYAN };
+	return COLORS[LevelHumi(val) + 1];
 }
 
 int DisplayColorTemp(float val)
 {
-    if (NullableIsNull(val)) return TFT_BLACK;
-	else if (val >= 28.)	 return TFT_ORANGE;		// 28～
-	else if (val >= 17.)	 return TFT_GREEN;		// 17～28
-	else                     return TFT_CYAN;		// -20～17
+	static const int COLORS[] = { TFT_BLACK, TFT_CYAN, TFT_GREEN, TFT_ORANGE };
+	return COLORS[LevelTemp(val) + 1];
 }
 
 int DisplayColorWbgt(float val)
 {
-	if (NullableIsNull(val)) return TFT_BLACK;
-	else if (val >= 31.)	 return TFT_RED;		// 31～
-	else if (val >= 28.)	 return TFT_ORANGE;		// 28～31
-	else if (val >= 25.)	 return TFT_YELLOW;		// 25～28
-	else if (val >= 0.)		 return TFT_GREEN;		// 0～25
-	else					 return TFT_BLACK;
+	static const int COLORS[] = { TFT_BLACK, TFT_GREEN, TFT_YELLOW, TFT_ORANGE, TFT_RED };
+	return COLORS[LevelWbgt(val) + 1];
 }
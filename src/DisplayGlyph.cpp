@@ -0,0 +1,125 @@
+#include <Arduino.h>
+#include "DisplayGlyph.h"
+
+#include <cstring>
+
+// 数値表示に使う文字を1bppのスプライトに描いておき、表示時は転送するだけにする
+
+static const char GLYPH_CHARS[] = "0123456789.- ";
+constexpr int GLYPH_COUNT = sizeof(GLYPH_CHARS) - 1;
+constexpr int GLYPH_FONT_MAX = 3;
+
+struct GlyphFont
+{
+	const lgfx::IFont* Font;
+	float Size;
+	bool Valid;
+	LGFX_Sprite Glyph[GLYPH_COUNT];
+};
+
+static GlyphFont GlyphFonts_[GLYPH_FONT_MAX];
+static int GlyphFontNext_ = 0;
+
+static int GlyphIndex(char c)
+{
+	const char* p = strchr(GLYPH_CHARS, c);
+	return c != '\0' && p != nullptr ? p - GLYPH_CHARS : -1;
+}
+
+static GlyphFont* GlyphFontFind(const lgfx::IFont* font, float size)
+{
+	for (auto& f : GlyphFonts_)
+	{
+		if (f.Valid && f.Font == font && f.Size == size) return &f;
+	}
+	return nullptr;
+}
+
+void DisplayGlyphPrepare(const lgfx::IFont* font, float size)
+{
+	if (GlyphFontFind(font, size) != nullptr) return;
+
+	// 空きが無ければ古いものから入れ替える
+	GlyphFont& f = GlyphFonts_[GlyphFontNext_];
+	GlyphFontNext_ = (GlyphFontNext_ + 1) % GLYPH_FONT_MAX;
+	for (auto& glyph : f.Glyph) glyph.deleteSprite();
+	f.Font = font;
+	f.Size = size;
+	f.Valid = false;
+
+	for (int i = 0; i < GLYPH_COUNT; ++i)
+	{
+		LGFX_Sprite& g = f.Glyph[i];
+		const char str[2] = { GLYPH_CHARS[i], '\0' };
+
+		g.setColorDepth(1);
+		g.setFont(font);
+		g.setTextSize(size);
+		if (g.createSprite(g.textWidth(str), g.fontHeight()) == nullptr)
+		{
+			for (auto& glyph : f.Glyph) glyph.deleteSprite();
+			return;
+		}
+		g.createPalette();
+		g.setPaletteColor(0, TFT_BLACK);
+		g.setPaletteColor(1, TFT_WHITE);
+		g.setTextColor(1, 0);
+		g.setCursor(0, 0);
+		g.print(str);
+	}
+
+	f.Valid = true;
+}
+
+void DisplayGlyphPrint(LovyanGFX* gfx, int x, int y, const lgfx::IFont* font, float size, const char* str, DisplayGlyphText* prev)
+{
+	DisplayGlyphPrepare(font, size);
+	GlyphFont* f = GlyphFontFind(font, size);
+
+	if (prev->Font != font || prev->Size != size || prev->X != x || prev->Y != y) prev->Valid = false;
+
+	const int prevLength = prev->Valid ? strlen(prev->Text) : 0;
+	int cx = x;
+	int n = 0;
+	for (; str[n] != '\0' && n < DISPLAY_GLYPH_TEXT_MAX; ++n)
+	{
+		const int charX = cx;
+		const int index = GlyphIndex(str[n]);
+		if (f == nullptr || index < 0)
+		{
+			// キャッシュに無い文字は通常の描画
+			const char s[2] = { str[n], '\0' };
+			gfx->setFont(font);
+			gfx->setTextSize(size);
+			gfx->setCursor(cx, y);
+			gfx->print(s);
+			cx = gfx->getCursorX();
+		}
+		else
+		{
+			LGFX_Sprite& g = f->Glyph[index];
+			if (n >= prevLength || prev->Text[n] != str[n] || prev->CharX[n] != charX)
+			{
+				g.pushSprite(gfx, cx, y);
+			}
+			cx += g.width();
+		}
+
+		prev->Text[n] = str[n];
+		prev->CharX[n] = charX;
+	}
+	prev->Text[n] = '\0';
+
+	// 前回より短くなった部分を消す
+	if (prev->Valid && cx < x + prev->Width && f != nullptr)
+	{
+		gfx->fillRect(cx, y, x + prev->Width - cx, f->Glyph[0].height(), TFT_BLACK);
+	}
+
+	prev->Valid = true;
+	prev->Font = font;
+	prev->Size = size;
+	prev->X = x;
+	prev->Y = y;
+	prev->Width = cx - x;
+}
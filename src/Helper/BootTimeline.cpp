@@ -0,0 +1,43 @@
+#include <Arduino.h>
+#include "Helper/BootTimeline.h"
+
+#include <cstring>
+
+BootTimeline::BootTimeline() :
+	Count_{ 0 }
+{
+}
+
+bool BootTimeline::Mark(const char* name)
+{
+	if (Count_ >= BOOT_TIMELINE_MAX || IsMarked(name)) return false;
+
+	Phase& phase = Phases_[Count_++];
+	phase.Name = name;
+	phase.Time = millis();
+	Serial.printf("Boot: %s at %lu ms\n", name, phase.Time);
+
+	return true;
+}
+
+bool BootTimeline::IsMarked(const char* name) const
+{
+	for (int i = 0; i < Count_; ++i)
+	{
+		if (strcmp(Phases_[i].Name, name) == 0) return true;
+	}
+
+	return false;
+}
+
+void BootTimeline::Print() const
+{
+	Serial.printf("Boot phase          at[ms]  delta[ms]\n");
+	unsigned long prev = 0;
+	for (int i = 0; i < Count_; ++i)
+	{
+		const Phase& phase = Phases_[i];
+		Serial.printf("%-16s %9lu %10lu\n", phase.Name, phase.Time, phase.Time - prev);
+		prev = phase.Time;
+	}
+}
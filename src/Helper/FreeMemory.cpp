@@ -0,0 +1,29 @@
+#include <Arduino.h>
+#include "Helper/FreeMemory.h"
+
+#include <malloc.h>
+
+extern "C" char* sbrk(int incr);
+
+static size_t LowWater_ = static_cast<size_t>(-1);
+
+size_t FreeMemoryGet()
+{
+	char top;
+	const struct mallinfo info = mallinfo();
+
+	return static_cast<size_t>(&top - sbrk(0)) + info.fordblks;
+}
+
+size_t FreeMemoryUpdateLowWater()
+{
+	const size_t free = FreeMemoryGet();
+	if (free < LowWater_) LowWater_ = free;
+
+	return free;
+}
+
+size_t FreeMemoryGetLowWater()
+{
+	return LowWater_;
+}
@@ -0,0 +1,135 @@
+#include <Arduino.h>
+#include "Helper/Scheduler.h"
+
+#include <cstring>
+
+// millis()の桁あふれを考慮した比較
+static bool TimeReached(unsigned long now, unsigned long deadline)
+{
+	return static_cast<long>(now - deadline) >= 0;
+}
+
+Scheduler::Scheduler() :
+	TaskCount_{ 0 }
+{
+}
+
+int Scheduler::AddPeriodic(const char* name, void (*func)(), unsigned long periodMs, unsigned long delayMs)
+{
+	if (TaskCount_ >= SCHEDULER_TASK_MAX || periodMs == 0) return -1;
+
+	const int id = TaskCount_++;
+	Task& task = Tasks_[id];
+	task.Name = name;
+	task.Func = func;
+	task.Period = periodMs;
+	task.Deadline = millis() + delayMs;
+	task.Scheduled = true;
+	memset(&task.Stats, 0, sizeof(task.Stats));
+
+	return id;
+}
+
+int Scheduler::AddOneShot(const char* name, void (*func)())
+{
+	if (TaskCount_ >= SCHEDULER_TASK_MAX) return -1;
+
+	const int id = TaskCount_++;
+	Task& task = Tasks_[id];
+	task.Name = name;
+	task.Func = func;
+	task.Period = 0;
+	task.Deadline = 0;
+	task.Scheduled = false;
+	memset(&task.Stats, 0, sizeof(task.Stats));
+
+	return id;
+}
+
+void Scheduler::Schedule(int id, unsigned long delayMs)
+{
+	if (id < 0 || id >= TaskCount_) return;
+
+	Tasks_[id].Deadline = millis() + delayMs;
+	Tasks_[id].Scheduled = true;
+}
+
+void Scheduler::Cancel(int id)
+{
+	if (id < 0 || id >= TaskCount_) return;
+
+	Tasks_[id].Scheduled = false;
+}
+
+bool Scheduler::IsScheduled(int id) const
+{
+	if (id < 0 || id >= TaskCount_) return false;
+
+	return Tasks_[id].Scheduled;
+}
+
+void Scheduler::SetPeriod(int id, unsigned long periodMs)
+{
+	if (id < 0 || id >= TaskCount_ || Tasks_[id].Period == 0 || periodMs == 0) return;
+
+	// 次回の期限は新しい周期で数え直す
+	Tasks_[id].Deadline = Tasks_[id].Deadline - Tasks_[id].Period + periodMs;
+	Tasks_[id].Period = periodMs;
+}
+
+void Scheduler::DoWork()
+{
+	// 登録順に、期限が来たタスクを1回ずつ実行する
+	for (int id = 0; id < TaskCount_; ++id)
+	{
+		Task& task = Tasks_[id];
+		if (!task.Scheduled) continue;
+
+		const unsigned long now = millis();
+		if (!TimeReached(now, task.Deadline)) continue;
+
+		const unsigned long latency = now - task.Deadline;
+		if (latency > task.Stats.LatencyMax) task.Stats.LatencyMax = latency;
+
+		if (task.Period > 0)
+		{
+			task.Deadline += task.Period;
+			if (TimeReached(now, task.Deadline))
+			{
+				// 1周期以上遅れたら、取りこぼした分は飛ばす
+				const unsigned long skip = (now - task.Deadline) / task.Period + 1;
+				task.Deadline += skip * task.Period;
+				task.Stats.OverrunCount += skip;
+			}
+		}
+		else
+		{
+			task.Scheduled = false;
+		}
+
+		const unsigned long startTime = micros();
+		task.Func();
+		const unsigned long runTime = micros() - startTime;
+
+		++task.Stats.RunCount;
+		task.Stats.RunTimeSum += runTime;
+		if (runTime > task.Stats.RunTimeMax) task.Stats.RunTimeMax = runTime;
+	}
+}
+
+const Scheduler::TaskStats& Scheduler::GetStats(int id) const
+{
+	return Tasks_[id].Stats;
+}
+
+void Scheduler::PrintStats(bool reset)
+{
+	Serial.printf("Task            runs   avg[us]   max[us] late[ms] overrun\n");
+	for (int id = 0; id < TaskCount_; ++id)
+	{
+		Task& task = Tasks_[id];
+		const TaskStats& stats = task.Stats;
+		Serial.printf("%-12s %7lu %9lu %9lu %8lu %7lu\n", task.Name, stats.RunCount, stats.RunCount > 0 ? stats.RunTimeSum / stats.RunCount : 0, stats.RunTimeMax, stats.LatencyMax, stats.OverrunCount);
+		if (reset) memset(&task.Stats, 0, sizeof(task.Stats));
+	}
+}
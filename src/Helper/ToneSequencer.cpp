@@ -0,0 +1,122 @@
+#include "Helper/ToneSequencer.h"
+
+// millis()の桁あふれを考慮した比較
+static bool TimeReached(unsigned long now, unsigned long deadline)
+{
+	return static_cast<long>(now - deadline) >= 0;
+}
+
+ToneSequencer::ToneSequencer() :
+	Head_{ 0 },
+	Count_{ 0 },
+	Playing_{ false },
+	Step_{ 0 },
+	RepeatRemain_{ 0 },
+	StepEnd_{ 0 },
+	Output_{ 0 }
+{
+}
+
+const ToneStep& ToneSequencer::CurrentStep() const
+{
+	const Entry& entry = Queue_[Head_];
+	return entry.Steps != nullptr ? entry.Steps[Step_] : entry.Single;
+}
+
+void ToneSequencer::NextStep()
+{
+	if (++Step_ < Queue_[Head_].Count) return;
+
+	Step_ = 0;
+	if (Queue_[Head_].Repeat <= 0) return;		// 無限に繰り返す
+	if (--RepeatRemain_ > 0) return;
+
+	Pop();
+	Playing_ = false;
+}
+
+void ToneSequencer::Pop()
+{
+	Head_ = (Head_ + 1) % TONE_SEQUENCER_QUEUE_MAX;
+	--Count_;
+}
+
+bool ToneSequencer::Enqueue(const ToneStep* steps, int count, int repeat)
+{
+	if (Count_ >= TONE_SEQUENCER_QUEUE_MAX || steps == nullptr || count <= 0 || repeat < 0) return false;
+
+	// 長さ0のパターンは無限ループになるので受け付けない
+	int total = 0;
+	for (int i = 0; i < count; ++i) total += steps[i].DurationMs;
+	if (total <= 0) return false;
+
+	Entry& entry = Queue_[(Head_ + Count_) % TONE_SEQUENCER_QUEUE_MAX];
+	entry.Steps = steps;
+	entry.Count = count;
+	entry.Repeat = repeat;
+	++Count_;
+
+	return true;
+}
+
+bool ToneSequencer::Enqueue(int frequency, int durationMs)
+{
+	if (Count_ >= TONE_SEQUENCER_QUEUE_MAX || durationMs <= 0) return false;
+
+	Entry& entry = Queue_[(Head_ + Count_) % TONE_SEQUENCER_QUEUE_MAX];
+	entry.Steps = nullptr;
+	entry.Count = 1;
+	entry.Repeat = 1;
+	entry.Single = ToneStep{ frequency, durationMs };
+	++Count_;
+
+	return true;
+}
+
+void ToneSequencer::Clear()
+{
+	Head_ = 0;
+	Count_ = 0;
+	Playing_ = false;
+}
+
+bool ToneSequencer::IsPlaying() const
+{
+	return Count_ > 0;
+}
+
+bool ToneSequencer::Update(unsigned long now, int* frequency)
+{
+	const int prevOutput = Output_;
+
+	while (true)
+	{
+		if (Playing_)
+		{
+			if (!TimeReached(now, StepEnd_)) break;
+
+			NextStep();
+			if (!Playing_) continue;
+			StepEnd_ += CurrentStep().DurationMs;	// 前の音の終了時刻から数えるのでずれない
+		}
+		else
+		{
+			if (Count_ <= 0)
+			{
+				Output_ = 0;
+				break;
+			}
+
+			Playing_ = true;
+			Step_ = 0;
+			RepeatRemain_ = Queue_[Head_].Repeat;
+			StepEnd_ = now + CurrentStep().DurationMs;
+		}
+		Output_ = CurrentStep().Frequency;
+	}
+
+	if (Output_ == prevOutput) return false;
+
+	*frequency = Output_;
+	return true;
+}
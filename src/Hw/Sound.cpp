@@ -11,16 +11,41 @@ void Sound::Init()
 	pinMode(Pin_, OUTPUT);
 }
 
-void Sound::PlayTone(int frequency, int durationMs)
+// 音の切り替えだけを行い、波形はtone()のタイマー割り込みで出力する
+void Sound::DoWork()
 {
-	const int periodUs = 1000000 / frequency;
-    const int durationUs = durationMs * 1000;
+	int frequency;
+	if (!Sequencer_.Update(millis(), &frequency)) return;
 
-	for (int i = 0; i < durationUs; i += periodUs)
+	if (frequency > 0)
+	{
+		tone(Pin_, frequency);
+	}
+	else
 	{
-		digitalWrite(Pin_, 1);
-		delayMicroseconds(periodUs / 2);
-		digitalWrite(Pin_, 0);
-		delayMicroseconds(periodUs / 2);
+		noTone(Pin_);
 	}
 }
+
+void Sound::PlayTone(int frequency, int durationMs)
+{
+	Sequencer_.Enqueue(frequency, durationMs);
+	DoWork();
+}
+
+void Sound::PlayPattern(const ToneStep* steps, int count, int repeat)
+{
+	Sequencer_.Enqueue(steps, count, repeat);
+	DoWork();
+}
+
+void Sound::Stop()
+{
+	Sequencer_.Clear();
+	DoWork();
+}
+
+bool Sound::IsPlaying() const
+{
+	return Sequencer_.IsPlaying();
+}
@@ -6,23 +6,30 @@
 
 static Light* Light_ = nullptr;
 static unsigned int LcdOnRemain_ = 0;	// 電源ONの残り時間[秒]
+static unsigned int LcdOnTime_ = LCD_ON_TIME;	// [秒]
 
 void LcdOnInit(Light* light)
 {
     Light_ = light;
-	LcdOnRemain_ = LCD_ON_TIME;
+	LcdOnRemain_ = LcdOnTime_;
+}
+
+void LcdOnSetTime(int onTimeSec)
+{
+	LcdOnTime_ = onTimeSec >= 1 ? onTimeSec : 1;
+	if (LcdOnRemain_ > LcdOnTime_) LcdOnRemain_ = LcdOnTime_;
 }
 
 void LcdOnForce(bool on)
 {
-	LcdOnRemain_ = on ? LCD_ON_TIME : 0;
+	LcdOnRemain_ = on ? LcdOnTime_ : 0;
 }
 
 void LcdOnUpdate()
 {
 	if (Light_->LightIntensity >= LCD_ON_LIGHT_H)
 	{
-		LcdOnRemain_ = LCD_ON_TIME;
+		LcdOnRemain_ = LcdOnTime_;
 	}
 	else if (Light_->LightIntensity < LCD_ON_LIGHT_L)
 	{
@@ -30,7 +37,7 @@ void LcdOnUpdate()
 	}
 	else
 	{
-		if (LcdOnRemain_ > 0) LcdOnRemain_ = LCD_ON_TIME;
+		if (LcdOnRemain_ > 0) LcdOnRemain_ = LcdOnTime_;
 	}
 }
 
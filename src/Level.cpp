@@ -0,0 +1,39 @@
+#include "Level.h"
+
+#include "Helper/Nullable.h"
+
+int LevelCo2(int val)
+{
+	if (NullableIsNull(val)) return -1;
+	else if (val >= 1500)	 return 2;		// 1500～
+	else if (val >= 1000)	 return 1;		// 1000～1500
+	else if (val >= 0)		 return 0;		// ～1000
+	else					 return -1;
+}
+
+int LevelHumi(int val)
+{
+	if (NullableIsNull(val)) return -1;
+	else if (val >= 80)		 return 2;		// 80～
+	else if (val >= 30)		 return 1;		// 30～80
+	else if (val >= 0)		 return 0;		// 0～30
+	else					 return -1;
+}
+
+int LevelTemp(float val)
+{
+	if (NullableIsNull(val)) return -1;
+	else if (val >= 28.)	 return 2;		// 28～
+	else if (val >= 17.)	 return 1;		// 17～28
+	else                     return 0;		// -20～17
+}
+
+int LevelWbgt(float val)
+{
+	if (NullableIsNull(val)) return -1;
+	else if (val >= 31.)	 return 3;		// 31～
+	else if (val >= 28.)	 return 2;		// 28～31
+	else if (val >= 25.)	 return 1;		// 25～28
+	else if (val >= 0.)		 return 0;		// 0～25
+	else					 return -1;
+}
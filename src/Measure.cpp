@@ -4,58 +4,186 @@
 
 #include <GroveDriverPack.h>
 #include "Helper/Nullable.h"
-#include "Helper/DequeLimitSize.h"
+#include "Helper/RingBuffer.h"
+
+constexpr uint8_t SCD30_I2C_ADDRESS = 0x61;
 
 static GroveBoard Board_;
 static GroveSCD30 SensorScd30_(&Board_.GroveI2C1);
 
-// 平均値算出用バッファ
-static DequeLimitSize<int> Co2AveBuf_(CO2_AVERAGE_NUMBER);
-static DequeLimitSize<int> HumiAveBuf_(HUMI_AVERAGE_NUMBER);
-static DequeLimitSize<float> TempAveBuf_(TEMP_AVERAGE_NUMBER);
+// 平均値算出用バッファ(平均する数は実行時に変えられる)
+static RingBuffer<int, AVERAGE_NUMBER_MAX> Co2AveBuf_;
+static RingBuffer<int, AVERAGE_NUMBER_MAX> HumiAveBuf_;
+static RingBuffer<float, AVERAGE_NUMBER_MAX> TempAveBuf_;
+static float TempOffset_ = TEMP_OFFSET;
+
+// 測定のスケジュール
+// SCD30のRDY端子はGroveコネクタに出ていないので、測定間隔に合わせて読みに行く
+static unsigned long Interval_ = SCD30_MEASUREMENT_INTERVAL * 1000UL;	// [msec.]
+static unsigned long NextSampleTime_;	// 次のデータが揃う予定時刻[msec.]
+static unsigned long NextPollTime_;		// [msec.]
+static bool Late_;
+static MeasureStats Stats_;
+static MeasureInterval IntervalStats_;
 
 int Co2Ave = NullableNullValue<typeof(Co2Ave)>();
 int HumiAve = NullableNullValue<typeof(HumiAve)>();
 float TempAve = NullableNullValue<typeof(TempAve)>();
 float WbgtAve = NullableNullValue<typeof(WbgtAve)>();
 
+// millis()の桁あふれを考慮した比較
+static bool TimeReached(unsigned long now, unsigned long deadline)
+{
+	return static_cast<long>(now - deadline) >= 0;
+}
+
+static uint8_t Scd30Crc(const uint8_t* data, int size)
+{
+	uint8_t crc = 0xff;
+	for (int i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; ++bit) crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+	}
+	return crc;
+}
+
+// Set measurement interval (0x4600)
+// GroveSCD30にこのコマンドが無いので、ドライバと同じGroveI2C1のバス経由で送る
+static void Scd30SetMeasurementInterval(int intervalSec)
+{
+	const uint8_t arg[2] = { static_cast<uint8_t>(intervalSec >> 8), static_cast<uint8_t>(intervalSec) };
+	const uint8_t command[] = { 0x46, 0x00, arg[0], arg[1], Scd30Crc(arg, sizeof(arg)) };
+
+	Board_.GroveI2C1.I2C->Write(SCD30_I2C_ADDRESS, command, sizeof(command));
+}
+
+// WBGTの計算(日本生気象学会の表)
+static float WbgtCalc(float temp, float humi)
+{
+	return -1.7 + .693 * temp + .0388 * humi + .00355 * humi * temp;
+}
+
+static void MeasureUpdate()
+{
+	SensorScd30_.Read();
+
+	if (!isnan(SensorScd30_.Co2Concentration) && 200 <= SensorScd30_.Co2Concentration && SensorScd30_.Co2Concentration < 10000)
+	{
+		Co2AveBuf_.push_back(SensorScd30_.Co2Concentration);
+		IntervalStats_.Co2.push_back(SensorScd30_.Co2Concentration);
+		Co2Ave = Co2AveBuf_.size() >= 1 ? Co2AveBuf_.average() : NullableNullValue<typeof(Co2Ave)>();
+	}
+	if (!isnan(SensorScd30_.Humidity))
+	{
+		HumiAveBuf_.push_back(SensorScd30_.Humidity);
+		IntervalStats_.Humi.push_back(SensorScd30_.Humidity);
+		HumiAve = HumiAveBuf_.size() >= 1 ? HumiAveBuf_.average() : NullableNullValue<typeof(HumiAve)>();
+	}
+	if (!isnan(SensorScd30_.Temperature))
+	{
+		TempAveBuf_.push_back(SensorScd30_.Temperature);
+		IntervalStats_.Temp.push_back(SensorScd30_.Temperature - TempOffset_);	// 表示と同じ補正後の値
+		TempAve = TempAveBuf_.size() >= 1 ? TempAveBuf_.average() : NullableNullValue<typeof(TempAve)>();
+		if (!NullableIsNull(TempAve)) TempAve -= TempOffset_;
+	}
+
+	if (!isnan(SensorScd30_.Humidity) && !isnan(SensorScd30_.Temperature))
+	{
+		IntervalStats_.Wbgt.push_back(WbgtCalc(SensorScd30_.Temperature - TempOffset_, SensorScd30_.Humidity));
+	}
+
+	if (!NullableIsNull(HumiAve) && !NullableIsNull(TempAve))
+	{
+		WbgtAve = WbgtCalc(TempAve, HumiAve);
+	}
+	else
+	{
+		WbgtAve = NullableNullValue<typeof(WbgtAve)>();
+	}
+}
+
 void MeasureInit()
 {
 	Board_.GroveI2C1.Enable();
 	SensorScd30_.Init();
+
+	MeasureSetAverageNumber(CO2_AVERAGE_NUMBER, HUMI_AVERAGE_NUMBER, TEMP_AVERAGE_NUMBER);
+
+	MeasureSetInterval(SCD30_MEASUREMENT_INTERVAL);
+}
+
+void MeasureSetInterval(int intervalSec)
+{
+	if (intervalSec < 2) intervalSec = 2;
+	if (intervalSec > 1800) intervalSec = 1800;
+
+	Scd30SetMeasurementInterval(intervalSec);
+
+	Interval_ = intervalSec * 1000UL;
+	NextSampleTime_ = millis() + Interval_;
+	NextPollTime_ = NextSampleTime_;
+	Late_ = false;
+}
+
+// 減らしたときは古い値から捨てる(次の測定から反映)
+void MeasureSetAverageNumber(int co2, int humi, int temp)
+{
+	Co2AveBuf_.setlimitsize(co2);
+	HumiAveBuf_.setlimitsize(humi);
+	TempAveBuf_.setlimitsize(temp);
 }
 
-void MeasureRead()
+void MeasureSetTempOffset(float offset)
 {
+	TempOffset_ = offset;
+}
+
+// 予定時刻になるまではI2Cに触らない
+void MeasureDoWork()
+{
+	const unsigned long now = millis();
+	if (!TimeReached(now, NextPollTime_)) return;
+
+	++Stats_.Polls;
 	if (SensorScd30_.ReadyToRead())
 	{
-		SensorScd30_.Read();
-	
-		if (!isnan(SensorScd30_.Co2Concentration) && 200 <= SensorScd30_.Co2Concentration && SensorScd30_.Co2Concentration < 10000)
-		{
-			Co2AveBuf_.push_back(SensorScd30_.Co2Concentration);
-			Co2Ave = Co2AveBuf_.size() >= 1 ? Co2AveBuf_.average() : NullableNullValue<typeof(Co2Ave)>();
-		}
-		if (!isnan(SensorScd30_.Humidity))
-		{
-			HumiAveBuf_.push_back(SensorScd30_.Humidity);
-			HumiAve = HumiAveBuf_.size() >= 1 ? HumiAveBuf_.average() : NullableNullValue<typeof(HumiAve)>();
-		}
-		if (!isnan(SensorScd30_.Temperature))
-		{
-			TempAveBuf_.push_back(SensorScd30_.Temperature);
-			TempAve = TempAveBuf_.size() >= 1 ? TempAveBuf_.average() : NullableNullValue<typeof(TempAve)>();
-			if (NullableIsNull(TempAve)) TempAve -= TEMP_OFFSET;
-		}
+		MeasureUpdate();
+		++Stats_.Samples;
+		if (Late_) ++Stats_.LateSamples;
+
+		// 次はデータが取れた時刻から1測定間隔後
+		NextSampleTime_ = now + Interval_;
+		NextPollTime_ = NextSampleTime_;
+		Late_ = false;
+		return;
 	}
 
-	if (!NullableIsNull(HumiAve) && !NullableIsNull(TempAve))
+	if (TimeReached(now, NextSampleTime_ + Interval_))
 	{
-		// WBGTの計算(日本生気象学会の表)
-		WbgtAve = -1.7 + .693 * TempAve + .0388 * HumiAve + .00355 * HumiAve * TempAve;
+		++Stats_.MissedSamples;
+		NextSampleTime_ += Interval_;
 	}
-	else
+	else if (TimeReached(now, NextSampleTime_ + Interval_ / 2))
 	{
-		WbgtAve = NullableNullValue<typeof(WbgtAve)>();
+		Late_ = true;
 	}
+	NextPollTime_ = now + SCD30_POLL_INTERVAL;
+}
+
+const MeasureStats& MeasureGetStats()
+{
+	return Stats_;
+}
+
+// 前回呼び出してからの統計を返し、次の区間を始める
+MeasureInterval MeasureTakeInterval()
+{
+	const MeasureInterval interval = IntervalStats_;
+	IntervalStats_.Co2.clear();
+	IntervalStats_.Humi.clear();
+	IntervalStats_.Temp.clear();
+	IntervalStats_.Wbgt.clear();
+
+	return interval;
 }
@@ -3,23 +3,159 @@
 #include "Series.h"
 
 #include "Measure.h"
+#include "Helper/Nullable.h"
+#include "Helper/RingBuffer.h"
 
-DequeLimitSize<int> Co2SeriesBuf(CO2_SERIES_NUMBER);
-DequeLimitSize<int> WbgtSeriesBuf(WBGT_SERIES_NUMBER);
+static_assert(5 * 60 % CO2_SERIES_INVERVAL == 0, "CO2_SERIES_INVERVAL must divide 5 minutes");
+static_assert(5 * 60 % WBGT_SERIES_INVERVAL == 0, "WBGT_SERIES_INVERVAL must divide 5 minutes");
+
+constexpr float CO2_SERIES_SCALE = 1;		// 間引いた時系列は1ppm単位
+constexpr float WBGT_SERIES_SCALE = 10;		// 間引いた時系列は0.1度単位
+
+static RingBuffer<int, CO2_SERIES_NUMBER> Co2SeriesBuf_;
+static RingBuffer<float, WBGT_SERIES_NUMBER> WbgtSeriesBuf_;
+
+// 間引いた時系列(5分 → 1時間 → 1日の順に集約)
+struct SeriesTiers
+{
+	SeriesTier<SERIES_MIN5_NUMBER> Min5;
+	SeriesTier<SERIES_HOUR1_NUMBER> Hour1;
+	SeriesTier<SERIES_DAY1_NUMBER> Day1;
+
+	SeriesTiers(int rawInterval, float scale) :
+		Min5{ 5 * 60 / rawInterval, scale },
+		Hour1{ 60 / 5, scale },
+		Day1{ 24, scale }
+	{
+	}
+
+	void Add(const SeriesPoint& raw)
+	{
+		SeriesPoint p;
+		if (!Min5.Add(raw, &p)) return;
+		if (!Hour1.Add(p, &p)) return;
+		Day1.Add(p, nullptr);
+	}
+
+	void Clear()
+	{
+		Min5.clear();
+		Hour1.clear();
+		Day1.clear();
+	}
+};
+
+static SeriesTiers Co2Tiers_(CO2_SERIES_INVERVAL, CO2_SERIES_SCALE);
+static SeriesTiers WbgtTiers_(WBGT_SERIES_INVERVAL, WBGT_SERIES_SCALE);
+
+template<class T>
+static SeriesPoint SeriesRawPoint(T val)
+{
+	if (NullableIsNull(val)) return SeriesPoint{ NAN, NAN, NAN, 0 };
+
+	const float x = static_cast<float>(val);
+	return SeriesPoint{ x, x, x, 1 };
+}
+
+template<class T, size_t N>
+static SeriesPoint SeriesAt(const RingBuffer<T, N>& buf, int index)
+{
+	return SeriesRawPoint(buf[index]);
+}
+
+template<size_t N>
+static SeriesPoint SeriesAt(const SeriesTier<N>& tier, int index)
+{
+	return tier[index];
+}
+
+// 新しい方からskip点を除いた直近count点を古い順にoutへ格納
+template<class Buffer>
+static int SeriesCopy(const Buffer& buf, int skip, int count, SeriesPoint* out)
+{
+	const int size = buf.size();
+	if (skip >= size) return 0;
+	if (count > size - skip) count = size - skip;
+	const int first = size - skip - count;
+	for (int i = 0; i < count; ++i)
+	{
+		out[i] = SeriesAt(buf, first + i);
+	}
+	return count;
+}
 
 void SeriesInit()
 {
+	Co2SeriesBuf_.clear();
+	WbgtSeriesBuf_.clear();
+	Co2Tiers_.Clear();
+	WbgtTiers_.Clear();
 }
 
 void SeriesUpdate(int tick)
 {
 	if (tick % CO2_SERIES_INVERVAL == 0)
 	{
-		Co2SeriesBuf.push_back(Co2Ave);
+		Co2SeriesBuf_.push_back(Co2Ave);
+		Co2Tiers_.Add(SeriesRawPoint(Co2Ave));
 	}
 	
 	if (tick % WBGT_SERIES_INVERVAL == 0)
 	{
-		WbgtSeriesBuf.push_back(WbgtAve);
+		WbgtSeriesBuf_.push_back(WbgtAve);
+		WbgtTiers_.Add(SeriesRawPoint(WbgtAve));
+	}
+}
+
+int SeriesIntervalSec(SeriesKind kind, SeriesResolution resolution)
+{
+	switch (resolution)
+	{
+	case SeriesResolution::RAW:
+		return kind == SeriesKind::CO2 ? CO2_SERIES_INVERVAL : WBGT_SERIES_INVERVAL;
+	case SeriesResolution::MIN5:
+		return 5 * 60;
+	case SeriesResolution::HOUR1:
+		return 60 * 60;
+	case SeriesResolution::DAY1:
+		return 24 * 60 * 60;
+	default:
+		return 0;
+	}
+}
+
+// endSec秒前までの直近windowSec秒の点を古い順にoutへ格納し、格納した数を返す
+// 点はSeriesIntervalSec()毎で、最新の点が0秒前。溜まっていない古い側は返さない
+int SeriesQuery(SeriesKind kind, SeriesResolution resolution, int windowSec, int endSec, SeriesPoint* out, int outSize)
+{
+	const int interval = SeriesIntervalSec(kind, resolution);
+	if (interval <= 0 || out == nullptr || endSec < 0) return 0;
+	const int skip = (endSec + interval - 1) / interval;
+	int count = (windowSec + interval - 1) / interval;
+	if (count > outSize) count = outSize;
+	if (count <= 0) return 0;
+
+	switch (kind)
+	{
+	case SeriesKind::CO2:
+		switch (resolution)
+		{
+		case SeriesResolution::RAW:   return SeriesCopy(Co2SeriesBuf_, skip, count, out);
+		case SeriesResolution::MIN5:  return SeriesCopy(Co2Tiers_.Min5, skip, count, out);
+		case SeriesResolution::HOUR1: return SeriesCopy(Co2Tiers_.Hour1, skip, count, out);
+		case SeriesResolution::DAY1:  return SeriesCopy(Co2Tiers_.Day1, skip, count, out);
+		}
+		break;
+	case SeriesKind::WBGT:
+		switch (resolution)
+		{
+		case SeriesResolution::RAW:   return SeriesCopy(WbgtSeriesBuf_, skip, count, out);
+		case SeriesResolution::MIN5:  return SeriesCopy(WbgtTiers_.Min5, skip, count, out);
+		case SeriesResolution::HOUR1: return SeriesCopy(WbgtTiers_.Hour1, skip, count, out);
+		case SeriesResolution::DAY1:  return SeriesCopy(WbgtTiers_.Day1, skip, count, out);
+		}
+		break;
 	}
+
+	return 0;
 }
@@ -1,17 +1,317 @@
 #include <Arduino.h>
+#include "Config.h"
 #include "Storage.h"
 #include <MsgPack.h>
 #include <ExtFlashLoader.h>
+#include <initializer_list>
 
 static auto FlashStartAddress = reinterpret_cast<const uint8_t* const>(0x04000000);
 
 static ExtFlashLoader::QSPIFlash Flash;
 
+// 接続のたびに変わりうるキャッシュ(APやDPSの割り当て)と書き込み可能なプロパティは設定のセクタとは別の領域に追記する
+//
+// 設定(資格情報)のセクタはCLIで変更したときだけ消去・書き込みする
+// キャッシュはレコードを追記し、セクタが一杯になったら次のセクタを消去して全種類の最新値を書き直す
+// 各レコードは連番とCRC付きで、種類ごとに連番が最大の正しいレコードを使う(書き込み途中の電源断では前の値が残る)
+
+constexpr uint32_t FLASH_SECTOR_SIZE = 4096;
+constexpr uint32_t FLASH_PAGE_SIZE = 256;
+constexpr uint32_t CACHE_RECORD_EMPTY = 0xffffffff;
+
+enum class CacheRecordType : uint8_t
+{
+	DPS = 1,
+	WIFI = 2,
+	PROPERTIES = 3,
+};
+
+constexpr CacheRecordType CACHE_RECORD_TYPES[] = { CacheRecordType::DPS, CacheRecordType::WIFI, CacheRecordType::PROPERTIES };
+
+struct CacheRecordHeader
+{
+	uint32_t Sequence;
+	uint16_t Length;		// ペイロード(MsgPack)のバイト数
+	uint8_t Type;
+	uint8_t Reserved;
+	uint16_t Crc;			// Crcより前のヘッダとペイロード
+	uint8_t Reserved2[6];
+};
+static_assert(sizeof(CacheRecordHeader) == 16, "CacheRecordHeader must be 16 bytes");
+
+static int CacheSector_ = 0;
+static uint32_t CacheOffset_ = FLASH_SECTOR_SIZE;	// セクタ内の書き込み位置(FLASH_SECTOR_SIZEなら次は別のセクタへ)
+static uint32_t CacheNextSequence_ = 1;
+
 std::string Storage::WiFiSSID;
 std::string Storage::WiFiPassword;
+std::vector<std::string> Storage::WiFiExtraSSID;
+std::vector<std::string> Storage::WiFiExtraPassword;
+std::string Storage::WiFiCacheSSID;
+uint8_t Storage::WiFiCacheBssid[6];
+int32_t Storage::WiFiCacheChannel;
+uint32_t Storage::WiFiCacheIp;
+uint32_t Storage::WiFiCacheGateway;
+uint32_t Storage::WiFiCacheSubnet;
+uint32_t Storage::WiFiCacheDns;
 std::string Storage::IdScope;
 std::string Storage::RegistrationId;
 std::string Storage::SymmetricKey;
+std::string Storage::HubHost;
+std::string Storage::DeviceId;
+uint32_t Storage::DpsCacheKey;
+std::string Storage::Properties;
+
+// QSPIの読み出しはキャッシュされるので、書き換えたら無効化する
+static void FlashInvalidateCache()
+{
+	CMCC->CTRL.bit.CEN = 0;
+	while (CMCC->SR.bit.CSTS) {}
+	CMCC->MAINT0.reg = CMCC_MAINT0_INVALL;
+	CMCC->CTRL.bit.CEN = 1;
+}
+
+static void ResetWiFiCache()
+{
+	Storage::WiFiCacheSSID.clear();
+	memset(Storage::WiFiCacheBssid, 0, sizeof(Storage::WiFiCacheBssid));
+	Storage::WiFiCacheChannel = 0;
+	Storage::WiFiCacheIp = 0;
+	Storage::WiFiCacheGateway = 0;
+	Storage::WiFiCacheSubnet = 0;
+	Storage::WiFiCacheDns = 0;
+}
+
+static uint32_t CacheSectorAddress(int sector)
+{
+	return STORAGE_CACHE_ADDRESS + sector * FLASH_SECTOR_SIZE;
+}
+
+static uint32_t CacheRecordSize(size_t length)
+{
+	return (sizeof(CacheRecordHeader) + length + 15) / 16 * 16;
+}
+
+static uint16_t CacheCrc(const CacheRecordHeader& header, const uint8_t* payload)
+{
+	uint16_t crc = 0xffff;
+	auto update = [&crc](const uint8_t* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc ^= data[i] << 8;
+			for (int bit = 0; bit < 8; ++bit) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	};
+	update(reinterpret_cast<const uint8_t*>(&header), offsetof(CacheRecordHeader, Crc));
+	update(payload, header.Length);
+	return crc;
+}
+
+static void CachePack(CacheRecordType type, MsgPack::Packer& packer)
+{
+	switch (type)
+	{
+	case CacheRecordType::DPS:
+	{
+		const MsgPack::str_t hubHost = Storage::HubHost.c_str();
+		const MsgPack::str_t deviceId = Storage::DeviceId.c_str();
+		packer.serialize(hubHost, deviceId, Storage::DpsCacheKey);
+		break;
+	}
+	case CacheRecordType::WIFI:
+	{
+		const MsgPack::str_t ssid = Storage::WiFiCacheSSID.c_str();
+		const MsgPack::bin_t<uint8_t> bssid(Storage::WiFiCacheBssid, Storage::WiFiCacheBssid + sizeof(Storage::WiFiCacheBssid));
+		packer.serialize(ssid, bssid, Storage::WiFiCacheChannel, Storage::WiFiCacheIp, Storage::WiFiCacheGateway, Storage::WiFiCacheSubnet, Storage::WiFiCacheDns);
+		break;
+	}
+	case CacheRecordType::PROPERTIES:
+	{
+		const MsgPack::str_t properties = Storage::Properties.c_str();
+		packer.serialize(properties);
+		break;
+	}
+	}
+}
+
+static void CacheUnpack(CacheRecordType type, const uint8_t* payload, size_t length)
+{
+	MsgPack::Unpacker unpacker;
+	unpacker.feed(payload, length);
+
+	switch (type)
+	{
+	case CacheRecordType::DPS:
+	{
+		MsgPack::str_t hubHost;
+		MsgPack::str_t deviceId;
+		uint32_t key;
+		unpacker.deserialize(hubHost, deviceId, key);
+
+		Storage::HubHost = hubHost.c_str();
+		Storage::DeviceId = deviceId.c_str();
+		Storage::DpsCacheKey = key;
+		break;
+	}
+	case CacheRecordType::WIFI:
+	{
+		MsgPack::str_t ssid;
+		MsgPack::bin_t<uint8_t> bssid;
+		int32_t channel;
+		uint32_t ip[4];
+		unpacker.deserialize(ssid, bssid, channel, ip[0], ip[1], ip[2], ip[3]);
+
+		ResetWiFiCache();
+		if (bssid.size() == sizeof(Storage::WiFiCacheBssid))
+		{
+			Storage::WiFiCacheSSID = ssid.c_str();
+			memcpy(Storage::WiFiCacheBssid, bssid.data(), sizeof(Storage::WiFiCacheBssid));
+			Storage::WiFiCacheChannel = channel;
+			Storage::WiFiCacheIp = ip[0];
+			Storage::WiFiCacheGateway = ip[1];
+			Storage::WiFiCacheSubnet = ip[2];
+			Storage::WiFiCacheDns = ip[3];
+		}
+		break;
+	}
+	case CacheRecordType::PROPERTIES:
+	{
+		MsgPack::str_t properties;
+		unpacker.deserialize(properties);
+
+		Storage::Properties = properties.c_str();
+		break;
+	}
+	}
+}
+
+// 現在のセクタに収まること
+// ページ(256バイト)の境界で分けて書き込む
+static void CacheWriteRecord(CacheRecordType type, const MsgPack::Packer& packer)
+{
+	CacheRecordHeader header;
+	memset(&header, 0xff, sizeof(header));
+	header.Sequence = CacheNextSequence_++;
+	header.Length = packer.size();
+	header.Type = static_cast<uint8_t>(type);
+	header.Crc = CacheCrc(header, packer.data());
+
+	std::vector<uint8_t> record(sizeof(header) + packer.size());
+	memcpy(&record[0], &header, sizeof(header));
+	memcpy(&record[sizeof(header)], packer.data(), packer.size());
+
+	uint32_t address = CacheSectorAddress(CacheSector_) + CacheOffset_;
+	for (size_t written = 0; written < record.size(); )
+	{
+		size_t size = FLASH_PAGE_SIZE - address % FLASH_PAGE_SIZE;
+		if (size > record.size() - written) size = record.size() - written;
+		Storage::FlashProgram(address, &record[written], size);
+		address += size;
+		written += size;
+	}
+	CacheOffset_ += CacheRecordSize(packer.size());
+}
+
+// 次のセクタを消去して、nextType以外の最新値を書き直す
+static void CacheStartSector(CacheRecordType nextType)
+{
+	CacheSector_ = (CacheSector_ + 1) % STORAGE_CACHE_SECTOR_NUMBER;
+	CacheOffset_ = 0;
+	Storage::FlashEraseSector(CacheSectorAddress(CacheSector_));
+
+	for (CacheRecordType type : CACHE_RECORD_TYPES)
+	{
+		if (type == nextType) continue;
+
+		MsgPack::Packer packer;
+		CachePack(type, packer);
+		CacheWriteRecord(type, packer);
+	}
+}
+
+static void CacheSave(CacheRecordType type)
+{
+	MsgPack::Packer packer;
+	CachePack(type, packer);
+	if (CacheOffset_ + CacheRecordSize(packer.size()) > FLASH_SECTOR_SIZE) CacheStartSector(type);
+	CacheWriteRecord(type, packer);
+}
+
+static bool CacheIsBlank(const uint8_t* p, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (p[i] != 0xff) return false;
+	}
+	return true;
+}
+
+// 種類ごとに最新のレコードを読み込む
+static void CacheLoad()
+{
+	const uint8_t* latest[sizeof(CACHE_RECORD_TYPES) / sizeof(CACHE_RECORD_TYPES[0]) + 1] = { };
+	uint32_t latestSequence[sizeof(latest) / sizeof(latest[0])] = { };
+	uint32_t maxSequence = 0;
+	int maxSector = -1;
+	uint32_t maxSectorEnd = FLASH_SECTOR_SIZE;
+
+	for (int sector = 0; sector < STORAGE_CACHE_SECTOR_NUMBER; ++sector)
+	{
+		uint32_t offset = 0;
+		while (offset + sizeof(CacheRecordHeader) <= FLASH_SECTOR_SIZE)
+		{
+			const uint8_t* p = Storage::FlashRead(CacheSectorAddress(sector) + offset);
+			CacheRecordHeader header;
+			memcpy(&header, p, sizeof(header));
+			if (header.Sequence == CACHE_RECORD_EMPTY && CacheIsBlank(p, sizeof(header))) break;
+
+			// 壊れたレコードの後ろには書き込まない
+			if (header.Sequence == CACHE_RECORD_EMPTY || offset + CacheRecordSize(header.Length) > FLASH_SECTOR_SIZE || header.Crc != CacheCrc(header, p + sizeof(header)))
+			{
+				offset = FLASH_SECTOR_SIZE;
+				break;
+			}
+
+			if (header.Type < sizeof(latest) / sizeof(latest[0]) && (latest[header.Type] == nullptr || header.Sequence > latestSequence[header.Type]))
+			{
+				latest[header.Type] = p;
+				latestSequence[header.Type] = header.Sequence;
+			}
+			if (maxSector < 0 || header.Sequence > maxSequence)
+			{
+				maxSequence = header.Sequence;
+				maxSector = sector;
+			}
+			offset += CacheRecordSize(header.Length);
+		}
+		if (sector == maxSector) maxSectorEnd = offset;
+	}
+
+	if (maxSector < 0)
+	{
+		// 空なら最初の書き込みで消去してから使う
+		CacheSector_ = 0;
+		CacheOffset_ = FLASH_SECTOR_SIZE;
+		CacheNextSequence_ = 1;
+	}
+	else
+	{
+		CacheSector_ = maxSector;
+		CacheOffset_ = maxSectorEnd;
+		CacheNextSequence_ = maxSequence + 1;
+	}
+
+	for (CacheRecordType type : CACHE_RECORD_TYPES)
+	{
+		const uint8_t* p = latest[static_cast<uint8_t>(type)];
+		if (p == nullptr) continue;
+
+		CacheRecordHeader header;
+		memcpy(&header, p, sizeof(header));
+		CacheUnpack(type, p + sizeof(header), header.Length);
+	}
+}
 
 int Storage::Init = [] {
 	Flash.initialize();    
@@ -20,39 +320,78 @@ int Storage::Init = [] {
 
 	WiFiSSID.clear();
 	WiFiPassword.clear();
+	WiFiExtraSSID.clear();
+	WiFiExtraPassword.clear();
+	ResetWiFiCache();
 	IdScope.clear();
 	RegistrationId.clear();
 	SymmetricKey.clear();
+	HubHost.clear();
+	DeviceId.clear();
+	DpsCacheKey = 0;
+	Properties.clear();
 	
 	return 0;
 }();
 
 void Storage::Load()
 {
-	if (memcmp(&FlashStartAddress[0], "AZ01", 4) != 0)
+	Storage::HubHost.clear();
+	Storage::DeviceId.clear();
+	Storage::DpsCacheKey = 0;
+	Storage::Properties.clear();
+	Storage::WiFiExtraSSID.clear();
+	Storage::WiFiExtraPassword.clear();
+	ResetWiFiCache();
+
+	if (memcmp(&FlashStartAddress[0], "AZ01", 4) == 0)
 	{
-		Storage::WiFiSSID.clear();
-		Storage::WiFiPassword.clear();
-		Storage::IdScope.clear();
-		Storage::RegistrationId.clear();
-		Storage::SymmetricKey.clear();
+		MsgPack::Unpacker unpacker;
+		unpacker.feed(&FlashStartAddress[8], *(const uint32_t*)&FlashStartAddress[4]);
+
+		MsgPack::str_t str[5];
+		unpacker.deserialize(str[0], str[1], str[2], str[3], str[4]);
+
+		Storage::WiFiSSID = str[0].c_str();
+		Storage::WiFiPassword = str[1].c_str();
+		Storage::IdScope = str[2].c_str();
+		Storage::RegistrationId = str[3].c_str();
+		Storage::SymmetricKey = str[4].c_str();
 	}
-	else
+	else if (memcmp(&FlashStartAddress[0], "AZ02", 4) == 0)
 	{
 		MsgPack::Unpacker unpacker;
 		unpacker.feed(&FlashStartAddress[8], *(const uint32_t*)&FlashStartAddress[4]);
 
 		MsgPack::str_t str[5];
-		unpacker.deserialize(str[0], str[1], str[2], str[3], str[4]);
+		MsgPack::arr_t<MsgPack::str_t> extraSsid;
+		MsgPack::arr_t<MsgPack::str_t> extraPassword;
+		unpacker.deserialize(str[0], str[1], str[2], str[3], str[4], extraSsid, extraPassword);
 
 		Storage::WiFiSSID = str[0].c_str();
 		Storage::WiFiPassword = str[1].c_str();
 		Storage::IdScope = str[2].c_str();
 		Storage::RegistrationId = str[3].c_str();
 		Storage::SymmetricKey = str[4].c_str();
+		for (size_t i = 0; i < extraSsid.size() && i < extraPassword.size(); ++i)
+		{
+			Storage::WiFiExtraSSID.push_back(extraSsid[i].c_str());
+			Storage::WiFiExtraPassword.push_back(extraPassword[i].c_str());
+		}
+	}
+	else
+	{
+		Storage::WiFiSSID.clear();
+		Storage::WiFiPassword.clear();
+		Storage::IdScope.clear();
+		Storage::RegistrationId.clear();
+		Storage::SymmetricKey.clear();
 	}
+
+	CacheLoad();
 }
 
+// 設定(資格情報など)だけを書き込む。キャッシュやプロパティは書き込まない
 void Storage::Save()
 {
     MsgPack::Packer packer;
@@ -63,22 +402,128 @@ void Storage::Save()
 		str[2] = Storage::IdScope.c_str();
 		str[3] = Storage::RegistrationId.c_str();
 		str[4] = Storage::SymmetricKey.c_str();
-		packer.serialize(str[0], str[1], str[2], str[3], str[4]);
+		MsgPack::arr_t<MsgPack::str_t> extraSsid;
+		MsgPack::arr_t<MsgPack::str_t> extraPassword;
+		for (size_t i = 0; i < Storage::WiFiExtraSSID.size(); ++i)
+		{
+			extraSsid.push_back(Storage::WiFiExtraSSID[i].c_str());
+			extraPassword.push_back(Storage::WiFiExtraPassword[i].c_str());
+		}
+		packer.serialize(str[0], str[1], str[2], str[3], str[4], extraSsid, extraPassword);
 	}
 
 	std::vector<uint8_t> buf(4 + 4 + packer.size());
-	memcpy(&buf[0], "AZ01", 4);
+	memcpy(&buf[0], "AZ02", 4);
 	*(uint32_t*)&buf[4] = packer.size();
 	memcpy(&buf[8], packer.data(), packer.size());
 
 	ExtFlashLoader::writeExternalFlash(Flash, 0, &buf[0], buf.size(), [](std::size_t bytes_processed, std::size_t bytes_total, bool verifying) { return true; });
+	FlashInvalidateCache();
 }
 
 void Storage::Erase()
+{
+	FlashEraseSector(0);
+	for (int sector = 0; sector < STORAGE_CACHE_SECTOR_NUMBER; ++sector) FlashEraseSector(CacheSectorAddress(sector));
+}
+
+// 接続情報のFNV-1aハッシュ
+// 0はキャッシュ無しを表すので使わない
+uint32_t Storage::ComputeDpsCacheKey()
+{
+	uint32_t hash = 2166136261;
+	for (const std::string* str : { &IdScope, &RegistrationId, &SymmetricKey })
+	{
+		// 終端の'\0'も区切りとして含める
+		for (size_t i = 0; i <= str->size(); ++i)
+		{
+			hash ^= static_cast<uint8_t>((*str)[i]);
+			hash *= 16777619;
+		}
+	}
+
+	return hash != 0 ? hash : 1;
+}
+
+bool Storage::IsDpsCacheValid()
+{
+	return DpsCacheKey != 0 && !HubHost.empty() && !DeviceId.empty() && DpsCacheKey == ComputeDpsCacheKey();
+}
+
+void Storage::SaveDpsCache(const std::string& hubHost, const std::string& deviceId)
+{
+	if (IsDpsCacheValid() && HubHost == hubHost && DeviceId == deviceId) return;	// 書き換え回数を減らす
+
+	HubHost = hubHost;
+	DeviceId = deviceId;
+	DpsCacheKey = ComputeDpsCacheKey();
+	CacheSave(CacheRecordType::DPS);
+}
+
+void Storage::InvalidateDpsCache()
+{
+	if (DpsCacheKey == 0 && HubHost.empty() && DeviceId.empty()) return;
+
+	HubHost.clear();
+	DeviceId.clear();
+	DpsCacheKey = 0;
+	CacheSave(CacheRecordType::DPS);
+}
+
+void Storage::SaveProperties(const std::string& properties)
+{
+	if (Properties == properties) return;	// 書き換え回数を減らす
+
+	Properties = properties;
+	CacheSave(CacheRecordType::PROPERTIES);
+}
+
+// 接続先が変わったときだけ書き込む
+void Storage::SaveWiFiCache(const std::string& ssid, const uint8_t* bssid, int32_t channel, uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns)
+{
+	if (WiFiCacheSSID == ssid && memcmp(WiFiCacheBssid, bssid, sizeof(WiFiCacheBssid)) == 0 && WiFiCacheChannel == channel &&
+		WiFiCacheIp == ip && WiFiCacheGateway == gateway && WiFiCacheSubnet == subnet && WiFiCacheDns == dns) return;
+
+	WiFiCacheSSID = ssid;
+	memcpy(WiFiCacheBssid, bssid, sizeof(WiFiCacheBssid));
+	WiFiCacheChannel = channel;
+	WiFiCacheIp = ip;
+	WiFiCacheGateway = gateway;
+	WiFiCacheSubnet = subnet;
+	WiFiCacheDns = dns;
+	CacheSave(CacheRecordType::WIFI);
+}
+
+void Storage::ClearWiFiCache()
+{
+	if (WiFiCacheChannel == 0 && WiFiCacheSSID.empty()) return;
+
+	ResetWiFiCache();
+	CacheSave(CacheRecordType::WIFI);
+}
+
+const uint8_t* Storage::FlashRead(uint32_t address)
+{
+	return &FlashStartAddress[address];
+}
+
+void Storage::FlashEraseSector(uint32_t address)
+{
+	Flash.exitFromMemoryMode();
+	Flash.writeEnable();
+	Flash.eraseSector(address);
+	Flash.waitProgram(0);
+	Flash.enterToMemoryMode();
+	FlashInvalidateCache();
+}
+
+// 1ページ(256バイト)を越えないこと
+void Storage::FlashProgram(uint32_t address, const void* data, size_t size)
 {
 	Flash.exitFromMemoryMode();
 	Flash.writeEnable();
-	Flash.eraseSector(0);
+	Flash.programPage(address, static_cast<const uint8_t*>(data), size);
 	Flash.waitProgram(0);
 	Flash.enterToMemoryMode();
+	FlashInvalidateCache();
 }
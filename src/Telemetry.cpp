@@ -0,0 +1,281 @@
+#include <Arduino.h>
+#include "Config.h"
+#include "Telemetry.h"
+
+#include <ArduinoJson.h>
+#include <cmath>
+#include <type_traits>
+#include "Helper/Nullable.h"
+#include "Measure.h"
+
+// 送信待ちのサンプル(いっぱいになったら古いものから捨てる)
+static TelemetrySample Samples_[TELEMETRY_BATCH_MAX];
+static int Head_ = 0;
+static int Count_ = 0;
+
+static int BatchSize_ = 1;			// 1ならバッチにしない
+static int BatchMaxAge_ = 0;		// 最も古いサンプルからの経過時間がこれを越えたら送る[sec.] 0は無制限
+
+static TelemetryEncoding Encoding_ = TelemetryEncoding::JSON;
+
+static const TelemetrySample& TelemetryAt(int index)
+{
+	return Samples_[(Head_ + index) % TELEMETRY_BATCH_MAX];
+}
+
+constexpr int TELEMETRY_MEMBER_MAX = 1 + 4 * 4 + 1;	// ts, 4項目 x (値, 最小, 最大, 標準偏差), samples
+constexpr int TELEMETRY_RECORD_SIZE = 2 + 4 * 4;	// MessagePackの1サンプル(ts, samples, 4項目 x 4)
+constexpr int TELEMETRY_SLOT_MAX = TELEMETRY_MEMBER_MAX > TELEMETRY_RECORD_SIZE ? TELEMETRY_MEMBER_MAX : TELEMETRY_RECORD_SIZE;
+
+static void TelemetrySetStats(JsonObject obj, const char* minKey, const char* maxKey, const char* stdDevKey, const TelemetryStats& stats)
+{
+	if (stats.Count <= 0) return;
+
+	obj[minKey] = stats.Min;
+	obj[maxKey] = stats.Max;
+	obj[stdDevKey] = stats.StdDev;
+}
+
+// 値がある項目の測定回数の最大(0なら統計なし)
+static int TelemetrySampleCount(const TelemetrySample& sample)
+{
+	int count = 0;
+	if (!NullableIsNull(sample.Co2) && sample.Co2Stats.Count > count) count = sample.Co2Stats.Count;
+	if (!NullableIsNull(sample.Humi) && sample.HumiStats.Count > count) count = sample.HumiStats.Count;
+	if (!NullableIsNull(sample.Temp) && sample.TempStats.Count > count) count = sample.TempStats.Count;
+	if (!NullableIsNull(sample.Wbgt) && sample.WbgtStats.Count > count) count = sample.WbgtStats.Count;
+	return count;
+}
+
+static void TelemetrySetValues(JsonObject obj, const TelemetrySample& sample)
+{
+	if (!NullableIsNull(sample.Co2))
+	{
+		obj["co2"] = sample.Co2;
+		TelemetrySetStats(obj, "co2Min", "co2Max", "co2StdDev", sample.Co2Stats);
+	}
+	if (!NullableIsNull(sample.Humi))
+	{
+		obj["humi"] = static_cast<float>(sample.Humi);
+		TelemetrySetStats(obj, "humiMin", "humiMax", "humiStdDev", sample.HumiStats);
+	}
+	if (!NullableIsNull(sample.Temp))
+	{
+		obj["temp"] = sample.Temp;
+		TelemetrySetStats(obj, "tempMin", "tempMax", "tempStdDev", sample.TempStats);
+	}
+	if (!NullableIsNull(sample.Wbgt))
+	{
+		obj["wbgt"] = sample.Wbgt;
+		TelemetrySetStats(obj, "wbgtMin", "wbgtMax", "wbgtStdDev", sample.WbgtStats);
+	}
+	const int count = TelemetrySampleCount(sample);
+	if (count > 0) obj["samples"] = count;
+}
+
+// 値, 最小, 最大, 標準偏差 の4つ(無いものはnil)
+template<class T>
+static void TelemetryAddValue(JsonArray record, T value, const TelemetryStats& stats)
+{
+	if (NullableIsNull(value)) record.add();
+	else record.add(value);
+
+	if (NullableIsNull(value) || stats.Count <= 0)
+	{
+		record.add();
+		record.add();
+		record.add();
+		return;
+	}
+	record.add(stats.Min);
+	record.add(stats.Max);
+	record.add(stats.StdDev);
+}
+
+// MessagePackではキーを送らず、位置で項目を表す(並びはmodel/telemetry-payload.md)
+// [ts, samples, co2, co2Min, co2Max, co2StdDev, humi, ..., temp, ..., wbgt, ..., wbgtStdDev]
+static void TelemetrySetRecord(JsonArray record, const TelemetrySample& sample)
+{
+	record.add(sample.Time);
+	const int count = TelemetrySampleCount(sample);
+	if (count > 0) record.add(count);
+	else record.add();
+	TelemetryAddValue(record, sample.Co2, sample.Co2Stats);
+	TelemetryAddValue(record, sample.Humi, sample.HumiStats);
+	TelemetryAddValue(record, sample.Temp, sample.TempStats);
+	TelemetryAddValue(record, sample.Wbgt, sample.WbgtStats);
+}
+
+template<class T>
+static void TelemetryCaptureValue(const RunningStats<float>& interval, T current, T* value, TelemetryStats* stats)
+{
+	if (interval.count() <= 0)
+	{
+		// 区間内に測定値が無ければ移動平均
+		*value = current;
+		stats->Count = 0;
+		return;
+	}
+
+	*value = static_cast<T>(std::is_integral<T>::value ? std::round(interval.mean()) : interval.mean());
+	stats->Count = interval.count();
+	stats->Min = interval.min();
+	stats->Max = interval.max();
+	stats->StdDev = interval.stddev();
+}
+
+// 選択中の形式で書き出す
+// MessagePackの数値は型に合わせた最小の表現になる(floatは4バイト)
+template<class TDocument>
+static int TelemetryWrite(const TDocument& doc, char* buf, size_t size)
+{
+	switch (Encoding_)
+	{
+	case TelemetryEncoding::MSGPACK:
+		if (measureMsgPack(doc) > size) return -1;
+		return serializeMsgPack(doc, buf, size);
+	default:
+		if (measureJson(doc) >= size) return -1;
+		return serializeJson(doc, buf, size);
+	}
+}
+
+void TelemetrySetEncoding(TelemetryEncoding encoding)
+{
+	Encoding_ = encoding;
+}
+
+TelemetryEncoding TelemetryGetEncoding()
+{
+	return Encoding_;
+}
+
+// メッセージプロパティ($.ct, $.ce)の値(URLエンコード済み)
+const char* TelemetryGetContentType()
+{
+	switch (Encoding_)
+	{
+	case TelemetryEncoding::MSGPACK: return "application%2Fx-msgpack";
+	default:                         return "application%2Fjson";
+	}
+}
+
+const char* TelemetryGetContentEncoding()
+{
+	switch (Encoding_)
+	{
+	case TelemetryEncoding::MSGPACK: return nullptr;
+	default:                         return "utf-8";
+	}
+}
+
+void TelemetrySetBatch(int size, int maxAgeSec)
+{
+	if (size < 1) size = 1;
+	if (size > TELEMETRY_BATCH_MAX) size = TELEMETRY_BATCH_MAX;
+	if (maxAgeSec < 0) maxAgeSec = 0;
+
+	BatchSize_ = size;
+	BatchMaxAge_ = maxAgeSec;
+}
+
+int TelemetryGetBatchSize()
+{
+	return BatchSize_;
+}
+
+int TelemetryGetBatchMaxAge()
+{
+	return BatchMaxAge_;
+}
+
+TelemetrySample TelemetryCapture(unsigned long epochTime)
+{
+	const MeasureInterval interval = MeasureTakeInterval();
+
+	TelemetrySample sample;
+	sample.Time = epochTime;
+	TelemetryCaptureValue(interval.Co2, Co2Ave, &sample.Co2, &sample.Co2Stats);
+	TelemetryCaptureValue(interval.Humi, HumiAve, &sample.Humi, &sample.HumiStats);
+	TelemetryCaptureValue(interval.Temp, TempAve, &sample.Temp, &sample.TempStats);
+	TelemetryCaptureValue(interval.Wbgt, WbgtAve, &sample.Wbgt, &sample.WbgtStats);
+
+	return sample;
+}
+
+void TelemetryAdd(const TelemetrySample& sample)
+{
+	if (Count_ >= TELEMETRY_BATCH_MAX)
+	{
+		Head_ = (Head_ + 1) % TELEMETRY_BATCH_MAX;
+		--Count_;
+	}
+
+	Samples_[(Head_ + Count_) % TELEMETRY_BATCH_MAX] = sample;
+	++Count_;
+}
+
+bool TelemetryIsFlushDue(unsigned long epochTime)
+{
+	if (Count_ <= 0) return false;
+	if (Count_ >= BatchSize_) return true;
+	if (BatchMaxAge_ > 0 && epochTime - TelemetryAt(0).Time >= static_cast<unsigned long>(BatchMaxAge_)) return true;
+
+	return false;
+}
+
+// JSONでバッチにしない場合は従来通り1つのオブジェクト、
+// バッチの場合はタイムスタンプ付きオブジェクトの配列にする
+// MessagePackは常にサンプルの配列の配列にする
+int TelemetrySerialize(char* buf, size_t size)
+{
+	if (Encoding_ == TelemetryEncoding::JSON && BatchSize_ <= 1 && Count_ == 1)
+	{
+		StaticJsonDocument<JSON_OBJECT_SIZE(TELEMETRY_MEMBER_MAX)> doc;
+		TelemetrySetValues(doc.to<JsonObject>(), TelemetryAt(0));
+
+		return TelemetryWrite(doc, buf, size);
+	}
+
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	for (int i = 0; i < Count_; ++i) samples[i] = TelemetryAt(i);
+
+	return TelemetrySerializeSamples(samples, Count_, buf, size);
+}
+
+int TelemetrySerializeSamples(const TelemetrySample* samples, int count, char* buf, size_t size)
+{
+	if (count > TELEMETRY_BATCH_MAX) return -1;
+
+	StaticJsonDocument<JSON_ARRAY_SIZE(TELEMETRY_BATCH_MAX) + TELEMETRY_BATCH_MAX * JSON_OBJECT_SIZE(TELEMETRY_SLOT_MAX)> doc;
+	JsonArray array = doc.to<JsonArray>();
+	for (int i = 0; i < count; ++i)
+	{
+		if (Encoding_ == TelemetryEncoding::MSGPACK)
+		{
+			TelemetrySetRecord(array.createNestedArray(), samples[i]);
+			continue;
+		}
+
+		JsonObject obj = array.createNestedObject();
+		obj["ts"] = samples[i].Time;
+		TelemetrySetValues(obj, samples[i]);
+	}
+
+	return TelemetryWrite(doc, buf, size);
+}
+
+int TelemetryPopAll(TelemetrySample* samples, int maxCount)
+{
+	int count = Count_ < maxCount ? Count_ : maxCount;
+	for (int i = 0; i < count; ++i) samples[i] = TelemetryAt(i);
+	TelemetryClear();
+
+	return count;
+}
+
+void TelemetryClear()
+{
+	Head_ = 0;
+	Count_ = 0;
+}
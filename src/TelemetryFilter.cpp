@@ -0,0 +1,99 @@
+#include <Arduino.h>
+#include "Config.h"
+#include "TelemetryFilter.h"
+
+#include "Helper/Nullable.h"
+#include "Level.h"
+
+// 項目ごとの最後に送った値
+template<class T>
+struct FilterState
+{
+	bool Valid;
+	T Value;
+	unsigned long Time;		// エポック秒
+};
+
+static TelemetryDeadband Deadband_{ TELEMETRY_DEADBAND_CO2, TELEMETRY_DEADBAND_HUMI, TELEMETRY_DEADBAND_TEMP, TELEMETRY_DEADBAND_WBGT };
+static int Heartbeat_ = TELEMETRY_HEARTBEAT;		// [sec.] 0なら無効
+
+static FilterState<int> Co2_;
+static FilterState<int> Humi_;
+static FilterState<float> Temp_;
+static FilterState<float> Wbgt_;
+
+// 送るべき値ならtrueを返し、最後に送った値として覚える
+// 表示色が変わる(しきい値をまたぐ)ときは変化幅に関係なく送る
+// 区間の最小値や最大値がしきい値をまたいだときも送る
+template<class T>
+static bool FilterPass(FilterState<T>* state, T value, const TelemetryStats& stats, T deadband, int (*level)(T), unsigned long time)
+{
+	if (NullableIsNull(value)) return false;
+
+	const T diff = value >= state->Value ? value - state->Value : state->Value - value;
+	const bool pass =
+		!state->Valid ||
+		deadband <= 0 ||
+		diff >= deadband ||
+		level(value) != level(state->Value) ||
+		(stats.Count > 0 && level(static_cast<T>(stats.Min)) != level(state->Value)) ||
+		(stats.Count > 0 && level(static_cast<T>(stats.Max)) != level(state->Value)) ||
+		(Heartbeat_ > 0 && time - state->Time >= static_cast<unsigned long>(Heartbeat_));
+	if (!pass) return false;
+
+	state->Valid = true;
+	state->Value = value;
+	state->Time = time;
+
+	return true;
+}
+
+void TelemetryFilterSetDeadband(const TelemetryDeadband& deadband)
+{
+	Deadband_ = deadband;
+}
+
+const TelemetryDeadband& TelemetryFilterGetDeadband()
+{
+	return Deadband_;
+}
+
+void TelemetryFilterSetHeartbeat(int heartbeatSec)
+{
+	Heartbeat_ = heartbeatSec >= 0 ? heartbeatSec : 0;
+}
+
+int TelemetryFilterGetHeartbeat()
+{
+	return Heartbeat_;
+}
+
+// 送る必要の無い項目を無効値にする
+// 送る項目が1つも無ければfalseを返す
+bool TelemetryFilterApply(TelemetrySample* sample)
+{
+	bool any = false;
+
+	if (FilterPass(&Co2_, sample->Co2, sample->Co2Stats, Deadband_.Co2, LevelCo2, sample->Time)) any = true;
+	else sample->Co2 = NullableNullValue<int>();
+
+	if (FilterPass(&Humi_, sample->Humi, sample->HumiStats, Deadband_.Humi, LevelHumi, sample->Time)) any = true;
+	else sample->Humi = NullableNullValue<int>();
+
+	if (FilterPass(&Temp_, sample->Temp, sample->TempStats, Deadband_.Temp, LevelTemp, sample->Time)) any = true;
+	else sample->Temp = NullableNullValue<float>();
+
+	if (FilterPass(&Wbgt_, sample->Wbgt, sample->WbgtStats, Deadband_.Wbgt, LevelWbgt, sample->Time)) any = true;
+	else sample->Wbgt = NullableNullValue<float>();
+
+	return any;
+}
+
+// 次回は全項目を送る
+void TelemetryFilterReset()
+{
+	Co2_.Valid = false;
+	Humi_.Valid = false;
+	Temp_.Valid = false;
+	Wbgt_.Valid = false;
+}
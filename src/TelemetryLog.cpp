@@ -0,0 +1,256 @@
+#include <Arduino.h>
+#include "Config.h"
+#include "TelemetryLog.h"
+
+#include <cstring>
+
+// 未接続時のテレメトリを外部フラッシュに追記し、接続後に古い順に送る
+//
+// セクタを順番に使うリング構造で、次のセクタに進むときにだけ消去するので書き換え回数が均等になる
+// 各レコードはCRC付きで、書き込み途中の電源断で壊れたレコードは読み飛ばす
+// 送信済みフラグは消去せずに0xff→0x00と書き込めるので、レコード本体は追記のみ
+
+constexpr uint32_t FLASH_SECTOR_SIZE = 4096;
+constexpr uint32_t RECORD_EMPTY = 0xffffffff;
+
+struct TelemetryLogRecord
+{
+	uint32_t Sequence;
+	uint32_t Time;
+	int32_t Co2;
+	int32_t Humi;
+	float Temp;
+	float Wbgt;
+	uint16_t Crc;
+	uint8_t Sent;			// 0xff:未送信 0x00:送信済み
+	uint8_t Reserved[5];
+};
+static_assert(sizeof(TelemetryLogRecord) == 32, "TelemetryLogRecord must be 32 bytes");
+
+constexpr int RECORDS_PER_SECTOR = FLASH_SECTOR_SIZE / sizeof(TelemetryLogRecord);
+constexpr int RECORD_NUMBER = RECORDS_PER_SECTOR * TELEMETRY_LOG_SECTOR_NUMBER;
+
+static TelemetryLogFlash Flash_ = { nullptr, nullptr, nullptr };
+
+static int WriteSlot_ = 0;
+static int ReadSlot_ = 0;
+static uint32_t NextSequence_ = 1;
+static int PendingCount_ = 0;
+static unsigned long DroppedCount_ = 0;
+
+static int PeekSlots_[TELEMETRY_BATCH_MAX];
+static int PeekCount_ = 0;
+
+static uint32_t SlotAddress(int slot)
+{
+	return TELEMETRY_LOG_ADDRESS + slot * sizeof(TelemetryLogRecord);
+}
+
+static int NextSlot(int slot)
+{
+	return slot + 1 >= RECORD_NUMBER ? 0 : slot + 1;
+}
+
+static uint16_t RecordCrc(const TelemetryLogRecord& record)
+{
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(&record);
+	uint16_t crc = 0xffff;
+	for (size_t i = 0; i < offsetof(TelemetryLogRecord, Crc); ++i)
+	{
+		crc ^= data[i] << 8;
+		for (int bit = 0; bit < 8; ++bit) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static void ReadRecord(int slot, TelemetryLogRecord* record)
+{
+	memcpy(record, Flash_.Read(SlotAddress(slot)), sizeof(*record));
+}
+
+static bool IsValid(const TelemetryLogRecord& record)
+{
+	return record.Sequence != RECORD_EMPTY && record.Crc == RecordCrc(record);
+}
+
+static bool IsBlank(int slot)
+{
+	const uint8_t* p = Flash_.Read(SlotAddress(slot));
+	for (size_t i = 0; i < sizeof(TelemetryLogRecord); ++i)
+	{
+		if (p[i] != 0xff) return false;
+	}
+	return true;
+}
+
+// 書き込み先のセクタを消去する(未送信のレコードは失われる)
+static void EraseSectorOf(int slot)
+{
+	const int first = slot / RECORDS_PER_SECTOR * RECORDS_PER_SECTOR;
+	for (int i = first; i < first + RECORDS_PER_SECTOR; ++i)
+	{
+		TelemetryLogRecord record;
+		ReadRecord(i, &record);
+		if (IsValid(record) && record.Sent != 0)
+		{
+			--PendingCount_;
+			++DroppedCount_;
+		}
+	}
+
+	Flash_.EraseSector(SlotAddress(first));
+
+	// 読み出し位置が消えたセクタにあれば次のセクタの先頭へ
+	if (PendingCount_ <= 0)
+	{
+		PendingCount_ = 0;
+		ReadSlot_ = slot;
+	}
+	else if (ReadSlot_ >= first && ReadSlot_ < first + RECORDS_PER_SECTOR)
+	{
+		ReadSlot_ = (first + RECORDS_PER_SECTOR) % RECORD_NUMBER;
+	}
+}
+
+void TelemetryLogInit(const TelemetryLogFlash& flash)
+{
+	Flash_ = flash;
+	PeekCount_ = 0;
+
+	uint32_t maxSequence = 0;
+	uint32_t minPendingSequence = RECORD_EMPTY;
+	int maxSlot = -1;
+	PendingCount_ = 0;
+
+	for (int slot = 0; slot < RECORD_NUMBER; ++slot)
+	{
+		TelemetryLogRecord record;
+		ReadRecord(slot, &record);
+		if (!IsValid(record)) continue;
+
+		if (maxSlot < 0 || record.Sequence > maxSequence)
+		{
+			maxSequence = record.Sequence;
+			maxSlot = slot;
+		}
+		if (record.Sent != 0)
+		{
+			++PendingCount_;
+			if (record.Sequence < minPendingSequence)
+			{
+				minPendingSequence = record.Sequence;
+				ReadSlot_ = slot;
+			}
+		}
+	}
+
+	if (maxSlot < 0)
+	{
+		WriteSlot_ = 0;
+		NextSequence_ = 1;
+	}
+	else
+	{
+		// 書き込み途中で壊れたレコードの後ろから書く
+		WriteSlot_ = NextSlot(maxSlot);
+		while (WriteSlot_ % RECORDS_PER_SECTOR != 0 && !IsBlank(WriteSlot_)) WriteSlot_ = NextSlot(WriteSlot_);
+		NextSequence_ = maxSequence + 1;
+	}
+	if (PendingCount_ <= 0) ReadSlot_ = WriteSlot_;
+
+	Serial.printf("Telemetry log: %d pending\n", PendingCount_);
+}
+
+bool TelemetryLogAppend(const TelemetrySample& sample)
+{
+	if (Flash_.Program == nullptr) return false;	// 未初期化
+
+	// 壊れたレコードは飛ばし、セクタの先頭に来たら消去する
+	while (WriteSlot_ % RECORDS_PER_SECTOR != 0 && !IsBlank(WriteSlot_)) WriteSlot_ = NextSlot(WriteSlot_);
+	if (WriteSlot_ % RECORDS_PER_SECTOR == 0) EraseSectorOf(WriteSlot_);
+
+	TelemetryLogRecord record;
+	memset(&record, 0xff, sizeof(record));
+	record.Sequence = NextSequence_;
+	record.Time = sample.Time;
+	record.Co2 = sample.Co2;
+	record.Humi = sample.Humi;
+	record.Temp = sample.Temp;
+	record.Wbgt = sample.Wbgt;
+	record.Crc = RecordCrc(record);
+
+	Flash_.Program(SlotAddress(WriteSlot_), &record, sizeof(record));
+
+	TelemetryLogRecord written;
+	ReadRecord(WriteSlot_, &written);
+	const bool result = memcmp(&written, &record, sizeof(record)) == 0;
+
+	if (PendingCount_ <= 0) ReadSlot_ = WriteSlot_;
+	if (result) ++PendingCount_;
+	WriteSlot_ = NextSlot(WriteSlot_);
+	++NextSequence_;
+	PeekCount_ = 0;
+
+	return result;
+}
+
+// 古い順に最大maxCount個を読み出す(送信できたらTelemetryLogMarkSent()を呼ぶ)
+int TelemetryLogPeek(TelemetrySample* samples, int maxCount)
+{
+	if (Flash_.Read == nullptr) return 0;
+	if (maxCount > TELEMETRY_BATCH_MAX) maxCount = TELEMETRY_BATCH_MAX;
+
+	PeekCount_ = 0;
+	if (PendingCount_ <= 0) return 0;
+
+	// 満杯のときはReadSlot_とWriteSlot_が一致するので、先に1つ進めてから比べる
+	int slot = ReadSlot_;
+	do
+	{
+		TelemetryLogRecord record;
+		ReadRecord(slot, &record);
+		if (!IsValid(record) || record.Sent == 0) continue;
+
+		TelemetrySample& sample = samples[PeekCount_];
+		sample = TelemetrySample();		// 区間の統計は記録しない
+		sample.Time = record.Time;
+		sample.Co2 = record.Co2;
+		sample.Humi = record.Humi;
+		sample.Temp = record.Temp;
+		sample.Wbgt = record.Wbgt;
+		PeekSlots_[PeekCount_++] = slot;
+	}
+	while ((slot = NextSlot(slot)) != WriteSlot_ && PeekCount_ < maxCount);
+
+	return PeekCount_;
+}
+
+void TelemetryLogMarkSent(int count)
+{
+	if (count > PeekCount_) count = PeekCount_;
+
+	const uint8_t sent = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		Flash_.Program(SlotAddress(PeekSlots_[i]) + offsetof(TelemetryLogRecord, Sent), &sent, sizeof(sent));
+		--PendingCount_;
+	}
+	if (count > 0) ReadSlot_ = NextSlot(PeekSlots_[count - 1]);
+	if (PendingCount_ <= 0)
+	{
+		PendingCount_ = 0;
+		ReadSlot_ = WriteSlot_;
+	}
+	PeekCount_ = 0;
+}
+
+int TelemetryLogPendingCount()
+{
+	return PendingCount_;
+}
+
+// 消去で失われた未送信のレコード数(起動後の累計)
+unsigned long TelemetryLogDroppedCount()
+{
+	return DroppedCount_;
+}
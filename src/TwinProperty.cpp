@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include "Config.h"
+#include "TwinProperty.h"
+
+#include <cmath>
+#include <string>
+#include "Storage.h"
+
+static const TwinPropertyDef* Defs_ = nullptr;
+static int Count_ = 0;
+static TwinPropertyConfirm Confirm_ = nullptr;
+static float Values_[TWIN_PROPERTY_MAX];
+
+static bool TwinPropertyValid(const TwinPropertyDef& def, float value)
+{
+	if (std::isnan(value)) return false;
+	if (def.Type == TwinPropertyType::INT && value != std::floor(value)) return false;
+	return def.Min <= value && value <= def.Max;
+}
+
+static void TwinPropertyApply(int index, float value)
+{
+	Values_[index] = value;
+	Defs_[index].Apply(value);
+}
+
+static void TwinPropertySave()
+{
+	StaticJsonDocument<JSON_MAX_SIZE> doc;
+	for (int i = 0; i < Count_; ++i)
+	{
+		if (Defs_[i].Type == TwinPropertyType::INT)
+			doc[Defs_[i].Name] = static_cast<int>(Values_[i]);
+		else
+			doc[Defs_[i].Name] = Values_[i];
+	}
+
+	std::string json;
+	serializeJson(doc, json);
+	Storage::SaveProperties(json);
+}
+
+void TwinPropertyInit(const TwinPropertyDef* defs, int count, TwinPropertyConfirm confirm)
+{
+	Defs_ = defs;
+	Count_ = count <= TWIN_PROPERTY_MAX ? count : TWIN_PROPERTY_MAX;
+	Confirm_ = confirm;
+
+	for (int i = 0; i < Count_; ++i) Values_[i] = Defs_[i].Default;
+}
+
+// フラッシュに保存した値を適用する(無い、または範囲外なら既定値)
+void TwinPropertyRestore()
+{
+	StaticJsonDocument<JSON_MAX_SIZE> doc;
+	if (!Storage::Properties.empty() && deserializeJson(doc, Storage::Properties.c_str())) doc.clear();
+
+	for (int i = 0; i < Count_; ++i)
+	{
+		JsonVariantConst stored = doc[Defs_[i].Name];
+		const float value = stored.is<float>() && TwinPropertyValid(Defs_[i], stored.as<float>()) ? stored.as<float>() : Defs_[i].Default;
+		TwinPropertyApply(i, value);
+	}
+}
+
+// desiredに含まれる項目を適用してackを返す
+// confirmAll=trueなら含まれていない項目も現在値を返す
+void TwinPropertyReceived(JsonVariantConst desired, bool confirmAll, int version)
+{
+	TwinPropertyAck acks[TWIN_PROPERTY_MAX];
+	int ackCount = 0;
+	bool changed = false;
+	for (int i = 0; i < Count_; ++i)
+	{
+		const TwinPropertyDef& def = Defs_[i];
+		JsonVariantConst value = desired[def.Name];
+		if (value.isNull())
+		{
+			if (confirmAll) acks[ackCount++] = TwinPropertyAck{ &def, Values_[i], 200 };
+			continue;
+		}
+
+		if (!value.is<float>() || !TwinPropertyValid(def, value.as<float>()))
+		{
+			Serial.printf("%s: invalid value\n", def.Name);
+			acks[ackCount++] = TwinPropertyAck{ &def, Values_[i], 400 };
+			continue;
+		}
+
+		if (value.as<float>() != Values_[i])
+		{
+			TwinPropertyApply(i, value.as<float>());
+			changed = true;
+		}
+		Serial.printf("%s = %g\n", def.Name, Values_[i]);
+		acks[ackCount++] = TwinPropertyAck{ &def, Values_[i], 200 };
+	}
+
+	if (changed) TwinPropertySave();
+	if (ackCount > 0 && Confirm_ != nullptr) Confirm_(acks, ackCount, version);
+}
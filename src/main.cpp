@@ -14,15 +14,27 @@
 #include "Measure.h"
 #include "Series.h"
 #include "Display.h"
+#include "Telemetry.h"
+#include "TelemetryLog.h"
+#include "TelemetryFilter.h"
+#include "TwinProperty.h"
 
-static unsigned long TelemetryInterval = 15000;	// [msec.]
+#include "Helper/Scheduler.h"
+#include "Helper/BootTimeline.h"
+#include "Helper/FreeMemory.h"
+
+static unsigned long TelemetryInterval = TELEMETRY_INTERVAL * 1000;	// [msec.]
 
 static Button Button_(WIO_KEY_C, INPUT_PULLUP, 0);
 static Sound Sound_(WIO_BUZZER);
 static Light Light_(WIO_LIGHT);
 
 static int Tick_ = 0;					// [sec.]
-static unsigned long WorkTime_;			// [msec.]
+
+static Scheduler Scheduler_;
+static BootTimeline BootTimeline_;
+static int TelemetryTaskId_ = -1;
+static int DpsTaskId_ = -1;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Network
@@ -31,117 +43,510 @@ static unsigned long WorkTime_;			// [msec.]
 #include <Network/TimeManager.h>
 #include <Aziot/AziotDps.h>
 #include <Aziot/AziotHub.h>
+#include <Network/Backoff.h>
+#include <Network/RadioDutyCycle.h>
 #include <ArduinoJson.h>
 #include "Helper/Nullable.h"
 
+static WiFiManager WiFiManager_;
 static TimeManager TimeManager_;
+static AziotDps AziotDps_;
+static Backoff DpsBackoff_(5000, 5 * 60 * 1000);
 static AziotHub AziotHub_;
+static RadioDutyCycle RadioDuty_(RADIO_WAKE_WINDOW);
 static std::string HubHost_;
 static std::string DeviceId_;
+static bool HubFromCache_ = false;		// キャッシュした割り当てで接続を試みている
+static int HubCacheFailures_ = 0;
+
+constexpr int HUB_CACHE_FAILURE_MAX = 3;	// キャッシュした割り当てで接続できない回数の上限
 
-static void ConnectWiFi()
+static unsigned long ReconnectTime_;		// トークンを更新する時刻[epoch sec.]
+static bool TokenPrepared_ = false;
+static bool RenewAfterAck_ = false;		// PUBACKを受け取ったらトークンを更新する
+
+// PUBACKが返らなくても、トークンの期限までに余裕を残してここで更新する[sec.]
+constexpr unsigned long TOKEN_RENEW_GRACE = static_cast<unsigned long>(TOKEN_LIFESPAN * (1 - RECONNECT_RATE) / 2);
+
+// SASトークンの更新のために接続し直す
+// テレメトリの送信直後に行い、次の送信までに接続を終える
+// 切断するとPUBACK待ちのメッセージは接続後に再送され重複するので、待ちが無いときに行う
+static void RenewToken()
 {
-    DisplayPrintf("Connecting to SSID: %s\n", Storage::WiFiSSID.c_str());
-	WiFiManager wifiManager;
-	wifiManager.Connect(Storage::WiFiSSID.c_str(), Storage::WiFiPassword.c_str());
-	while (!wifiManager.IsConnected())
-	{
-		DisplayPrintf(".");
-		delay(500);
-	}
-	DisplayPrintf("Connected\n");
+	Serial.printf("Renew token\n");
+	RenewAfterAck_ = false;
+	AziotHub_.Disconnect();
+}
+
+// 送信間隔が長いときは送信の合間に無線を眠らせる
+// キープアライブも送信間隔より長くし、合間にPINGで起こさないようにする(次の接続から有効)
+static void ApplyRadioSchedule()
+{
+	const unsigned long intervalSec = TelemetryInterval / 1000;
+	const bool powerSave = RADIO_POWER_SAVE && intervalSec >= static_cast<unsigned long>(RADIO_POWER_SAVE_MIN_INTERVAL);
+	RadioDuty_.SetEnabled(powerSave);
+
+	unsigned long keepAlive = 4 * intervalSec;
+	if (keepAlive > static_cast<unsigned long>(RADIO_KEEPALIVE_MAX)) keepAlive = RADIO_KEEPALIVE_MAX;
+	AziotHub_.SetKeepAlive(powerSave ? keepAlive : HUB_KEEPALIVE);
 }
 
-static void SyncTimeServer()
+// 送信用の領域に直接シリアライズする(メッセージ毎のヒープ確保なし)
+static void SendTelemetry()
 {
-	DisplayPrintf("Sync time\n");
-	while (!TimeManager_.Update())
+	char* json = AziotHub_.GetPublishBuffer();
+	const int length = TelemetrySerialize(json, AziotHub_.GetPublishBufferSize());
+	if (length < 0)
 	{
-		DisplayPrintf(".");
-		delay(1000);
+		Serial.printf("ERROR: Telemetry too large\n");
+		TelemetryClear();
+		return;
+	}
+
+	if (!AziotHub_.SendTelemetry(json, length))
+	{
+		// 送れなかったものはフラッシュに退避
+		TelemetrySample samples[TELEMETRY_BATCH_MAX];
+		const int count = TelemetryPopAll(samples, TELEMETRY_BATCH_MAX);
+		for (int i = 0; i < count; ++i) TelemetryLogAppend(samples[i]);
+		return;
+	}
+	TelemetryClear();
+
+	if (TimeManager_.GetEpochTime() >= ReconnectTime_)
+	{
+		if (AziotHub_.GetInFlightCount() == 0)
+			RenewToken();
+		else
+			RenewAfterAck_ = true;
 	}
-	DisplayPrintf("Synced.\n");
 }
 
-static void DeviceProvisioning()
+// フラッシュに退避したテレメトリを古い順に送る
+static void SendTelemetryLog()
 {
-	DisplayPrintf("Device provisioning:\n");
-    DisplayPrintf(" Id scope = %s\n", Storage::IdScope.c_str());
-    DisplayPrintf(" Registration id = %s\n", Storage::RegistrationId.c_str());
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	const int count = TelemetryLogPeek(samples, TelemetryGetBatchSize() > 1 ? TelemetryGetBatchSize() : TELEMETRY_BATCH_MAX);
+	if (count <= 0) return;
 
-	AziotDps aziotDps;
-	aziotDps.SetMqttPacketSize(MQTT_PACKET_SIZE);
-
-    if (aziotDps.RegisterDevice(DPS_GLOBAL_DEVICE_ENDPOINT_HOST, Storage::IdScope, Storage::RegistrationId, Storage::SymmetricKey, MODEL_ID, TimeManager_.GetEpochTime() + TOKEN_LIFESPAN, &HubHost_, &DeviceId_) != 0)
-    {
-        DisplayPrintf("ERROR: RegisterDevice()\n");
+	char* json = AziotHub_.GetPublishBuffer();
+	const int length = TelemetrySerializeSamples(samples, count, json, AziotHub_.GetPublishBufferSize());
+	if (length < 0)
+	{
+		Serial.printf("ERROR: Telemetry too large\n");
 		return;
-    }
+	}
 
-    DisplayPrintf("Device provisioned:\n");
-    DisplayPrintf(" Hub host = %s\n", HubHost_.c_str());
-    DisplayPrintf(" Device id = %s\n", DeviceId_.c_str());
+	if (AziotHub_.SendTelemetry(json, length)) TelemetryLogMarkSent(count);
 }
 
-static void SendTelemetry()
+// 書き込み可能なプロパティのackをまとめて送る(1つのパッチに入る数ずつ)
+static void ConfirmTwinProperties(const TwinPropertyAck* acks, int count, int ackVersion)
 {
-	StaticJsonDocument<JSON_MAX_SIZE> doc;
-	if (!NullableIsNull(Co2Ave)) doc["co2"] = Co2Ave;
-	if (!NullableIsNull(HumiAve)) doc["humi"] = static_cast<float>(HumiAve);
-	if (!NullableIsNull(TempAve)) doc["temp"] = TempAve;
-	if (!NullableIsNull(WbgtAve)) doc["wbgt"] = WbgtAve;
+	for (int begin = 0; begin < count; begin += TWIN_CONFIRM_PER_PATCH)
+	{
+		const int end = begin + TWIN_CONFIRM_PER_PATCH < count ? begin + TWIN_CONFIRM_PER_PATCH : count;
 
-	char json[JSON_MAX_SIZE];
-	serializeJson(doc, json);
+		StaticJsonDocument<JSON_OBJECT_SIZE(TWIN_CONFIRM_PER_PATCH) + TWIN_CONFIRM_PER_PATCH * JSON_OBJECT_SIZE(3)> doc;
+		for (int i = begin; i < end; ++i)
+		{
+			JsonObject obj = doc.createNestedObject(acks[i].Def->Name);
+			if (acks[i].Def->Type == TwinPropertyType::INT)
+				obj["value"] = static_cast<int>(acks[i].Value);
+			else
+				obj["value"] = acks[i].Value;
+			obj["ac"] = acks[i].AckCode;
+			obj["av"] = ackVersion;
+		}
 
-	AziotHub_.SendTelemetry(json);
+		char json[TWIN_CONFIRM_MAX_SIZE];
+		if (measureJson(doc) >= sizeof(json))
+		{
+			Serial.printf("ERROR: Twin confirm too large\n");
+			continue;
+		}
+		serializeJson(doc, json);
+		AziotHub_.SendTwinPatch("twin_confirm", json);
+	}
 }
 
-template <typename T>
-static void SendConfirm(const char* requestId, const char* name, T value, int ackCode, int ackVersion)
+static void SetTelemetryEncoding(int encoding)
 {
-	StaticJsonDocument<JSON_MAX_SIZE> doc;
-	doc[name]["value"] = value;
-	doc[name]["ac"] = ackCode;
-	doc[name]["av"] = ackVersion;
+	if (encoding < 0 || encoding >= static_cast<int>(TelemetryEncoding::MAX_)) return;
 
-	char json[JSON_MAX_SIZE];
-	serializeJson(doc, json);
+	TelemetrySetEncoding(static_cast<TelemetryEncoding>(encoding));
+	AziotHub_.SetTelemetryProperties(TelemetryGetContentType(), TelemetryGetContentEncoding());
+}
 
-	AziotHub_.SendTwinPatch(requestId, json);
+static void SetTelemetryDeadband(int co2, int humi, float temp, float wbgt)
+{
+	TelemetryDeadband deadband = TelemetryFilterGetDeadband();
+	if (co2 >= 0) deadband.Co2 = co2;
+	if (humi >= 0) deadband.Humi = humi;
+	if (temp >= 0) deadband.Temp = temp;
+	if (wbgt >= 0) deadband.Wbgt = wbgt;
+	TelemetryFilterSetDeadband(deadband);
 }
 
-static void ReceivedTwinDocument(const char* json, const char* requestId)
+static int Co2AverageNumber_ = CO2_AVERAGE_NUMBER;
+static int HumiAverageNumber_ = HUMI_AVERAGE_NUMBER;
+static int TempAverageNumber_ = TEMP_AVERAGE_NUMBER;
+
+// 書き込み可能なプロパティ(DTDLのwritableなPropertyと合わせること)
+static const TwinPropertyDef TwinProperties_[] =
+{
+	{ "TelemetryInterval"    , TwinPropertyType::INT  , 1, 24 * 60 * 60, TELEMETRY_INTERVAL         , [](float value) { TelemetryInterval = value * 1000; Scheduler_.SetPeriod(TelemetryTaskId_, TelemetryInterval); ApplyRadioSchedule(); } },
+	{ "TelemetryBatchSize"   , TwinPropertyType::INT  , 1, TELEMETRY_BATCH_MAX, 1                  , [](float value) { TelemetrySetBatch(value, TelemetryGetBatchMaxAge()); } },
+	{ "TelemetryBatchMaxAge" , TwinPropertyType::INT  , 0, 24 * 60 * 60, 0                          , [](float value) { TelemetrySetBatch(TelemetryGetBatchSize(), value); } },
+	{ "TelemetryEncoding"    , TwinPropertyType::INT  , 0, static_cast<int>(TelemetryEncoding::MAX_) - 1, 0, [](float value) { SetTelemetryEncoding(value); } },
+	{ "TelemetryDeadbandCo2" , TwinPropertyType::INT  , 0, 10000, TELEMETRY_DEADBAND_CO2            , [](float value) { SetTelemetryDeadband(value, -1, -1, -1); } },
+	{ "TelemetryDeadbandHumi", TwinPropertyType::INT  , 0, 100, TELEMETRY_DEADBAND_HUMI             , [](float value) { SetTelemetryDeadband(-1, value, -1, -1); } },
+	{ "TelemetryDeadbandTemp", TwinPropertyType::FLOAT, 0, 100, TELEMETRY_DEADBAND_TEMP             , [](float value) { SetTelemetryDeadband(-1, -1, value, -1); } },
+	{ "TelemetryDeadbandWbgt", TwinPropertyType::FLOAT, 0, 100, TELEMETRY_DEADBAND_WBGT             , [](float value) { SetTelemetryDeadband(-1, -1, -1, value); } },
+	{ "TelemetryHeartbeat"   , TwinPropertyType::INT  , 0, 24 * 60 * 60, TELEMETRY_HEARTBEAT        , [](float value) { TelemetryFilterSetHeartbeat(value); } },
+	{ "Co2AverageNumber"     , TwinPropertyType::INT  , 1, AVERAGE_NUMBER_MAX, CO2_AVERAGE_NUMBER   , [](float value) { Co2AverageNumber_ = value; MeasureSetAverageNumber(Co2AverageNumber_, HumiAverageNumber_, TempAverageNumber_); } },
+	{ "HumiAverageNumber"    , TwinPropertyType::INT  , 1, AVERAGE_NUMBER_MAX, HUMI_AVERAGE_NUMBER  , [](float value) { HumiAverageNumber_ = value; MeasureSetAverageNumber(Co2AverageNumber_, HumiAverageNumber_, TempAverageNumber_); } },
+	{ "TempAverageNumber"    , TwinPropertyType::INT  , 1, AVERAGE_NUMBER_MAX, TEMP_AVERAGE_NUMBER  , [](float value) { TempAverageNumber_ = value; MeasureSetAverageNumber(Co2AverageNumber_, HumiAverageNumber_, TempAverageNumber_); } },
+	{ "TempOffset"           , TwinPropertyType::FLOAT, -10, 10, TEMP_OFFSET                        , [](float value) { MeasureSetTempOffset(value); } },
+	{ "LcdOnTime"            , TwinPropertyType::INT  , 1, 60 * 60, LCD_ON_TIME                     , [](float value) { LcdOnSetTime(value); } },
+};
+
+// 受信バッファの上でそのまま解析する(文字列をコピーしない)
+// ドキュメントはdesiredだけを取り出し、reportedの分の領域を使わない
+static void ReceivedTwinDocument(char* json, size_t length, az_span requestId)
 {
+	StaticJsonDocument<64> filter;
+	filter["desired"] = true;
+
 	StaticJsonDocument<JSON_MAX_SIZE> doc;
-	if (deserializeJson(doc, json)) return;
+	if (deserializeJson(doc, json, length, DeserializationOption::Filter(filter))) return;
 	JsonVariant ver = doc["desired"]["$version"];
 	if (ver.isNull()) return;
 
-	JsonVariant interval = doc["desired"]["TelemetryInterval"];
-	if (!interval.isNull())
-	{
-		Serial.printf("TelemetryInterval = %d\n", interval.as<int>());
-		TelemetryInterval = interval.as<int>() * 1000;
-	}
-	SendConfirm<int>("twin_confirm", "TelemetryInterval", TelemetryInterval / 1000, 200, ver.as<int>());
+	TwinPropertyReceived(doc["desired"].as<JsonVariant>(), true, ver.as<int>());
 }
 
-static void ReceivedTwinDesiredPatch(const char* json, const char* version)
+static void ReceivedTwinDesiredPatch(char* json, size_t length, az_span version)
 {
 	StaticJsonDocument<JSON_MAX_SIZE> doc;
-	if (deserializeJson(doc, json)) return;
+	if (deserializeJson(doc, json, length)) return;
 	JsonVariant ver = doc["$version"];
 	if (ver.isNull()) return;
 
-	JsonVariant interval = doc["TelemetryInterval"];
-	if (!interval.isNull())
+	TwinPropertyReceived(doc.as<JsonVariant>(), false, ver.as<int>());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks
+
+static void SensorTask()
+{
+	MeasureDoWork();
+
+	static bool firstReading = false;
+	if (!firstReading && MeasureGetStats().Samples > 0)
+	{
+		BootTimeline_.Mark("first reading");
+		firstReading = true;
+	}
+}
+
+static void MeasureTask()
+{
+	SeriesUpdate(Tick_);
+}
+
+static void DisplayTask()
+{
+	DisplayRefresh(Tick_, false);
+
+	static bool firstDisplay = false;
+	if (!firstDisplay && MeasureGetStats().Samples > 0)
+	{
+		BootTimeline_.Mark("first display");
+		if (Storage::IdScope.empty()) BootTimeline_.Print();
+		firstDisplay = true;
+	}
+}
+
+static void LightTask()
+{
+	Light_.Read();
+	LcdOnUpdate();
+	DisplaySetBrightness(LcdOnIsOn() ? LCD_BRIGHTNESS : 0);
+
+	Tick_ = (Tick_ + 1) % 60;
+}
+
+static const ToneStep ModeOffSound_[] = { { 1000, 500 } };
+static const ToneStep ModeSound_[] = { { 1000, 50 }, { 0, 100 } };
+
+static void ButtonTask()
+{
+	Button_.DoWork();
+	if (Button_.WasReleased())
+	{
+		ModeNext();
+
+		Sound_.Stop();
+		switch (ModeCurrent())
+		{
+		case Mode::OFF:
+			Sound_.PlayPattern(ModeOffSound_, 1);
+			break;
+		default:
+			Sound_.PlayPattern(ModeSound_, 2, static_cast<int>(ModeCurrent()));
+			break;
+		}
+		
+		switch (ModeCurrent())
+		{
+		case Mode::OFF:
+			DisplayClear();
+			LcdOnForce(false);
+			DisplaySetBrightness(0);
+			break;
+		default:
+			DisplayClear();
+			LcdOnForce(true);
+			DisplaySetBrightness(LCD_BRIGHTNESS);
+			DisplayRefresh(Tick_, true);
+		}
+	}
+}
+
+static void SoundTask()
+{
+	Sound_.DoWork();
+}
+
+static void StartHub()
+{
+	AziotHub_.Start(HubHost_, DeviceId_, Storage::SymmetricKey, MODEL_ID, [] { return static_cast<uint64_t>(TimeManager_.GetEpochTime() + TOKEN_LIFESPAN); });
+}
+
+// キャッシュを破棄してDPSからやり直す
+// 割り当て直後に拒否され続けたときはDPSへの要求もバックオフする
+static void StartProvisioning()
+{
+	const unsigned long wait = HubFromCache_ ? 0 : DpsBackoff_.Next();
+	Storage::InvalidateDpsCache();
+	HubFromCache_ = false;
+	HubCacheFailures_ = 0;
+	Scheduler_.Schedule(DpsTaskId_, wait);
+}
+
+static void HubStateChanged(AziotHubState state)
+{
+	switch (state)
+	{
+	case AziotHubState::CONNECTING:
+		Serial.printf("Connecting to Azure IoT Hub...\n");
+		DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::BUSY);
+		break;
+	case AziotHubState::BACKOFF:
+		DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::ERROR);
+		if (AziotHub_.IsConnectRejected() || (HubFromCache_ && ++HubCacheFailures_ >= HUB_CACHE_FAILURE_MAX))
+		{
+			Serial.printf("Hub rejected the assignment. Provisioning again.\n");
+			AziotHub_.Stop();
+			StartProvisioning();
+		}
+		break;
+	case AziotHubState::CONNECTED:
+		Serial.printf("> SUCCESS.\n");
+		Serial.printf("Free memory: %u bytes\n", static_cast<unsigned>(FreeMemoryUpdateLowWater()));
+		DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::OK);
+		if (BootTimeline_.Mark("hub")) BootTimeline_.Print();
+		HubFromCache_ = false;
+		HubCacheFailures_ = 0;
+		DpsBackoff_.Reset();
+		ReconnectTime_ = TimeManager_.GetEpochTime() + static_cast<unsigned long>(TOKEN_LIFESPAN * RECONNECT_RATE);
+		TokenPrepared_ = false;
+		RenewAfterAck_ = false;
+
+		AziotHub_.RequestTwinDocument("get_twin");
+
+		{
+			// 接続し直したら全項目を送る
+			TelemetrySample sample = TelemetryCapture(TimeManager_.GetEpochTime());
+			TelemetryFilterReset();
+			if (TelemetryFilterApply(&sample)) TelemetryAdd(sample);
+			if (TelemetryIsFlushDue(sample.Time)) SendTelemetry();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void HubTask()
+{
+	if (AziotHub_.IsConnected())
+	{
+		const unsigned long now = TimeManager_.GetEpochTime();
+		if (!TokenPrepared_ && now + TOKEN_PREPARE_LEAD >= ReconnectTime_)
+		{
+			AziotHub_.PrepareReconnect(ReconnectTime_ + TOKEN_LIFESPAN);
+			TokenPrepared_ = true;
+		}
+
+		// 通常はSendTelemetry()で更新する。PUBACK待ちならすべて受け取ってから更新
+		// 送信が無いまま1周期過ぎたときもここで更新
+		const bool idle = AziotHub_.GetInFlightCount() == 0;
+		if (RenewAfterAck_ && idle) RenewToken();
+		else if (now >= ReconnectTime_ + TelemetryInterval / 1000 + 1 && idle) RenewToken();
+		else if (now >= ReconnectTime_ + TOKEN_RENEW_GRACE) RenewToken();
+	}
+
+	AziotHub_.DoWork();
+
+	// 接続中、PUBACK待ち、退避したテレメトリの再送中は起きたまま
+	RadioDuty_.DoWork(!AziotHub_.IsConnected() || AziotHub_.GetInFlightCount() > 0 || TelemetryLogPendingCount() > 0);
+}
+
+static void DpsTask()
+{
+	if (AziotDps_.GetState() == AziotDpsState::IDLE || AziotDps_.GetState() == AziotDpsState::FAILED)
+	{
+		Serial.printf("Device provisioning:\n");
+		Serial.printf(" Id scope = %s\n", Storage::IdScope.c_str());
+		Serial.printf(" Registration id = %s\n", Storage::RegistrationId.c_str());
+		DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::BUSY);
+		if (AziotDps_.Begin(DPS_GLOBAL_DEVICE_ENDPOINT_HOST, Storage::IdScope, Storage::RegistrationId, Storage::SymmetricKey, MODEL_ID, TimeManager_.GetEpochTime() + TOKEN_LIFESPAN) != 0)
+		{
+			Serial.printf("ERROR: RegisterDevice()\n");
+			DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::ERROR);
+			Scheduler_.Schedule(DpsTaskId_, DpsBackoff_.Next());
+		}
+		return;
+	}
+
+	switch (AziotDps_.DoWork())
+	{
+	case AziotDpsState::WAITING:
+		FreeMemoryUpdateLowWater();		// TLS接続中
+		break;
+	case AziotDpsState::ASSIGNED:
+		AziotDps_.GetResult(&HubHost_, &DeviceId_);
+		Serial.printf("Device provisioned:\n");
+		Serial.printf(" Hub host = %s\n", HubHost_.c_str());
+		Serial.printf(" Device id = %s\n", DeviceId_.c_str());
+
+		Storage::SaveDpsCache(HubHost_, DeviceId_);
+
+		Scheduler_.Cancel(DpsTaskId_);
+		StartHub();
+		break;
+	case AziotDpsState::FAILED:
+	{
+		const unsigned long wait = DpsBackoff_.Next();
+		Serial.printf("ERROR: RegisterDevice(). Try again in %lu msec.\n", wait);
+		DisplaySetStatus(DisplayStatusItem::HUB, DisplayStatusState::ERROR);
+		Scheduler_.Schedule(DpsTaskId_, wait);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// ハブへの接続を始める(キャッシュした割り当てがあればDPSを省く)
+static void StartCloud()
+{
+	if (Storage::IsDpsCacheValid())
+	{
+		Serial.printf("Use cached assignment: %s, %s\n", Storage::HubHost.c_str(), Storage::DeviceId.c_str());
+		HubHost_ = Storage::HubHost;
+		DeviceId_ = Storage::DeviceId;
+		HubFromCache_ = true;
+		StartHub();
+	}
+	else
+	{
+		Scheduler_.Schedule(DpsTaskId_, 0);
+	}
+}
+
+// Wi-Fi接続 → 時刻同期 → ハブ接続の順に、測定や表示を止めずに進める
+static void NetworkTask()
+{
+	if (!WiFiManager_.IsConnected())
+	{
+		DisplaySetStatus(DisplayStatusItem::WIFI, DisplayStatusState::BUSY);
+		return;
+	}
+	DisplaySetStatus(DisplayStatusItem::WIFI, DisplayStatusState::OK);
+	if (BootTimeline_.Mark("wifi")) Serial.printf("Connected to SSID: %s\n", WiFiManager_.GetCache().Ssid.c_str());
+	if (WiFiManager_.TakeCacheChanged())
 	{
-		Serial.printf("TelemetryInterval = %d\n", interval.as<int>());
-		TelemetryInterval = interval.as<int>() * 1000;
+		const WiFiConnectCache& cache = WiFiManager_.GetCache();
+		Storage::SaveWiFiCache(cache.Ssid, cache.Bssid, cache.Channel, cache.Ip, cache.Gateway, cache.Subnet, cache.Dns);
+	}
+
+	if (TimeManager_.IsSynced()) return;
 
-		SendConfirm<int>("twin_confirm", "TelemetryInterval", TelemetryInterval / 1000, 200, ver.as<int>());
+	DisplaySetStatus(DisplayStatusItem::TIME, DisplayStatusState::BUSY);
+	if (!TimeManager_.Update())
+	{
+		DisplaySetStatus(DisplayStatusItem::TIME, DisplayStatusState::ERROR);
+		return;
 	}
+	DisplaySetStatus(DisplayStatusItem::TIME, DisplayStatusState::OK);
+	BootTimeline_.Mark("time");
+
+	StartCloud();
+}
+
+static void TelemetryTask()
+{
+	if (!TimeManager_.IsSynced()) return;	// 時刻が無いと記録できない
+
+	RadioDuty_.Wake();
+
+	TelemetrySample sample = TelemetryCapture(TimeManager_.GetEpochTime());
+	if (!TelemetryFilterApply(&sample))
+	{
+		if (TelemetryIsFlushDue(sample.Time)) SendTelemetry();	// バッチの待ち時間の上限
+		return;
+	}
+	if (!AziotHub_.IsConnected())
+	{
+		TelemetryLogAppend(sample);
+		return;
+	}
+
+	TelemetryAdd(sample);
+	if (TelemetryIsFlushDue(sample.Time)) SendTelemetry();
+}
+
+static void TelemetryReplayTask()
+{
+	if (AziotHub_.IsConnected() && TelemetryLogPendingCount() > 0) SendTelemetryLog();
+}
+
+static void StatsTask()
+{
+	Scheduler_.PrintStats(true);
+
+	const MeasureStats& measure = MeasureGetStats();
+	Serial.printf("Sensor: %lu samples, %lu late, %lu missed, %lu polls\n", measure.Samples, measure.LateSamples, measure.MissedSamples, measure.Polls);
+
+	const WiFiConnectStats& wifi = WiFiManager_.GetStats();
+	Serial.printf("Wi-Fi: %lu connects, %lu fast, %lu failures, latency last %lu avg %lu max %lu ms\n",
+		wifi.Connects, wifi.FastConnects, wifi.Failures, wifi.LatencyLast, wifi.Connects > 0 ? wifi.LatencySum / wifi.Connects : 0, wifi.LatencyMax);
+
+	const RadioDutyCycleStats& radio = RadioDuty_.GetStats();
+	Serial.printf("Radio: %s, %lu wakes, awake %lu ms this hour, %lu ms last hour\n",
+		RadioDuty_.IsEnabled() ? "power save" : "always on", radio.Wakes, radio.AwakeMsThisHour, radio.AwakeMsLastHour);
+
+	const size_t freeMemory = FreeMemoryUpdateLowWater();
+	Serial.printf("Memory: %u bytes free, %u bytes lowest\n", static_cast<unsigned>(freeMemory), static_cast<unsigned>(FreeMemoryGetLowWater()));
+
+	const AziotHubPublishStats& publish = AziotHub_.GetPublishStats();
+	Serial.printf("Publish: %lu sent, %lu acked, %lu retransmitted, %lu window full, %d in flight, latency avg %lu max %lu ms\n",
+		publish.Published, publish.Acked, publish.Retransmitted, publish.WindowFull, AziotHub_.GetInFlightCount(),
+		publish.Acked > 0 ? publish.LatencySum / publish.Acked : 0, publish.LatencyMax);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -159,6 +564,7 @@ void setup()
 
 	Serial.begin(115200);
 	DisplayInit();
+	BootTimeline_.Mark("display");
 
     ////////////////////
     // Enter configuration mode
@@ -172,6 +578,7 @@ void setup()
         digitalRead(WIO_KEY_B) == LOW &&
         digitalRead(WIO_KEY_C) == LOW   )
     {
+        DisplayClear();
         DisplayPrintf("In configuration mode\n");
         CliMode();
     }
@@ -189,19 +596,40 @@ void setup()
 	LcdOnInit(&Light_);
 	MeasureInit();
 	SeriesInit();
+	if (!Storage::IdScope.empty()) TelemetryLogInit({ Storage::FlashRead, Storage::FlashEraseSector, Storage::FlashProgram });
 
     ////////////////////
     // Networking
 
 	if (!Storage::IdScope.empty())
 	{
-		ConnectWiFi();
-		SyncTimeServer();
-		DeviceProvisioning();
-		
+		Serial.printf("Connecting to SSID: %s\n", Storage::WiFiSSID.c_str());
+		WiFiManager_.Connect(Storage::WiFiSSID.c_str(), Storage::WiFiPassword.c_str());
+		for (size_t i = 0; i < Storage::WiFiExtraSSID.size(); ++i) WiFiManager_.AddNetwork(Storage::WiFiExtraSSID[i].c_str(), Storage::WiFiExtraPassword[i].c_str());
+		if (Storage::WiFiCacheChannel > 0)
+		{
+			WiFiConnectCache cache;
+			cache.Ssid = Storage::WiFiCacheSSID;
+			memcpy(cache.Bssid, Storage::WiFiCacheBssid, sizeof(cache.Bssid));
+			cache.Channel = Storage::WiFiCacheChannel;
+			cache.Ip = Storage::WiFiCacheIp;
+			cache.Gateway = Storage::WiFiCacheGateway;
+			cache.Subnet = Storage::WiFiCacheSubnet;
+			cache.Dns = Storage::WiFiCacheDns;
+			WiFiManager_.SetCache(cache, WIFI_REUSE_IP);
+		}
+		DisplaySetStatus(DisplayStatusItem::WIFI, DisplayStatusState::BUSY);
+
+		AziotDps_.SetMqttPacketSize(MQTT_PACKET_SIZE);
 		AziotHub_.SetMqttPacketSize(MQTT_PACKET_SIZE);
+		AziotHub_.SetPublishBufferSize(TELEMETRY_PAYLOAD_MAX_SIZE);
+		AziotHub_.SetPublishQos(TELEMETRY_QOS, TELEMETRY_INFLIGHT_MAX, TELEMETRY_INFLIGHT_BUFFER_SIZE);
+		ApplyRadioSchedule();
+		AziotHub_.SetTelemetryProperties(TelemetryGetContentType(), TelemetryGetContentEncoding());
+		AziotHub_.StateChangedCallback = HubStateChanged;
 		AziotHub_.ReceivedTwinDocumentCallback = ReceivedTwinDocument;
 		AziotHub_.ReceivedTwinDesiredPatchCallback = ReceivedTwinDesiredPatch;
+		AziotHub_.SetTwinLog(TWIN_LOG_MAX_SIZE, TWIN_LOG_INTERVAL);
 	}
 	else
 	{
@@ -211,99 +639,37 @@ void setup()
 	}
 
 	DisplayClear();
-	WorkTime_ = millis();
-}
 
-void loop()
-{
-	if (millis() > WorkTime_ + 1000)
+    ////////////////////
+    // Tasks
+
+	Scheduler_.AddPeriodic("Sensor", SensorTask, SCD30_POLL_INTERVAL);
+	Scheduler_.AddPeriodic("Measure", MeasureTask, 1000);
+	Scheduler_.AddPeriodic("Display", DisplayTask, 1000);
+	Scheduler_.AddPeriodic("Light", LightTask, 1000);
+	Scheduler_.AddPeriodic("Button", ButtonTask, 5);
+	Scheduler_.AddPeriodic("Sound", SoundTask, 5);
+	if (!Storage::IdScope.empty())
 	{
-		WorkTime_ = millis();
-		
-		MeasureRead();
-		SeriesUpdate(Tick_);
-		
-		DisplayRefresh(Tick_, false);
+		Scheduler_.AddPeriodic("Network", NetworkTask, 500);
+		DpsTaskId_ = Scheduler_.AddPeriodic("Dps", DpsTask, 10);
+		Scheduler_.Cancel(DpsTaskId_);		// 時刻同期後に開始
+		Scheduler_.AddPeriodic("Hub", HubTask, 10);
+		TelemetryTaskId_ = Scheduler_.AddPeriodic("Telemetry", TelemetryTask, TelemetryInterval, TelemetryInterval);
+		Scheduler_.AddPeriodic("Replay", TelemetryReplayTask, TELEMETRY_REPLAY_INTERVAL);
+	}
+	if (STATS_LOG) Scheduler_.AddPeriodic("Stats", StatsTask, 60000, 60000);
 
-		Light_.Read();
-		LcdOnUpdate();
-		DisplaySetBrightness(LcdOnIsOn() ? LCD_BRIGHTNESS : 0);
+    ////////////////////
+    // Restore writable properties
 
-		Tick_ = (Tick_ + 1) % 60;
-	}
-	else
-	{
-		Button_.DoWork();
-		if (Button_.WasReleased())
-		{
-			ModeNext();
-
-			switch (ModeCurrent())
-			{
-			case Mode::OFF:
-				Sound_.PlayTone(1000, 500);
-				break;
-			default:
-				for (int i = 0; i < static_cast<int>(ModeCurrent()); ++i)
-				{
-					Sound_.PlayTone(1000, 50);
-					delay(100);
-				}
-				break;
-			}
-			
-			switch (ModeCurrent())
-			{
-			case Mode::OFF:
-				DisplayClear();
-				LcdOnForce(false);
-				DisplaySetBrightness(0);
-				break;
-			default:
-				DisplayClear();
-				LcdOnForce(true);
-				DisplaySetBrightness(LCD_BRIGHTNESS);
-				DisplayRefresh(Tick_, true);
-			}
-		}
-	}
+	TwinPropertyInit(TwinProperties_, sizeof(TwinProperties_) / sizeof(TwinProperties_[0]), ConfirmTwinProperties);
+	TwinPropertyRestore();
 
-    static unsigned long reconnectTime;
-	if (!Storage::IdScope.empty())
-	{
-		if (!AziotHub_.IsConnected())
-		{
-			Serial.printf("Connecting to Azure IoT Hub...\n");
-			const auto now = TimeManager_.GetEpochTime();
-			if (AziotHub_.Connect(HubHost_, DeviceId_, Storage::SymmetricKey, MODEL_ID, now + TOKEN_LIFESPAN) != 0)
-			{
-				Serial.printf("> ERROR. Try again in 5 seconds.\n");
-				delay(5000);
-				return;
-			}
-
-			Serial.printf("> SUCCESS.\n");
-			reconnectTime = TimeManager_.GetEpochTime() + static_cast<unsigned long>(TOKEN_LIFESPAN * RECONNECT_RATE);
-
-			AziotHub_.RequestTwinDocument("get_twin");
-		}
-		else
-		{
-			if (TimeManager_.GetEpochTime() >= reconnectTime)
-			{
-				Serial.printf("Disconnect\n");
-				AziotHub_.Disconnect();
-				return;
-			}
-
-			AziotHub_.DoWork();
-
-			static unsigned long nextTelemetrySendTime = 0;
-			if (millis() > nextTelemetrySendTime)
-			{
-				SendTelemetry();
-				nextTelemetrySendTime = millis() + TelemetryInterval;
-			}
-		}
-	}
+	BootTimeline_.Mark("setup");
+}
+
+void loop()
+{
+	Scheduler_.DoWork();
 }
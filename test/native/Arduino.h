@@ -0,0 +1,58 @@
+#pragma once
+
+// ネイティブ環境(ホストでのユニットテスト)用のArduino APIの代用
+// millis()はテストから進める時刻で、実時間とは関係ない
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+inline unsigned long& NativeMillis()
+{
+	static unsigned long now = 0;
+	return now;
+}
+
+inline void NativeAdvance(unsigned long ms)
+{
+	NativeMillis() += ms;
+}
+
+inline unsigned long millis()
+{
+	return NativeMillis();
+}
+
+inline unsigned long micros()
+{
+	return NativeMillis() * 1000;
+}
+
+inline long random(long min, long max)
+{
+	if (max <= min) return min;
+	return min + std::rand() % (max - min);
+}
+
+inline long random(long max)
+{
+	return random(0, max);
+}
+
+class NativeSerial
+{
+public:
+	int printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+	{
+		va_list arg;
+		va_start(arg, format);
+		const int length = std::vprintf(format, arg);
+		va_end(arg);
+		return length;
+	}
+
+};
+
+static NativeSerial Serial __attribute__((unused));
@@ -0,0 +1,33 @@
+#pragma once
+
+// ネイティブ環境用のArduinoのClientの代用(MqttAckClientが使う仮想関数だけ)
+
+#include <cstddef>
+#include <cstdint>
+
+class IPAddress
+{
+public:
+	uint8_t Octets[4];
+
+};
+
+class Client
+{
+public:
+	virtual ~Client() {}
+
+	virtual int connect(IPAddress ip, uint16_t port) = 0;
+	virtual int connect(const char* host, uint16_t port) = 0;
+	virtual size_t write(uint8_t data) = 0;
+	virtual size_t write(const uint8_t* buf, size_t size) = 0;
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int read(uint8_t* buf, size_t size) = 0;
+	virtual int peek() = 0;
+	virtual void flush() = 0;
+	virtual void stop() = 0;
+	virtual uint8_t connected() = 0;
+	virtual operator bool() = 0;
+
+};
@@ -0,0 +1,31 @@
+#include "MeasureStub.h"
+
+int Co2Ave;
+int HumiAve;
+float TempAve;
+float WbgtAve;
+
+static MeasureInterval Interval_;
+
+void MeasureStubSetAverage(int co2, int humi, float temp, float wbgt)
+{
+	Co2Ave = co2;
+	HumiAve = humi;
+	TempAve = temp;
+	WbgtAve = wbgt;
+}
+
+void MeasureStubPush(float co2, float humi, float temp, float wbgt)
+{
+	Interval_.Co2.push_back(co2);
+	Interval_.Humi.push_back(humi);
+	Interval_.Temp.push_back(temp);
+	Interval_.Wbgt.push_back(wbgt);
+}
+
+MeasureInterval MeasureTakeInterval()
+{
+	const MeasureInterval interval = Interval_;
+	Interval_ = MeasureInterval();
+	return interval;
+}
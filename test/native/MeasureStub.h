@@ -0,0 +1,7 @@
+#pragma once
+
+#include "Measure.h"
+
+// Measure.cppの代わり(値はテストが決める)
+void MeasureStubSetAverage(int co2, int humi, float temp, float wbgt);
+void MeasureStubPush(float co2, float humi, float temp, float wbgt);	// 区間の測定値
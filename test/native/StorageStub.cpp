@@ -0,0 +1,9 @@
+#include "Storage.h"
+
+// Storage.cppの代わり(フラッシュには書かず、メモリに残すだけ)
+std::string Storage::Properties;
+
+void Storage::SaveProperties(const std::string& properties)
+{
+	Properties = properties;
+}
@@ -0,0 +1,81 @@
+#include <unity.h>
+
+#include <cstdlib>
+#include "Network/Backoff.h"
+
+void setUp()
+{
+	std::srand(1);
+}
+
+void tearDown()
+{
+}
+
+// 待ち時間が基準値の±25%に収まることを確認し、基準値を2倍する(上限あり)
+static void ExpectRange(Backoff& backoff, unsigned long base)
+{
+	const unsigned long wait = backoff.Next();
+	TEST_ASSERT_GREATER_OR_EQUAL(base - base / 4, wait);
+	TEST_ASSERT_LESS_OR_EQUAL(base + base / 4, wait);
+}
+
+static void test_doubles_up_to_max()
+{
+	Backoff backoff(1000, 60000);
+
+	unsigned long base = 1000;
+	for (int i = 0; i < 10; ++i)
+	{
+		ExpectRange(backoff, base);
+		base = base * 2 > 60000 ? 60000 : base * 2;
+	}
+	TEST_ASSERT_EQUAL(60000, base);
+	for (int i = 0; i < 100; ++i) ExpectRange(backoff, 60000);
+}
+
+static void test_reset()
+{
+	Backoff backoff(500, 8000);
+	for (int i = 0; i < 8; ++i) backoff.Next();
+
+	backoff.Reset();
+	ExpectRange(backoff, 500);
+	ExpectRange(backoff, 1000);
+}
+
+// 同時に再接続する端末が揃わないようにジッタが散らばる
+static void test_jitter_spreads()
+{
+	Backoff backoff(10000, 10000);
+
+	unsigned long min = backoff.Next();
+	unsigned long max = min;
+	for (int i = 0; i < 1000; ++i)
+	{
+		const unsigned long wait = backoff.Next();
+		if (wait < min) min = wait;
+		if (wait > max) max = wait;
+	}
+	TEST_ASSERT_LESS_THAN(8000, min);
+	TEST_ASSERT_GREATER_THAN(12000, max);
+}
+
+static void test_small_initial_value()
+{
+	Backoff backoff(1, 4);
+	TEST_ASSERT_EQUAL(1, backoff.Next());
+	TEST_ASSERT_EQUAL(2, backoff.Next());
+	ExpectRange(backoff, 4);
+	ExpectRange(backoff, 4);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_doubles_up_to_max);
+	RUN_TEST(test_reset);
+	RUN_TEST(test_jitter_spreads);
+	RUN_TEST(test_small_initial_value);
+	return UNITY_END();
+}
@@ -0,0 +1,330 @@
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "Network/MqttAckClient.h"
+
+// 受信データを決めた大きさに区切って返すClient
+class FakeClient : public Client
+{
+public:
+	std::vector<uint8_t> Rx;
+	size_t RxPos = 0;
+	size_t Chunk = SIZE_MAX;
+	std::vector<uint8_t> Tx;
+
+	int connect(IPAddress ip, uint16_t port) override { return 1; }
+	int connect(const char* host, uint16_t port) override { return 1; }
+	size_t write(uint8_t data) override { Tx.push_back(data); return 1; }
+	size_t write(const uint8_t* buf, size_t size) override { Tx.insert(Tx.end(), buf, buf + size); return size; }
+	int available() override { return static_cast<int>(Rx.size() - RxPos); }
+	int read() override { return RxPos < Rx.size() ? Rx[RxPos++] : -1; }
+	int read(uint8_t* buf, size_t size) override
+	{
+		if (size > Chunk) size = Chunk;
+		if (size > Rx.size() - RxPos) size = Rx.size() - RxPos;
+		memcpy(buf, &Rx[RxPos], size);
+		RxPos += size;
+		return static_cast<int>(size);
+	}
+	int peek() override { return RxPos < Rx.size() ? Rx[RxPos] : -1; }
+	void flush() override {}
+	void stop() override {}
+	uint8_t connected() override { return 1; }
+	operator bool() override { return true; }
+
+};
+
+static FakeClient Fake_;
+static std::vector<uint16_t> Acked_;
+
+static void AddPacket(std::initializer_list<uint8_t> bytes)
+{
+	Fake_.Rx.insert(Fake_.Rx.end(), bytes);
+}
+
+static void AddPubAck(uint16_t packetId)
+{
+	AddPacket({ 0x40, 0x02, static_cast<uint8_t>(packetId >> 8), static_cast<uint8_t>(packetId) });
+}
+
+// 受信データを全て読む
+static void ReadAll(MqttAckClient& client, size_t bufSize)
+{
+	uint8_t buf[256];
+	if (bufSize > sizeof(buf)) bufSize = sizeof(buf);
+	while (client.available() > 0)
+	{
+		if (bufSize == 1)
+			client.read();
+		else
+			client.read(buf, bufSize);
+	}
+}
+
+void setUp()
+{
+	Fake_ = FakeClient();
+	Acked_.clear();
+}
+
+void tearDown()
+{
+}
+
+static void TrackPubAck(MqttAckClient& client)
+{
+	client.PubAckCallback = [](uint16_t packetId) { Acked_.push_back(packetId); };
+}
+
+static void test_puback_in_one_read()
+{
+	MqttAckClient client(Fake_);
+	TrackPubAck(client);
+	AddPubAck(1);
+	AddPubAck(0x1234);
+	ReadAll(client, 256);
+
+	TEST_ASSERT_EQUAL(2, Acked_.size());
+	TEST_ASSERT_EQUAL(1, Acked_[0]);
+	TEST_ASSERT_EQUAL(0x1234, Acked_[1]);
+}
+
+// TLSのレコード境界などでパケットが分かれても追える
+static void test_puback_split_across_reads()
+{
+	const size_t chunks[] = { 1, 2, 3, 5 };
+	for (size_t chunk : chunks)
+	{
+		setUp();
+		MqttAckClient client(Fake_);
+		TrackPubAck(client);
+		Fake_.Chunk = chunk;
+		for (uint16_t id = 1; id <= 20; ++id) AddPubAck(id);
+		ReadAll(client, chunk == 1 ? 1 : 256);
+
+		TEST_ASSERT_EQUAL(20, Acked_.size());
+		for (uint16_t id = 1; id <= 20; ++id) TEST_ASSERT_EQUAL(id, Acked_[id - 1]);
+	}
+}
+
+// PUBACK以外(本文にPUBACKと同じ並びを含むPUBLISHなど)は通知しない
+static void test_other_packets_are_ignored()
+{
+	MqttAckClient client(Fake_);
+	TrackPubAck(client);
+	AddPacket({ 0x20, 0x02, 0x00, 0x00 });							// CONNACK
+	AddPacket({ 0x90, 0x03, 0x00, 0x01, 0x01 });					// SUBACK
+	AddPacket({ 0xd0, 0x00 });										// PINGRESP(長さ0)
+	AddPacket({ 0x30, 0x07, 0x00, 0x01, 't', 0x40, 0x02, 0x00, 0x09 });	// PUBLISH QoS0
+	AddPubAck(7);
+	ReadAll(client, 4);
+
+	TEST_ASSERT_EQUAL(1, Acked_.size());
+	TEST_ASSERT_EQUAL(7, Acked_[0]);
+}
+
+// 残りの長さが2バイト以上のパケットの後ろも正しく区切る
+static void test_multibyte_remaining_length()
+{
+	MqttAckClient client(Fake_);
+	TrackPubAck(client);
+	const size_t sizes[] = { 127, 128, 300, 16384 };
+	for (size_t size : sizes)
+	{
+		uint8_t header[MqttAckClient::PUBLISH_HEADER_OVERHEAD + 8];
+		const size_t headerLength = MqttAckClient::EncodePublishHeader(header, "twin", 0x4004, size, false);
+		Fake_.Rx.insert(Fake_.Rx.end(), header, header + headerLength);
+		Fake_.Rx.insert(Fake_.Rx.end(), size, 0x40);
+		AddPubAck(static_cast<uint16_t>(size));
+	}
+	ReadAll(client, 100);
+
+	TEST_ASSERT_EQUAL(4, Acked_.size());
+	for (size_t i = 0; i < 4; ++i) TEST_ASSERT_EQUAL(sizes[i], Acked_[i]);
+}
+
+// 切断したら途中まで読んだパケットは捨てる
+static void test_stop_resets_parser()
+{
+	MqttAckClient client(Fake_);
+	TrackPubAck(client);
+	AddPacket({ 0x40, 0x02, 0x00 });
+	ReadAll(client, 256);
+	client.stop();
+
+	AddPubAck(3);
+	ReadAll(client, 256);
+	TEST_ASSERT_EQUAL(1, Acked_.size());
+	TEST_ASSERT_EQUAL(3, Acked_[0]);
+}
+
+static void test_encode_publish_header()
+{
+	uint8_t buf[MqttAckClient::PUBLISH_HEADER_OVERHEAD + 16];
+
+	size_t length = MqttAckClient::EncodePublishHeader(buf, "a/b", 0x0102, 10, false);
+	const uint8_t expected[] = { 0x32, 2 + 3 + 2 + 10, 0x00, 0x03, 'a', '/', 'b', 0x01, 0x02 };
+	TEST_ASSERT_EQUAL(sizeof(expected), length);
+	TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+
+	// 再送はDUPフラグを立てる
+	MqttAckClient::EncodePublishHeader(buf, "a/b", 0x0102, 10, true);
+	TEST_ASSERT_EQUAL_UINT8(0x3a, buf[0]);
+
+	// 残りの長さ127は1バイト、128は2バイト
+	length = MqttAckClient::EncodePublishHeader(buf, "t", 1, 127 - 5, false);
+	TEST_ASSERT_EQUAL(1 + 1 + 5, length);
+	TEST_ASSERT_EQUAL_UINT8(127, buf[1]);
+	length = MqttAckClient::EncodePublishHeader(buf, "t", 1, 128 - 5, false);
+	TEST_ASSERT_EQUAL(1 + 2 + 5, length);
+	TEST_ASSERT_EQUAL_UINT8(0x80, buf[1]);
+	TEST_ASSERT_EQUAL_UINT8(0x01, buf[2]);
+
+	// 最大の4バイト
+	length = MqttAckClient::EncodePublishHeader(buf, "", 1, 268435455 - 4, false);
+	TEST_ASSERT_EQUAL(MqttAckClient::PUBLISH_HEADER_OVERHEAD, length);
+	const uint8_t maxLength[] = { 0xff, 0xff, 0xff, 0x7f };
+	TEST_ASSERT_EQUAL_MEMORY(maxLength, &buf[1], sizeof(maxLength));
+}
+
+// ローカルのブローカー(mosquittoなど)に接続するClient
+class SocketClient : public Client
+{
+public:
+	int Fd = -1;
+
+	int connect(IPAddress ip, uint16_t port) override { return 0; }
+	int connect(const char* host, uint16_t port) override
+	{
+		addrinfo hints = addrinfo();
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* result;
+		if (getaddrinfo(host, std::to_string(port).c_str(), &hints, &result) != 0) return 0;
+		for (addrinfo* ai = result; ai != nullptr && Fd < 0; ai = ai->ai_next)
+		{
+			Fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (Fd >= 0 && ::connect(Fd, ai->ai_addr, ai->ai_addrlen) != 0) stop();
+		}
+		freeaddrinfo(result);
+		return Fd >= 0 ? 1 : 0;
+	}
+	size_t write(uint8_t data) override { return write(&data, 1); }
+	size_t write(const uint8_t* buf, size_t size) override
+	{
+		const ssize_t length = send(Fd, buf, size, MSG_NOSIGNAL);
+		return length > 0 ? length : 0;
+	}
+	// 最大100msec.待つ
+	int available() override
+	{
+		pollfd fd = { Fd, POLLIN, 0 };
+		return poll(&fd, 1, 100) > 0 ? 1 : 0;
+	}
+	int read() override
+	{
+		uint8_t data;
+		return read(&data, 1) == 1 ? data : -1;
+	}
+	int read(uint8_t* buf, size_t size) override
+	{
+		const ssize_t length = recv(Fd, buf, size, MSG_DONTWAIT);
+		return length > 0 ? static_cast<int>(length) : -1;
+	}
+	int peek() override { return -1; }
+	void flush() override {}
+	void stop() override
+	{
+		if (Fd >= 0) close(Fd);
+		Fd = -1;
+	}
+	uint8_t connected() override { return Fd >= 0; }
+	operator bool() override { return Fd >= 0; }
+
+};
+
+// 環境変数MQTT_TEST_HOST, MQTT_TEST_PORTのブローカーにQoS1で送り、全てのPUBACKを受け取る
+static void test_end_to_end_with_broker()
+{
+	const char* host = getenv("MQTT_TEST_HOST") != nullptr ? getenv("MQTT_TEST_HOST") : "127.0.0.1";
+	const uint16_t port = getenv("MQTT_TEST_PORT") != nullptr ? atoi(getenv("MQTT_TEST_PORT")) : 1883;
+
+	SocketClient transport;
+	MqttAckClient client(transport);
+	TrackPubAck(client);
+	if (!client.connect(host, port))
+	{
+		TEST_IGNORE_MESSAGE("No MQTT broker (set MQTT_TEST_HOST and MQTT_TEST_PORT)");
+		return;
+	}
+
+	// CONNECT(MQTT 3.1.1、クリーンセッション、キープアライブ60秒)
+	const char clientId[] = "wioterminal-host-test";
+	std::vector<uint8_t> connect = { 0x10, static_cast<uint8_t>(10 + 2 + sizeof(clientId) - 1), 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 60, 0x00, static_cast<uint8_t>(sizeof(clientId) - 1) };
+	connect.insert(connect.end(), clientId, clientId + sizeof(clientId) - 1);
+	TEST_ASSERT_EQUAL(connect.size(), client.write(connect.data(), connect.size()));
+
+	uint8_t connack[4];
+	size_t received = 0;
+	for (int i = 0; i < 50 && received < sizeof(connack); ++i)
+	{
+		if (client.available() <= 0) continue;
+		const int length = client.read(&connack[received], sizeof(connack) - received);
+		if (length > 0) received += length;
+	}
+	TEST_ASSERT_EQUAL(sizeof(connack), received);
+	TEST_ASSERT_EQUAL_UINT8(0x20, connack[0]);
+	TEST_ASSERT_EQUAL_UINT8(0x00, connack[3]);
+
+	constexpr int COUNT = 200;
+	const char topic[] = "wioterminal/test/telemetry";
+	const char payload[] = "{\"co2\":812,\"humi\":45,\"temp\":25.4,\"wbgt\":22.3}";
+	const auto start = std::chrono::steady_clock::now();
+	for (uint16_t id = 1; id <= COUNT; ++id)
+	{
+		uint8_t header[MqttAckClient::PUBLISH_HEADER_OVERHEAD + sizeof(topic)];
+		const size_t headerLength = MqttAckClient::EncodePublishHeader(header, topic, id, sizeof(payload) - 1, false);
+		TEST_ASSERT_EQUAL(headerLength, client.write(header, headerLength));
+		TEST_ASSERT_EQUAL(sizeof(payload) - 1, client.write(reinterpret_cast<const uint8_t*>(payload), sizeof(payload) - 1));
+	}
+
+	uint8_t buf[256];
+	for (int i = 0; i < 50 && Acked_.size() < COUNT; ++i)
+	{
+		while (client.available() > 0 && client.read(buf, sizeof(buf)) > 0) {}
+	}
+	const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const uint8_t disconnect[] = { 0xe0, 0x00 };
+	client.write(disconnect, sizeof(disconnect));
+	client.stop();
+
+	char message[100];
+	snprintf(message, sizeof(message), "%s:%u %d QoS1 messages acknowledged in %.1f ms", host, port, static_cast<int>(Acked_.size()), time);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_EQUAL(COUNT, Acked_.size());
+	for (uint16_t id = 1; id <= COUNT; ++id) TEST_ASSERT_EQUAL(id, Acked_[id - 1]);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_puback_in_one_read);
+	RUN_TEST(test_puback_split_across_reads);
+	RUN_TEST(test_other_packets_are_ignored);
+	RUN_TEST(test_multibyte_remaining_length);
+	RUN_TEST(test_stop_resets_parser);
+	RUN_TEST(test_encode_publish_header);
+	RUN_TEST(test_end_to_end_with_broker);
+	return UNITY_END();
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Network/PublishWindow.h"
+
+static const char TOPIC[] = "devices/dev/messages/events/";
+
+// 送り直したメッセージの記録
+struct Sent
+{
+	std::string Topic;
+	uint16_t PacketId;
+	std::string Payload;
+};
+
+static PublishWindow Window_;
+static std::vector<Sent> Sent_;
+static int SendLimit_;		// これ以上送ると失敗する(切断の代わり)
+
+static bool Send(const char* topic, uint16_t packetId, const uint8_t* payload, size_t length)
+{
+	if (static_cast<int>(Sent_.size()) >= SendLimit_) return false;
+	Sent_.push_back(Sent{ topic, packetId, std::string(reinterpret_cast<const char*>(payload), length) });
+	return true;
+}
+
+static uint16_t Add(const std::string& payload, unsigned long now)
+{
+	const PublishWindow::Entry* entry = Window_.Add(TOPIC, payload.data(), payload.size(), now);
+	return entry != nullptr ? entry->PacketId : 0;
+}
+
+// トピックと本文を合わせた大きさがsizeになる本文
+static std::string Payload(size_t size, char fill)
+{
+	return std::string(size - sizeof(TOPIC), fill);
+}
+
+void setUp()
+{
+	Window_ = PublishWindow();
+	Sent_.clear();
+	SendLimit_ = 100;
+}
+
+void tearDown()
+{
+}
+
+static void test_window_limit()
+{
+	Window_.Init(3, 4096);
+	TEST_ASSERT_EQUAL_UINT16(1, Add("a", 0));
+	TEST_ASSERT_EQUAL_UINT16(2, Add("b", 0));
+	TEST_ASSERT_EQUAL_UINT16(3, Add("c", 0));
+	TEST_ASSERT_EQUAL_UINT16(0, Add("d", 0));
+	TEST_ASSERT_EQUAL(3, Window_.GetCount());
+	TEST_ASSERT_EQUAL_UINT32(3, Window_.GetStats().Published);
+	TEST_ASSERT_EQUAL_UINT32(1, Window_.GetStats().WindowFull);
+
+	TEST_ASSERT_TRUE(Window_.Ack(1, 10));
+	TEST_ASSERT_EQUAL_UINT16(4, Add("d", 10));
+}
+
+// 領域は古いものから順に空くので、途中にPUBACKが来ても先頭が残っていれば使えない
+static void test_shared_buffer_frees_in_order()
+{
+	Window_.Init(4, 1000);
+	TEST_ASSERT_EQUAL_UINT16(1, Add(Payload(400, 'a'), 0));
+	TEST_ASSERT_EQUAL_UINT16(2, Add(Payload(400, 'b'), 0));
+	TEST_ASSERT_EQUAL_UINT16(0, Add(Payload(400, 'c'), 0));
+	TEST_ASSERT_EQUAL_UINT32(1, Window_.GetStats().WindowFull);
+
+	TEST_ASSERT_TRUE(Window_.Ack(2, 0));
+	TEST_ASSERT_EQUAL_UINT16(0, Add(Payload(400, 'c'), 0));
+	TEST_ASSERT_EQUAL(1, Window_.GetCount());
+
+	TEST_ASSERT_TRUE(Window_.Ack(1, 0));
+	TEST_ASSERT_EQUAL(0, Window_.GetCount());
+	TEST_ASSERT_EQUAL_UINT16(3, Add(Payload(400, 'c'), 0));
+}
+
+// 末尾に入らなければ先頭に折り返し、内容は壊れない
+static void test_shared_buffer_wraps()
+{
+	Window_.Init(4, 1000);
+	const std::string a = Payload(400, 'a');
+	const std::string b = Payload(400, 'b');
+	const std::string c = Payload(300, 'c');
+	TEST_ASSERT_EQUAL_UINT16(1, Add(a, 0));
+	TEST_ASSERT_EQUAL_UINT16(2, Add(b, 0));
+	TEST_ASSERT_TRUE(Window_.Ack(1, 0));
+	TEST_ASSERT_EQUAL_UINT16(3, Add(c, 0));				// [0, 300) に折り返す
+	TEST_ASSERT_EQUAL_UINT16(0, Add(Payload(200, 'd'), 0));	// 300から先頭のbの400までは100しかない
+	TEST_ASSERT_EQUAL_UINT16(4, Add(Payload(100, 'd'), 0));
+
+	TEST_ASSERT_EQUAL(3, Window_.Retransmit(0, 0, false, Send));
+	TEST_ASSERT_EQUAL_STRING(TOPIC, Sent_[0].Topic.c_str());
+	TEST_ASSERT_TRUE(Sent_[0].Payload == b);
+	TEST_ASSERT_TRUE(Sent_[1].Payload == c);
+	TEST_ASSERT_TRUE(Sent_[2].Payload == Payload(100, 'd'));
+}
+
+// バッファより大きいものは空くのを待っても入らないので、窓が一杯とは数えない
+static void test_too_large()
+{
+	Window_.Init(4, 1000);
+	TEST_ASSERT_EQUAL_UINT16(0, Add(Payload(1001, 'x'), 0));
+	TEST_ASSERT_EQUAL_UINT32(0, Window_.GetStats().WindowFull);
+	TEST_ASSERT_EQUAL_UINT32(0, Window_.GetStats().Published);
+	TEST_ASSERT_EQUAL_UINT16(1, Add(Payload(1000, 'x'), 0));
+}
+
+// 再接続したら、PUBACKが来ていないものを送った順に全て送り直す
+static void test_retransmit_on_reconnect()
+{
+	Window_.Init(4, 4096);
+	Add("a", 0);
+	Add("b", 100);
+	Add("c", 200);
+	Window_.Ack(2, 300);
+
+	TEST_ASSERT_EQUAL(2, Window_.Retransmit(1000, 30000, false, Send));
+	TEST_ASSERT_EQUAL(2, static_cast<int>(Sent_.size()));
+	TEST_ASSERT_EQUAL_UINT16(1, Sent_[0].PacketId);
+	TEST_ASSERT_EQUAL_STRING("a", Sent_[0].Payload.c_str());
+	TEST_ASSERT_EQUAL_UINT16(3, Sent_[1].PacketId);
+	TEST_ASSERT_EQUAL_STRING("c", Sent_[1].Payload.c_str());
+	TEST_ASSERT_EQUAL_UINT32(2, Window_.GetStats().Retransmitted);
+	TEST_ASSERT_EQUAL(2, Window_.GetCount());
+}
+
+// 送れなくなったらそこで止め、残りは次に送り直す
+static void test_retransmit_stops_on_failure()
+{
+	Window_.Init(4, 4096);
+	Add("a", 0);
+	Add("b", 0);
+	Add("c", 0);
+
+	SendLimit_ = 1;
+	TEST_ASSERT_EQUAL(1, Window_.Retransmit(20000, 30000, false, Send));
+	TEST_ASSERT_EQUAL_UINT32(1, Window_.GetStats().Retransmitted);
+
+	SendLimit_ = 100;
+	Sent_.clear();
+	TEST_ASSERT_EQUAL(2, Window_.Retransmit(30000, 30000, true, Send));	// 20000に送り直したaはまだ待つ
+	TEST_ASSERT_EQUAL_STRING("b", Sent_[0].Payload.c_str());
+	TEST_ASSERT_EQUAL_STRING("c", Sent_[1].Payload.c_str());
+}
+
+// 接続中はPUBACKが遅れているものだけ送り直す
+static void test_retransmit_timeout_only()
+{
+	Window_.Init(4, 4096);
+	Add("a", 0);
+	Add("b", 20000);
+
+	TEST_ASSERT_EQUAL(0, Window_.Retransmit(29999, 30000, true, Send));
+	TEST_ASSERT_EQUAL(1, Window_.Retransmit(30000, 30000, true, Send));
+	TEST_ASSERT_EQUAL_STRING("a", Sent_[0].Payload.c_str());
+	TEST_ASSERT_EQUAL(1, Window_.Retransmit(50000, 30000, true, Send));
+	TEST_ASSERT_EQUAL_STRING("b", Sent_[1].Payload.c_str());
+	TEST_ASSERT_EQUAL(0, Window_.Retransmit(59999, 30000, true, Send));	// aは30000に送り直した
+}
+
+// 遅延は最初に送った時刻から測る
+static void test_ack_counters()
+{
+	Window_.Init(4, 4096);
+	Add("a", 1000);
+	Add("b", 2000);
+	Window_.Retransmit(40000, 30000, true, Send);
+
+	TEST_ASSERT_FALSE(Window_.Ack(99, 41000));
+	TEST_ASSERT_TRUE(Window_.Ack(1, 41000));
+	TEST_ASSERT_FALSE(Window_.Ack(1, 41000));
+	TEST_ASSERT_TRUE(Window_.Ack(2, 2500));
+
+	const PublishWindowStats& stats = Window_.GetStats();
+	TEST_ASSERT_EQUAL_UINT32(2, stats.Published);
+	TEST_ASSERT_EQUAL_UINT32(2, stats.Acked);
+	TEST_ASSERT_EQUAL_UINT32(2, stats.Retransmitted);
+	TEST_ASSERT_EQUAL_UINT32(40000 + 500, stats.LatencySum);
+	TEST_ASSERT_EQUAL_UINT32(40000, stats.LatencyMax);
+
+	Window_.ResetStats();
+	TEST_ASSERT_EQUAL_UINT32(0, Window_.GetStats().Acked);
+}
+
+// パケットIDは0を飛ばして一周する
+static void test_packet_id_wraps()
+{
+	Window_.Init(1, 4096);
+	for (uint32_t id = 1; id <= 0xffff; ++id)
+	{
+		TEST_ASSERT_EQUAL_UINT16(id, Add("x", 0));
+		Window_.Ack(static_cast<uint16_t>(id), 0);
+	}
+	TEST_ASSERT_EQUAL_UINT16(1, Add("x", 0));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_window_limit);
+	RUN_TEST(test_shared_buffer_frees_in_order);
+	RUN_TEST(test_shared_buffer_wraps);
+	RUN_TEST(test_too_large);
+	RUN_TEST(test_retransmit_on_reconnect);
+	RUN_TEST(test_retransmit_stops_on_failure);
+	RUN_TEST(test_retransmit_timeout_only);
+	RUN_TEST(test_ack_counters);
+	RUN_TEST(test_packet_id_wraps);
+	return UNITY_END();
+}
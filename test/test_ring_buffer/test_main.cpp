@@ -0,0 +1,253 @@
+#include <unity.h>
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <numeric>
+#include "Helper/RingBuffer.h"
+
+// ヒープ確保の回数を数える
+static unsigned long AllocCount_ = 0;
+
+void* operator new(size_t size)
+{
+	++AllocCount_;
+	void* p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+// 置き換える前の実装(ベンチマークの比較用)
+template<class T>
+class DequeLimitSize : public std::deque<T>
+{
+private:
+	size_t limitSize_;
+
+public:
+	DequeLimitSize(size_t limitSize) :
+		std::deque<T>(),
+		limitSize_{ limitSize }
+	{
+	}
+
+	void push_back(const T& x)
+	{
+		while (std::deque<T>::size() >= limitSize_) std::deque<T>::pop_front();
+		std::deque<T>::push_back(x);
+	}
+
+	T average() const
+	{
+		if (std::deque<T>::size() <= 0) return T();
+		return std::accumulate(std::deque<T>::begin(), std::deque<T>::end(), T()) / std::deque<T>::size();
+	}
+
+};
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_push_and_index()
+{
+	RingBuffer<int, 4> buf;
+	TEST_ASSERT_TRUE(buf.empty());
+
+	for (int i = 1; i <= 6; ++i) buf.push_back(i);
+
+	TEST_ASSERT_EQUAL(4, buf.size());
+	TEST_ASSERT_EQUAL(3, buf.front());
+	TEST_ASSERT_EQUAL(6, buf.back());
+	for (size_t i = 0; i < buf.size(); ++i) TEST_ASSERT_EQUAL(static_cast<int>(i) + 3, buf[i]);
+}
+
+static void test_running_stats_match_recomputation()
+{
+	RingBuffer<int, 16> buf;
+	std::deque<int> ref;
+
+	std::srand(1);
+	for (int i = 0; i < 1000; ++i)
+	{
+		const int x = std::rand() % 2000 - 1000;
+		buf.push_back(x);
+		ref.push_back(x);
+		if (ref.size() > 16) ref.pop_front();
+
+		int sum = 0;
+		int min = ref.front();
+		int max = ref.front();
+		for (int v : ref)
+		{
+			sum += v;
+			if (v < min) min = v;
+			if (v > max) max = v;
+		}
+		TEST_ASSERT_EQUAL(sum, buf.sum());
+		TEST_ASSERT_EQUAL(sum / static_cast<int>(ref.size()), buf.average());
+		TEST_ASSERT_EQUAL(min, buf.min());
+		TEST_ASSERT_EQUAL(max, buf.max());
+	}
+}
+
+static void test_float_sum_does_not_drift()
+{
+	RingBuffer<float, 5> buf;
+	for (int i = 0; i < 100000; ++i) buf.push_back(20.0f + (i % 7) * 0.1f);
+
+	double sum = 0;
+	for (size_t i = 0; i < buf.size(); ++i) sum += buf[i];
+	TEST_ASSERT_FLOAT_WITHIN(1e-4, sum / buf.size(), buf.average());
+}
+
+static void test_setlimitsize_drops_oldest()
+{
+	RingBuffer<int, 8> buf;
+	for (int i = 1; i <= 8; ++i) buf.push_back(i);
+
+	buf.setlimitsize(3);
+	TEST_ASSERT_EQUAL(3, buf.limitsize());
+	TEST_ASSERT_EQUAL(3, buf.size());
+	TEST_ASSERT_EQUAL(6, buf.front());
+	TEST_ASSERT_EQUAL(7, buf.average());
+	TEST_ASSERT_EQUAL(6, buf.min());
+
+	buf.push_back(100);
+	TEST_ASSERT_EQUAL(3, buf.size());
+	TEST_ASSERT_EQUAL(7, buf.front());
+
+	buf.setlimitsize(0);
+	TEST_ASSERT_EQUAL(1, buf.limitsize());
+	buf.setlimitsize(100);
+	TEST_ASSERT_EQUAL(8, buf.limitsize());
+}
+
+static void test_null_values_are_skipped()
+{
+	RingBuffer<int, 4> co2;
+	co2.push_back(INT_MIN);
+	TEST_ASSERT_EQUAL(1, co2.size());
+	TEST_ASSERT_EQUAL(0, co2.count());
+	TEST_ASSERT_EQUAL(INT_MIN, co2.min());
+	TEST_ASSERT_EQUAL(INT_MIN, co2.average());
+
+	co2.push_back(500);
+	co2.push_back(INT_MIN);
+	co2.push_back(700);
+	TEST_ASSERT_EQUAL(2, co2.count());
+	TEST_ASSERT_EQUAL(1200, co2.sum());
+	TEST_ASSERT_EQUAL(600, co2.average());
+	TEST_ASSERT_EQUAL(500, co2.min());
+	TEST_ASSERT_EQUAL(700, co2.max());
+
+	RingBuffer<float, 3> wbgt;
+	wbgt.push_back(NAN);
+	wbgt.push_back(25.0f);
+	for (int i = 0; i < 10; ++i) wbgt.push_back(i % 2 == 0 ? NAN : 27.0f);
+	TEST_ASSERT_FALSE(std::isnan(wbgt.sum()));
+	TEST_ASSERT_EQUAL_FLOAT(27.0f, wbgt.average());
+	TEST_ASSERT_EQUAL_FLOAT(27.0f, wbgt.max());
+}
+
+static void test_clear()
+{
+	RingBuffer<int, 4> buf;
+	buf.push_back(1);
+	buf.push_back(2);
+	buf.clear();
+
+	TEST_ASSERT_TRUE(buf.empty());
+	TEST_ASSERT_EQUAL(0, buf.count());
+	buf.push_back(9);
+	TEST_ASSERT_EQUAL(9, buf.min());
+	TEST_ASSERT_EQUAL(9, buf.max());
+}
+
+static void test_push_does_not_allocate()
+{
+	RingBuffer<float, 240> ring;
+	DequeLimitSize<float> deque(240);
+
+	const unsigned long ringStart = AllocCount_;
+	for (int i = 0; i < 10000; ++i) ring.push_back(static_cast<float>(i));
+	const unsigned long ringAllocs = AllocCount_ - ringStart;
+
+	const unsigned long dequeStart = AllocCount_;
+	for (int i = 0; i < 10000; ++i) deque.push_back(static_cast<float>(i));
+	const unsigned long dequeAllocs = AllocCount_ - dequeStart;
+
+	char message[80];
+	snprintf(message, sizeof(message), "allocations per 10000 pushes: ring %lu, deque %lu", ringAllocs, dequeAllocs);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_EQUAL(0, ringAllocs);
+}
+
+// 測定値の追加と平均の取得を1回とした時間
+template<class TBuffer>
+static double BenchmarkPushAverage(TBuffer& buf, int count)
+{
+	volatile float sink = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+	{
+		buf.push_back(static_cast<float>(i % 1000) * 0.1f);
+		sink = sink + buf.average();
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+static void test_benchmark_against_deque()
+{
+	constexpr int COUNT = 200000;
+
+	RingBuffer<float, 5> ring5;
+	DequeLimitSize<float> deque5(5);
+	RingBuffer<float, 240> ring240;
+	DequeLimitSize<float> deque240(240);
+
+	const double ring5Time = BenchmarkPushAverage(ring5, COUNT);
+	const double deque5Time = BenchmarkPushAverage(deque5, COUNT);
+	const double ring240Time = BenchmarkPushAverage(ring240, COUNT);
+	const double deque240Time = BenchmarkPushAverage(deque240, COUNT);
+
+	char message[120];
+	snprintf(message, sizeof(message), "push+average window 5: ring %.1f ns, deque %.1f ns", ring5Time, deque5Time);
+	TEST_MESSAGE(message);
+	snprintf(message, sizeof(message), "push+average window 240: ring %.1f ns, deque %.1f ns", ring240Time, deque240Time);
+	TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_push_and_index);
+	RUN_TEST(test_running_stats_match_recomputation);
+	RUN_TEST(test_float_sum_does_not_drift);
+	RUN_TEST(test_setlimitsize_drops_oldest);
+	RUN_TEST(test_null_values_are_skipped);
+	RUN_TEST(test_clear);
+	RUN_TEST(test_push_does_not_allocate);
+	RUN_TEST(test_benchmark_against_deque);
+	return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include <unity.h>
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include "Helper/RunningStats.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_empty()
+{
+	RunningStats<float> stats;
+	TEST_ASSERT_EQUAL(0, stats.count());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.mean());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.variance());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.stddev());
+}
+
+static void test_known_values()
+{
+	RunningStats<int> stats;
+	const int values[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+	for (int x : values) stats.push_back(x);
+
+	TEST_ASSERT_EQUAL(8, stats.count());
+	TEST_ASSERT_EQUAL(2, stats.min());
+	TEST_ASSERT_EQUAL(9, stats.max());
+	TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.mean());
+	TEST_ASSERT_EQUAL_FLOAT(4.0f, stats.variance());
+	TEST_ASSERT_EQUAL_FLOAT(2.0f, stats.stddev());
+}
+
+static void test_single_and_negative_values()
+{
+	RunningStats<float> stats;
+	stats.push_back(-3.5f);
+	TEST_ASSERT_EQUAL_FLOAT(-3.5f, stats.min());
+	TEST_ASSERT_EQUAL_FLOAT(-3.5f, stats.max());
+	TEST_ASSERT_EQUAL_FLOAT(-3.5f, stats.mean());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.stddev());
+
+	stats.push_back(-1.5f);
+	TEST_ASSERT_EQUAL_FLOAT(-3.5f, stats.min());
+	TEST_ASSERT_EQUAL_FLOAT(-1.5f, stats.max());
+	TEST_ASSERT_EQUAL_FLOAT(-2.5f, stats.mean());
+	TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.stddev());
+}
+
+// 大きな値に小さな変動が乗っても桁落ちしない(CO2の1時間分を想定)
+static void test_large_offset_is_stable()
+{
+	RunningStats<int> stats;
+	double sum = 0;
+	double sum2 = 0;
+	std::srand(1);
+	for (int i = 0; i < 1800; ++i)
+	{
+		const int x = 5000 + std::rand() % 21 - 10;
+		stats.push_back(x);
+		sum += x;
+		sum2 += static_cast<double>(x) * x;
+	}
+	const double mean = sum / 1800;
+	const double variance = sum2 / 1800 - mean * mean;
+
+	TEST_ASSERT_FLOAT_WITHIN(0.01, mean, stats.mean());
+	TEST_ASSERT_FLOAT_WITHIN(0.05, std::sqrt(variance), stats.stddev());
+}
+
+static void test_clear()
+{
+	RunningStats<int> stats;
+	stats.push_back(100);
+	stats.push_back(200);
+	stats.clear();
+
+	TEST_ASSERT_EQUAL(0, stats.count());
+	stats.push_back(7);
+	TEST_ASSERT_EQUAL(7, stats.min());
+	TEST_ASSERT_EQUAL(7, stats.max());
+	TEST_ASSERT_EQUAL_FLOAT(7.0f, stats.mean());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.variance());
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_known_values);
+	RUN_TEST(test_single_and_negative_values);
+	RUN_TEST(test_large_offset_is_stable);
+	RUN_TEST(test_clear);
+	return UNITY_END();
+}
@@ -0,0 +1,193 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <climits>
+#include "Helper/Scheduler.h"
+
+static int CountA_;
+static int CountB_;
+static unsigned long WorkMs_;		// タスクの処理時間として進める時刻[msec.]
+static char Order_[16];
+static int OrderLength_;
+
+static void TaskA()
+{
+	++CountA_;
+	NativeAdvance(WorkMs_);
+	if (OrderLength_ < static_cast<int>(sizeof(Order_)) - 1) Order_[OrderLength_++] = 'A';
+	Order_[OrderLength_] = '\0';
+}
+
+static void TaskB()
+{
+	++CountB_;
+	if (OrderLength_ < static_cast<int>(sizeof(Order_)) - 1) Order_[OrderLength_++] = 'B';
+	Order_[OrderLength_] = '\0';
+}
+
+// msだけ経つまで、1msずつ進めながらDoWork()を呼ぶ
+static void RunFor(Scheduler& scheduler, unsigned long ms)
+{
+	const unsigned long end = millis() + ms;
+	while (static_cast<long>(millis() - end) < 0)
+	{
+		scheduler.DoWork();
+		NativeAdvance(1);
+	}
+}
+
+void setUp()
+{
+	NativeMillis() = 1000;
+	CountA_ = 0;
+	CountB_ = 0;
+	WorkMs_ = 0;
+	OrderLength_ = 0;
+	Order_[0] = '\0';
+}
+
+void tearDown()
+{
+}
+
+static void test_periodic_runs_once_per_period()
+{
+	Scheduler scheduler;
+	scheduler.AddPeriodic("a", TaskA, 100);
+
+	RunFor(scheduler, 1000);
+	TEST_ASSERT_EQUAL(10, CountA_);
+}
+
+// 処理時間があっても絶対時刻で期限を決めるので回数がずれない
+static void test_periodic_does_not_drift()
+{
+	Scheduler scheduler;
+	const int id = scheduler.AddPeriodic("a", TaskA, 100);
+	WorkMs_ = 30;
+
+	RunFor(scheduler, 10000);
+	TEST_ASSERT_INT_WITHIN(1, 100, CountA_);
+	TEST_ASSERT_EQUAL(0, scheduler.GetStats(id).OverrunCount);
+}
+
+static void test_delay_before_first_run()
+{
+	Scheduler scheduler;
+	scheduler.AddPeriodic("a", TaskA, 100, 250);
+
+	RunFor(scheduler, 250);
+	TEST_ASSERT_EQUAL(0, CountA_);
+	RunFor(scheduler, 1);
+	TEST_ASSERT_EQUAL(1, CountA_);
+}
+
+static void test_overrun_skips_missed_periods()
+{
+	Scheduler scheduler;
+	const int id = scheduler.AddPeriodic("a", TaskA, 100);
+
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL(1, CountA_);
+
+	// 350ms止まったら1回だけ実行し、取りこぼした2周期分は飛ばす
+	NativeAdvance(350);
+	scheduler.DoWork();
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL(2, CountA_);
+	TEST_ASSERT_EQUAL(2, scheduler.GetStats(id).OverrunCount);
+	TEST_ASSERT_EQUAL(250, scheduler.GetStats(id).LatencyMax);
+
+	// 元の位相のまま続く
+	NativeAdvance(49);
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL(2, CountA_);
+	NativeAdvance(1);
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL(3, CountA_);
+}
+
+static void test_one_shot_schedule_and_cancel()
+{
+	Scheduler scheduler;
+	const int id = scheduler.AddOneShot("b", TaskB);
+
+	RunFor(scheduler, 100);
+	TEST_ASSERT_EQUAL(0, CountB_);
+	TEST_ASSERT_FALSE(scheduler.IsScheduled(id));
+
+	scheduler.Schedule(id, 50);
+	TEST_ASSERT_TRUE(scheduler.IsScheduled(id));
+	RunFor(scheduler, 100);
+	TEST_ASSERT_EQUAL(1, CountB_);
+	TEST_ASSERT_FALSE(scheduler.IsScheduled(id));
+
+	scheduler.Schedule(id, 50);
+	scheduler.Cancel(id);
+	RunFor(scheduler, 100);
+	TEST_ASSERT_EQUAL(1, CountB_);
+}
+
+static void test_set_period_keeps_phase_from_last_run()
+{
+	Scheduler scheduler;
+	const int id = scheduler.AddPeriodic("a", TaskA, 1000);
+
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL(1, CountA_);
+
+	scheduler.SetPeriod(id, 200);
+	RunFor(scheduler, 200);
+	TEST_ASSERT_EQUAL(1, CountA_);
+	RunFor(scheduler, 1);
+	TEST_ASSERT_EQUAL(2, CountA_);
+
+	// ワンショットや0は変更しない
+	scheduler.SetPeriod(id, 0);
+	RunFor(scheduler, 200);
+	TEST_ASSERT_EQUAL(3, CountA_);
+}
+
+static void test_runs_in_registration_order()
+{
+	Scheduler scheduler;
+	scheduler.AddPeriodic("b", TaskB, 100);
+	scheduler.AddPeriodic("a", TaskA, 100);
+
+	scheduler.DoWork();
+	TEST_ASSERT_EQUAL_STRING("BA", Order_);
+}
+
+static void test_millis_wraparound()
+{
+	Scheduler scheduler;
+	NativeMillis() = ULONG_MAX - 150;
+	scheduler.AddPeriodic("a", TaskA, 100);
+
+	RunFor(scheduler, 1000);
+	TEST_ASSERT_EQUAL(10, CountA_);
+}
+
+static void test_task_limit()
+{
+	Scheduler scheduler;
+	for (int i = 0; i < SCHEDULER_TASK_MAX; ++i) TEST_ASSERT_EQUAL(i, scheduler.AddPeriodic("a", TaskA, 100));
+
+	TEST_ASSERT_EQUAL(-1, scheduler.AddPeriodic("a", TaskA, 100));
+	TEST_ASSERT_EQUAL(-1, scheduler.AddOneShot("b", TaskB));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_periodic_runs_once_per_period);
+	RUN_TEST(test_periodic_does_not_drift);
+	RUN_TEST(test_delay_before_first_run);
+	RUN_TEST(test_overrun_skips_missed_periods);
+	RUN_TEST(test_one_shot_schedule_and_cancel);
+	RUN_TEST(test_set_period_keeps_phase_from_last_run);
+	RUN_TEST(test_runs_in_registration_order);
+	RUN_TEST(test_millis_wraparound);
+	RUN_TEST(test_task_limit);
+	return UNITY_END();
+}
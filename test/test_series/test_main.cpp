@@ -0,0 +1,131 @@
+#include <unity.h>
+
+#include <cmath>
+#include "Config.h"
+#include "Series.h"
+#include "Helper/Nullable.h"
+#include "MeasureStub.h"
+
+static int Tick_;
+
+// 15秒毎の測定値をcount点入れる
+static void Feed(int co2, float wbgt, int count)
+{
+	MeasureStubSetAverage(co2, 0, 0, wbgt);
+	for (int i = 0; i < count; ++i)
+	{
+		Tick_ += CO2_SERIES_INVERVAL;
+		SeriesUpdate(Tick_);
+	}
+}
+
+void setUp()
+{
+	Tick_ = 0;
+	SeriesInit();
+}
+
+void tearDown()
+{
+}
+
+static void test_query_raw_window()
+{
+	for (int i = 0; i < 10; ++i) Feed(400 + i, 20, 1);
+
+	SeriesPoint points[8];
+	TEST_ASSERT_EQUAL(3, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 45, 0, points, 8));
+	TEST_ASSERT_EQUAL_FLOAT(407, points[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(409, points[2].Average);
+	TEST_ASSERT_EQUAL(1, points[2].Count);
+
+	// 2点前まで
+	TEST_ASSERT_EQUAL(2, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 30, 30, points, 8));
+	TEST_ASSERT_EQUAL_FLOAT(406, points[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(407, points[1].Average);
+
+	// outSizeを越える分は古い方を捨てる
+	TEST_ASSERT_EQUAL(2, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 45, 0, points, 2));
+	TEST_ASSERT_EQUAL_FLOAT(408, points[0].Average);
+}
+
+// 溜まっていない古い側は返さない
+static void test_query_beyond_history()
+{
+	Feed(500, 20, 3);
+
+	SeriesPoint points[8];
+	TEST_ASSERT_EQUAL(3, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 120, 0, points, 8));
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 120, 30, points, 8));
+	TEST_ASSERT_EQUAL(0, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 120, 45, points, 8));
+	TEST_ASSERT_EQUAL(0, SeriesQuery(SeriesKind::CO2, SeriesResolution::MIN5, 3600, 0, points, 8));
+}
+
+static void test_query_null()
+{
+	Feed(NullableNullValue<int>(), NAN, 1);
+
+	SeriesPoint point;
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::WBGT, SeriesResolution::RAW, 15, 0, &point, 1));
+	TEST_ASSERT_EQUAL(0, point.Count);
+	TEST_ASSERT_TRUE(std::isnan(point.Average));
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::CO2, SeriesResolution::RAW, 15, 0, &point, 1));
+	TEST_ASSERT_EQUAL(0, point.Count);
+}
+
+// 1時間の平均は5分毎の平均の平均ではなく、全測定値の平均
+static void test_cascade_weights_by_readings()
+{
+	Feed(2000, 30, 1);
+	Feed(NullableNullValue<int>(), NAN, 19);
+	Feed(500, 20, 11 * 20);
+
+	SeriesPoint points[12];
+	TEST_ASSERT_EQUAL(12, SeriesQuery(SeriesKind::CO2, SeriesResolution::MIN5, 3600, 0, points, 12));
+	TEST_ASSERT_EQUAL_FLOAT(2000, points[0].Average);
+	TEST_ASSERT_EQUAL(1, points[0].Count);
+	TEST_ASSERT_EQUAL(20, points[1].Count);
+
+	SeriesPoint hour;
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::CO2, SeriesResolution::HOUR1, 3600, 0, &hour, 1));
+	TEST_ASSERT_EQUAL_FLOAT(507, hour.Average);		// (2000 + 500 * 220) / 221
+	TEST_ASSERT_EQUAL_FLOAT(500, hour.Min);
+	TEST_ASSERT_EQUAL_FLOAT(2000, hour.Max);
+	TEST_ASSERT_EQUAL(221, hour.Count);
+
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::WBGT, SeriesResolution::HOUR1, 3600, 0, &hour, 1));
+	TEST_ASSERT_FLOAT_WITHIN(.05f, (30 + 20 * 220) / 221.f, hour.Average);
+}
+
+// 1日分入れると5分の層は容量の分だけ残り、1時間と1日の層に繰り上がる
+static void test_cascade_day()
+{
+	for (int h = 0; h < 24; ++h) Feed(400 + h * 10, 20 + h * .1f, 12 * 20);
+
+	SeriesPoint points[SERIES_MIN5_NUMBER + 1];
+	TEST_ASSERT_EQUAL(SERIES_MIN5_NUMBER, SeriesQuery(SeriesKind::CO2, SeriesResolution::MIN5, 24 * 3600, 0, points, SERIES_MIN5_NUMBER + 1));
+	TEST_ASSERT_EQUAL_FLOAT(630, points[SERIES_MIN5_NUMBER - 1].Average);
+
+	TEST_ASSERT_EQUAL(24, SeriesQuery(SeriesKind::CO2, SeriesResolution::HOUR1, 24 * 3600, 0, points, 24));
+	TEST_ASSERT_EQUAL_FLOAT(400, points[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(630, points[23].Average);
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::WBGT, SeriesResolution::HOUR1, 3600, 0, points, 1));
+	TEST_ASSERT_FLOAT_WITHIN(.05f, 22.3f, points[0].Average);
+
+	TEST_ASSERT_EQUAL(1, SeriesQuery(SeriesKind::CO2, SeriesResolution::DAY1, 7 * 24 * 3600, 0, points, 7));
+	TEST_ASSERT_EQUAL_FLOAT(400, points[0].Min);
+	TEST_ASSERT_EQUAL_FLOAT(515, points[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(630, points[0].Max);
+	TEST_ASSERT_EQUAL(24 * 12 * 20, points[0].Count);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_query_raw_window);
+	RUN_TEST(test_query_beyond_history);
+	RUN_TEST(test_query_null);
+	RUN_TEST(test_cascade_weights_by_readings);
+	RUN_TEST(test_cascade_day);
+	return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <unity.h>
+
+#include <climits>
+#include <cmath>
+#include "Helper/SeriesTier.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static SeriesPoint Raw(float value)
+{
+	return std::isnan(value) ? SeriesPoint{ NAN, NAN, NAN, 0 } : SeriesPoint{ value, value, value, 1 };
+}
+
+static void test_aggregates_ratio_points()
+{
+	SeriesTier<8> tier(4);
+	SeriesPoint result;
+
+	TEST_ASSERT_FALSE(tier.Add(Raw(400), &result));
+	TEST_ASSERT_FALSE(tier.Add(Raw(800), &result));
+	TEST_ASSERT_FALSE(tier.Add(Raw(500), &result));
+	TEST_ASSERT_EQUAL(0, tier.size());
+	TEST_ASSERT_TRUE(tier.Add(Raw(601), &result));
+
+	TEST_ASSERT_EQUAL(1, tier.size());
+	TEST_ASSERT_EQUAL_FLOAT(400, result.Min);
+	TEST_ASSERT_EQUAL_FLOAT(575.25f, result.Average);
+	TEST_ASSERT_EQUAL_FLOAT(800, result.Max);
+	TEST_ASSERT_EQUAL(4, result.Count);
+	TEST_ASSERT_EQUAL_FLOAT(575, tier[0].Average);		// 保持するのは四捨五入した値
+	TEST_ASSERT_EQUAL(4, tier[0].Count);
+}
+
+static void test_scale_rounds_half_up()
+{
+	SeriesTier<4> tier(2);
+	SeriesTier<4> scaled(2, 10);
+
+	tier.Add(Raw(1), nullptr);
+	tier.Add(Raw(2), nullptr);
+	TEST_ASSERT_EQUAL_FLOAT(2, tier[0].Average);
+
+	scaled.Add(Raw(25.02f), nullptr);
+	scaled.Add(Raw(25.12f), nullptr);
+	TEST_ASSERT_EQUAL_FLOAT(25.0f, scaled[0].Min);
+	TEST_ASSERT_EQUAL_FLOAT(25.1f, scaled[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(25.1f, scaled[0].Max);
+}
+
+// 下位層の点は、元になった測定値の数で重み付けして平均する
+static void test_average_is_weighted_by_count()
+{
+	SeriesTier<4> tier(2);
+	SeriesPoint result;
+
+	tier.Add(SeriesPoint{ 400, 400, 400, 1 }, &result);
+	TEST_ASSERT_TRUE(tier.Add(SeriesPoint{ 700, 1000, 1300, 3 }, &result));
+	TEST_ASSERT_EQUAL_FLOAT(850, result.Average);		// (400 + 1000 * 3) / 4
+	TEST_ASSERT_EQUAL(4, result.Count);
+}
+
+static void test_null_points_are_skipped()
+{
+	SeriesTier<4> tier(3);
+	SeriesPoint result;
+
+	tier.Add(Raw(NAN), &result);
+	tier.Add(Raw(20.0f), &result);
+	TEST_ASSERT_TRUE(tier.Add(Raw(22.0f), &result));
+	TEST_ASSERT_EQUAL_FLOAT(21.0f, result.Average);
+	TEST_ASSERT_EQUAL_FLOAT(20.0f, result.Min);
+	TEST_ASSERT_EQUAL_FLOAT(22.0f, result.Max);
+
+	// すべて欠測なら欠測の点
+	tier.Add(Raw(NAN), &result);
+	tier.Add(Raw(NAN), &result);
+	TEST_ASSERT_TRUE(tier.Add(Raw(NAN), &result));
+	TEST_ASSERT_TRUE(std::isnan(result.Average));
+	TEST_ASSERT_TRUE(std::isnan(result.Min));
+	TEST_ASSERT_EQUAL(0, result.Count);
+	TEST_ASSERT_EQUAL(2, tier.size());
+	TEST_ASSERT_TRUE(std::isnan(tier[1].Average));
+}
+
+static void test_wraps_and_keeps_newest()
+{
+	SeriesTier<3> tier(1);
+	for (int i = 1; i <= 5; ++i) tier.Add(Raw(i * 100), nullptr);
+
+	TEST_ASSERT_EQUAL(3, tier.size());
+	TEST_ASSERT_EQUAL_FLOAT(300, tier[0].Average);
+	TEST_ASSERT_EQUAL_FLOAT(400, tier[1].Average);
+	TEST_ASSERT_EQUAL_FLOAT(500, tier[2].Average);
+}
+
+// 15秒 → 5分 → 1時間と重ねたとき、上位層は下位層の最小/平均/最大を保つ
+static void test_tiers_cascade()
+{
+	SeriesTier<240> minute5(20);
+	SeriesTier<168> hour(12);
+
+	int min = INT_MAX;
+	int max = INT_MIN;
+	long sum = 0;
+	for (int i = 0; i < 20 * 12; ++i)
+	{
+		const int co2 = 400 + (i * 37) % 600;
+		if (co2 < min) min = co2;
+		if (co2 > max) max = co2;
+		sum += co2;
+
+		SeriesPoint point;
+		if (minute5.Add(Raw(co2), &point)) hour.Add(point, nullptr);
+	}
+
+	TEST_ASSERT_EQUAL(12, minute5.size());
+	TEST_ASSERT_EQUAL(1, hour.size());
+	TEST_ASSERT_EQUAL_FLOAT(min, hour[0].Min);
+	TEST_ASSERT_EQUAL_FLOAT(max, hour[0].Max);
+	TEST_ASSERT_FLOAT_WITHIN(.5f, static_cast<float>(sum) / (20 * 12), hour[0].Average);
+	TEST_ASSERT_EQUAL(20 * 12, hour[0].Count);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_aggregates_ratio_points);
+	RUN_TEST(test_scale_rounds_half_up);
+	RUN_TEST(test_average_is_weighted_by_count);
+	RUN_TEST(test_null_points_are_skipped);
+	RUN_TEST(test_wraps_and_keeps_newest);
+	RUN_TEST(test_tiers_cascade);
+	return UNITY_END();
+}
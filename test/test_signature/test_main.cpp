@@ -0,0 +1,182 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Network/Signature.h"
+
+// mallinfo2()はglibc 2.33以降
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#define HEAP_IN_USE_AVAILABLE
+#include <malloc.h>
+#endif
+
+// RFC 4231 Test Case 2
+static const char RFC4231_KEY[] = "SmVmZQ==";	// "Jefe"
+static const char RFC4231_DATA[] = "what do ya want for nothing?";
+static const char RFC4231_HMAC[] = "W9zBRr9gdU5qBCQmCJV1x1oAPwidJzmDnexYuWTsOEM=";
+
+// IoT HubのSASトークンと同じ形の署名対象
+static const char DEVICE_KEY[] = "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8=";
+static const char DEVICE_DATA[] = "example.azure-devices.net%2Fdevices%2Fwio-terminal-01\n1700003600";
+static const char DEVICE_HMAC[] = "eUzXA5VZjQBgyWAmWHxc4Jt4JVFThcYR8euQ8iFwkLs=";
+
+static std::vector<uint8_t> Bytes(const char* str)
+{
+	return std::vector<uint8_t>(str, str + strlen(str));
+}
+
+static int Sign(SasSigner& signer, const char* data, std::string* signature)
+{
+	return signer.Sign(reinterpret_cast<const uint8_t*>(data), strlen(data), signature);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_known_vectors()
+{
+	SasSigner signer;
+	std::string signature;
+
+	TEST_ASSERT_EQUAL(0, signer.SetKey(RFC4231_KEY));
+	TEST_ASSERT_EQUAL(0, Sign(signer, RFC4231_DATA, &signature));
+	TEST_ASSERT_EQUAL_STRING(RFC4231_HMAC, signature.c_str());
+
+	TEST_ASSERT_EQUAL(0, signer.SetKey(DEVICE_KEY));
+	TEST_ASSERT_EQUAL(0, Sign(signer, DEVICE_DATA, &signature));
+	TEST_ASSERT_EQUAL_STRING(DEVICE_HMAC, signature.c_str());
+}
+
+// 使い回しても前の署名の状態が残らない
+static void test_context_is_reused()
+{
+	SasSigner signer;
+	std::string signature;
+	TEST_ASSERT_EQUAL(0, signer.SetKey(DEVICE_KEY));
+
+	for (int i = 0; i < 3; ++i)
+	{
+		TEST_ASSERT_EQUAL(0, Sign(signer, RFC4231_DATA, &signature));
+		TEST_ASSERT_EQUAL(0, Sign(signer, DEVICE_DATA, &signature));
+		TEST_ASSERT_EQUAL_STRING(DEVICE_HMAC, signature.c_str());
+	}
+
+	// 同じ鍵なら作り直さない、違う鍵なら切り替わる
+	TEST_ASSERT_EQUAL(0, signer.SetKey(DEVICE_KEY));
+	TEST_ASSERT_EQUAL(0, Sign(signer, DEVICE_DATA, &signature));
+	TEST_ASSERT_EQUAL_STRING(DEVICE_HMAC, signature.c_str());
+	TEST_ASSERT_EQUAL(0, signer.SetKey(RFC4231_KEY));
+	TEST_ASSERT_EQUAL(0, Sign(signer, RFC4231_DATA, &signature));
+	TEST_ASSERT_EQUAL_STRING(RFC4231_HMAC, signature.c_str());
+}
+
+static void test_invalid_key()
+{
+	SasSigner signer;
+	std::string signature;
+	TEST_ASSERT_EQUAL(-1, Sign(signer, DEVICE_DATA, &signature));
+	TEST_ASSERT_EQUAL(-1, signer.SetKey(""));
+	TEST_ASSERT_EQUAL(-1, signer.SetKey("not base64!"));
+	TEST_ASSERT_EQUAL(-1, Sign(signer, DEVICE_DATA, &signature));
+
+	// 失敗したら前の鍵も使えない
+	TEST_ASSERT_EQUAL(0, signer.SetKey(DEVICE_KEY));
+	TEST_ASSERT_EQUAL(-1, signer.SetKey("not base64!"));
+	TEST_ASSERT_EQUAL(-1, Sign(signer, DEVICE_DATA, &signature));
+
+	signer.SetKey(DEVICE_KEY);
+	signer.Clear();
+	TEST_ASSERT_EQUAL(-1, Sign(signer, DEVICE_DATA, &signature));
+}
+
+static void test_free_functions()
+{
+	TEST_ASSERT_EQUAL_STRING(DEVICE_HMAC, GenerateEncryptedSignature(DEVICE_KEY, Bytes(DEVICE_DATA)).c_str());
+	TEST_ASSERT_EQUAL_STRING(RFC4231_HMAC, GenerateEncryptedSignature(RFC4231_KEY, Bytes(RFC4231_DATA)).c_str());
+	TEST_ASSERT_EQUAL_STRING("", GenerateEncryptedSignature("", Bytes(DEVICE_DATA)).c_str());
+
+	// DPSのグループ登録の鍵はregistrationIdの署名
+	TEST_ASSERT_EQUAL_STRING("3chzun6pxnIZmSGHeEUn8Vhuo7jqTR2vsM/Dx+5p9PQ=", ComputeDerivedSymmetricKey("ZmFrZS1tYXN0ZXIta2V5LWZvci1ob3N0LXRlc3RzLTAxMjM0NTY3ODk=", "wio-terminal-01").c_str());
+}
+
+#if defined(HEAP_IN_USE_AVAILABLE)
+static void SignCycle(int i, std::string* signature)
+{
+	SasSigner signer;
+	signer.SetKey(i % 2 == 0 ? DEVICE_KEY : RFC4231_KEY);
+	Sign(signer, DEVICE_DATA, signature);
+	signer.SetKey(DEVICE_KEY);
+	Sign(signer, DEVICE_DATA, signature);
+	signer.Clear();
+	GenerateEncryptedSignature(i % 2 == 0 ? DEVICE_KEY : RFC4231_KEY, Bytes(DEVICE_DATA));
+}
+#endif
+
+// 鍵の設定と解放、署名を繰り返してもヒープが増えない
+// 1回目の呼び出しで確保されたまま残るもの(使い回す署名器など)は先に済ませておく
+static void test_no_leak()
+{
+#if defined(HEAP_IN_USE_AVAILABLE)
+	std::string signature;
+	signature.reserve(64);
+	SignCycle(0, &signature);
+	SignCycle(1, &signature);
+
+	const size_t before = mallinfo2().uordblks;
+	for (int i = 0; i < 2000; ++i) SignCycle(i, &signature);
+	const size_t after = mallinfo2().uordblks;
+
+	char message[80];
+	snprintf(message, sizeof(message), "heap in use: %zu -> %zu bytes (2000 cycles)", before, after);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_EQUAL(before, after);
+#else
+	TEST_IGNORE_MESSAGE("Needs mallinfo2() (glibc 2.33 or later)");
+#endif
+}
+
+// 署名器を使い回す場合と、毎回鍵から作り直す場合(以前の実装)の比較
+static void test_benchmark_sign()
+{
+	constexpr int COUNT = 10000;
+	std::string signature;
+
+	SasSigner cached;
+	cached.SetKey(DEVICE_KEY);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; ++i) Sign(cached, DEVICE_DATA, &signature);
+	const double cachedTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / COUNT;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; ++i)
+	{
+		SasSigner signer;
+		signer.SetKey(DEVICE_KEY);
+		Sign(signer, DEVICE_DATA, &signature);
+	}
+	const double freshTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / COUNT;
+
+	char message[100];
+	snprintf(message, sizeof(message), "sign: cached %.2f us, from key %.2f us (%d calls)", cachedTime, freshTime, COUNT);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_EQUAL_STRING(DEVICE_HMAC, signature.c_str());
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_known_vectors);
+	RUN_TEST(test_context_is_reused);
+	RUN_TEST(test_invalid_key);
+	RUN_TEST(test_free_functions);
+	RUN_TEST(test_no_leak);
+	RUN_TEST(test_benchmark_sign);
+	return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "Config.h"
+#include "Telemetry.h"
+#include "Helper/Nullable.h"
+
+static char Buffer_[TELEMETRY_PAYLOAD_MAX_SIZE];
+
+// 区間の統計付きの典型的なサンプル
+static TelemetrySample Sample(unsigned long time)
+{
+	TelemetrySample sample;
+	sample.Time = time;
+	sample.Co2 = 812;
+	sample.Humi = 45;
+	sample.Temp = 25.4f;
+	sample.Wbgt = 22.3f;
+	sample.Co2Stats = TelemetryStats{ 7, 798.0f, 831.0f, 11.2f };
+	sample.HumiStats = TelemetryStats{ 7, 44.0f, 46.0f, 0.7f };
+	sample.TempStats = TelemetryStats{ 7, 25.2f, 25.6f, 0.13f };
+	sample.WbgtStats = TelemetryStats{ 7, 22.1f, 22.5f, 0.12f };
+	return sample;
+}
+
+static int Serialize(TelemetryEncoding encoding, int count)
+{
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	for (int i = 0; i < count; ++i) samples[i] = Sample(1700000000 + i * 15);
+
+	TelemetrySetEncoding(encoding);
+	TelemetryClear();
+	if (count == 1)
+	{
+		TelemetrySetBatch(1, 0);
+		TelemetryAdd(samples[0]);
+		return TelemetrySerialize(Buffer_, sizeof(Buffer_));
+	}
+	return TelemetrySerializeSamples(samples, count, Buffer_, sizeof(Buffer_));
+}
+
+// 1メッセージの書き出し時間[usec.]
+static double EncodeTime(TelemetryEncoding encoding, int count)
+{
+	constexpr int REPEAT = 2000;
+
+	volatile int sink = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < REPEAT; ++i) sink = sink + Serialize(encoding, count);
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / REPEAT;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+	TelemetrySetEncoding(TelemetryEncoding::JSON);
+	TelemetryClear();
+}
+
+static void test_content_type()
+{
+	TelemetrySetEncoding(TelemetryEncoding::JSON);
+	TEST_ASSERT_EQUAL_STRING("application%2Fjson", TelemetryGetContentType());
+	TEST_ASSERT_EQUAL_STRING("utf-8", TelemetryGetContentEncoding());
+
+	TelemetrySetEncoding(TelemetryEncoding::MSGPACK);
+	TEST_ASSERT_EQUAL_STRING("application%2Fx-msgpack", TelemetryGetContentType());
+	TEST_ASSERT_NULL(TelemetryGetContentEncoding());
+}
+
+// 単一もバッチもサンプルの配列で、各サンプルは位置で項目を表す配列(model/telemetry-payload.md)
+static void test_msgpack_layout()
+{
+	const int single = Serialize(TelemetryEncoding::MSGPACK, 1);
+	TEST_ASSERT_GREATER_THAN(0, single);
+	TEST_ASSERT_EQUAL_UINT8(0x91, static_cast<uint8_t>(Buffer_[0]));	// fixarray(1)
+	TEST_ASSERT_EQUAL_UINT8(0xdc, static_cast<uint8_t>(Buffer_[1]));	// array16
+	TEST_ASSERT_EQUAL_UINT8(18, static_cast<uint8_t>(Buffer_[3]));
+	TEST_ASSERT_EQUAL_UINT8(0xce, static_cast<uint8_t>(Buffer_[4]));	// ts: uint32
+	TEST_ASSERT_EQUAL_UINT8(0x65, static_cast<uint8_t>(Buffer_[5]));	// 1700000000 = 0x6553f100
+	TEST_ASSERT_EQUAL_UINT8(7, static_cast<uint8_t>(Buffer_[9]));		// samples: positive fixint
+	TEST_ASSERT_EQUAL_UINT8(0xcd, static_cast<uint8_t>(Buffer_[10]));	// co2: uint16
+	TEST_ASSERT_EQUAL_UINT8(0x03, static_cast<uint8_t>(Buffer_[11]));	// 812 = 0x032c
+	TEST_ASSERT_EQUAL_UINT8(0x2c, static_cast<uint8_t>(Buffer_[12]));
+	TEST_ASSERT_EQUAL_UINT8(0xca, static_cast<uint8_t>(Buffer_[13]));	// co2Min: float32
+	TEST_ASSERT_EQUAL_UINT8(45, static_cast<uint8_t>(Buffer_[13 + 3 * 5]));	// humi: positive fixint
+	TEST_ASSERT_EQUAL(3 + 1 + 5 + 1 + 3 + 3 * 5 + 1 + 3 * 5 + 2 * 4 * 5, single);
+
+	const int batch = Serialize(TelemetryEncoding::MSGPACK, TELEMETRY_BATCH_MAX);
+	TEST_ASSERT_GREATER_THAN(0, batch);
+	TEST_ASSERT_EQUAL_UINT8(0x90 | TELEMETRY_BATCH_MAX, static_cast<uint8_t>(Buffer_[0]));	// fixarray
+	TEST_ASSERT_EQUAL_UINT8(0xdc, static_cast<uint8_t>(Buffer_[1]));
+	TEST_ASSERT_EQUAL(1 + TELEMETRY_BATCH_MAX * (single - 1), batch);
+}
+
+// 無い値と統計は位置を詰めずにnilにする
+static void test_msgpack_missing_values()
+{
+	TelemetrySample sample = Sample(1700000000);
+	sample.Co2 = NullableNullValue<int>();
+	sample.TempStats.Count = 0;
+
+	TelemetrySetEncoding(TelemetryEncoding::MSGPACK);
+	TEST_ASSERT_GREATER_THAN(0, TelemetrySerializeSamples(&sample, 1, Buffer_, sizeof(Buffer_)));
+	TEST_ASSERT_EQUAL_UINT8(7, static_cast<uint8_t>(Buffer_[9]));		// samples
+	for (int i = 10; i < 14; ++i) TEST_ASSERT_EQUAL_UINT8(0xc0, static_cast<uint8_t>(Buffer_[i]));	// co2, co2Min, co2Max, co2StdDev
+	TEST_ASSERT_EQUAL_UINT8(45, static_cast<uint8_t>(Buffer_[14]));	// humi
+	const int temp = 14 + 1 + 3 * 5;
+	TEST_ASSERT_EQUAL_UINT8(0xca, static_cast<uint8_t>(Buffer_[temp]));	// temp
+	for (int i = temp + 5; i < temp + 8; ++i) TEST_ASSERT_EQUAL_UINT8(0xc0, static_cast<uint8_t>(Buffer_[i]));
+	TEST_ASSERT_EQUAL_UINT8(0xca, static_cast<uint8_t>(Buffer_[temp + 8]));	// wbgt
+}
+
+static void test_msgpack_is_smaller()
+{
+	const int counts[] = { 1, TELEMETRY_BATCH_MAX };
+	for (int count : counts)
+	{
+		const int json = Serialize(TelemetryEncoding::JSON, count);
+		const int msgpack = Serialize(TelemetryEncoding::MSGPACK, count);
+		const double jsonTime = EncodeTime(TelemetryEncoding::JSON, count);
+		const double msgpackTime = EncodeTime(TelemetryEncoding::MSGPACK, count);
+
+		char message[120];
+		snprintf(message, sizeof(message), "%d sample(s): JSON %d bytes %.1f us, MessagePack %d bytes (%d%%) %.1f us", count, json, jsonTime, msgpack, msgpack * 100 / json, msgpackTime);
+		TEST_MESSAGE(message);
+
+		TEST_ASSERT_GREATER_THAN(0, json);
+		TEST_ASSERT_GREATER_THAN(0, msgpack);
+		TEST_ASSERT_LESS_THAN(json / 2, msgpack);		// キーを送らないので半分未満
+	}
+}
+
+// 最大バッチがどちらの形式でも送信バッファに収まる
+static void test_max_batch_fits_payload()
+{
+	TEST_ASSERT_GREATER_THAN(0, Serialize(TelemetryEncoding::JSON, TELEMETRY_BATCH_MAX));
+	TEST_ASSERT_LESS_THAN(TELEMETRY_PAYLOAD_MAX_SIZE, static_cast<int>(strlen(Buffer_)) + 1);
+	TEST_ASSERT_GREATER_THAN(0, Serialize(TelemetryEncoding::MSGPACK, TELEMETRY_BATCH_MAX));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_content_type);
+	RUN_TEST(test_msgpack_layout);
+	RUN_TEST(test_msgpack_missing_values);
+	RUN_TEST(test_msgpack_is_smaller);
+	RUN_TEST(test_max_batch_fits_payload);
+	return UNITY_END();
+}
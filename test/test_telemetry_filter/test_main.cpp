@@ -0,0 +1,153 @@
+#include <unity.h>
+
+#include <cmath>
+#include "TelemetryFilter.h"
+#include "Helper/Nullable.h"
+
+static const TelemetryStats NO_STATS{ 0, 0, 0, 0 };
+
+static TelemetrySample Sample(unsigned long time, int co2, float wbgt, const TelemetryStats& co2Stats = NO_STATS)
+{
+	TelemetrySample sample{};
+	sample.Time = time;
+	sample.Co2 = co2;
+	sample.Humi = NullableNullValue<int>();
+	sample.Temp = NullableNullValue<float>();
+	sample.Wbgt = wbgt;
+	sample.Co2Stats = co2Stats;
+	return sample;
+}
+
+void setUp()
+{
+	TelemetryFilterSetDeadband(TelemetryDeadband{ 20, 2, .2f, .2f });
+	TelemetryFilterSetHeartbeat(0);
+	TelemetryFilterReset();
+}
+
+void tearDown()
+{
+}
+
+static void test_first_sample_passes()
+{
+	TelemetrySample sample = Sample(0, 800, 20);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(800, sample.Co2);
+	TEST_ASSERT_EQUAL_FLOAT(20, sample.Wbgt);
+}
+
+// 最後に送った値から変化幅未満なら送らない(少しずつ動いても最後に送った値と比べる)
+static void test_deadband()
+{
+	TelemetrySample sample = Sample(0, 800, 20);
+	TelemetryFilterApply(&sample);
+
+	sample = Sample(15, 810, 20.1f);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_TRUE(NullableIsNull(sample.Co2));
+	TEST_ASSERT_TRUE(NullableIsNull(sample.Wbgt));
+
+	sample = Sample(30, 819, 20.1f);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+
+	sample = Sample(45, 820, 20.1f);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(820, sample.Co2);
+	TEST_ASSERT_TRUE(NullableIsNull(sample.Wbgt));
+
+	sample = Sample(60, 830, 20.1f);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+}
+
+// 変化幅未満でも、しきい値をまたいだら送る
+static void test_crossing_value()
+{
+	TelemetrySample sample = Sample(0, 990, 24.9f);
+	TelemetryFilterApply(&sample);
+
+	sample = Sample(15, 1000, 25.0f);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(1000, sample.Co2);
+	TEST_ASSERT_EQUAL_FLOAT(25.0f, sample.Wbgt);
+}
+
+// 平均が変わらなくても、区間の最大値がしきい値を越えたら送る
+static void test_crossing_max()
+{
+	TelemetrySample sample = Sample(0, 990, 20);
+	TelemetryFilterApply(&sample);
+
+	sample = Sample(15, 995, 20, TelemetryStats{ 5, 980, 1010, 10 });
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(995, sample.Co2);
+}
+
+// 区間の最小値がしきい値を下回ったときも送る
+static void test_crossing_min()
+{
+	TelemetrySample sample = Sample(0, 1010, 20);
+	TelemetryFilterApply(&sample);
+
+	sample = Sample(15, 1005, 20, TelemetryStats{ 5, 990, 1020, 10 });
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(1005, sample.Co2);
+
+	// またがなければ送らない
+	sample = Sample(30, 1005, 20, TelemetryStats{ 5, 1001, 1020, 10 });
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+}
+
+// 変わらなくても、最後に送ってからハートビートの間隔が過ぎたら送る
+static void test_heartbeat()
+{
+	TelemetryFilterSetHeartbeat(900);
+	TelemetrySample sample = Sample(1000, 800, 20);
+	TelemetryFilterApply(&sample);
+
+	sample = Sample(1000 + 899, 800, 20);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+
+	sample = Sample(1000 + 900, 800, 20);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(800, sample.Co2);
+	TEST_ASSERT_EQUAL_FLOAT(20, sample.Wbgt);
+
+	sample = Sample(1000 + 901, 800, 20);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+}
+
+static void test_reset_and_zero_deadband()
+{
+	TelemetrySample sample = Sample(0, 800, 20);
+	TelemetryFilterApply(&sample);
+
+	TelemetryFilterReset();
+	sample = Sample(15, 800, 20);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+
+	TelemetryFilterSetDeadband(TelemetryDeadband{ 0, 0, 0, 0 });
+	sample = Sample(30, 800, 20);
+	TEST_ASSERT_TRUE(TelemetryFilterApply(&sample));
+	TEST_ASSERT_EQUAL(800, sample.Co2);
+}
+
+static void test_null_is_not_sent()
+{
+	TelemetrySample sample = Sample(0, NullableNullValue<int>(), NAN);
+	TEST_ASSERT_FALSE(TelemetryFilterApply(&sample));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_first_sample_passes);
+	RUN_TEST(test_deadband);
+	RUN_TEST(test_crossing_value);
+	RUN_TEST(test_crossing_max);
+	RUN_TEST(test_crossing_min);
+	RUN_TEST(test_heartbeat);
+	RUN_TEST(test_reset_and_zero_deadband);
+	RUN_TEST(test_null_is_not_sent);
+	return UNITY_END();
+}
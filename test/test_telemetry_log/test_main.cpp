@@ -0,0 +1,224 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Config.h"
+#include "TelemetryLog.h"
+
+// ファイルをフラッシュに見立てる
+// 消去は0xffで埋め、書き込みは実機と同じく1→0にしか変えられない
+constexpr uint32_t FLASH_SECTOR_SIZE = 4096;
+constexpr size_t FLASH_SIZE = TELEMETRY_LOG_ADDRESS + TELEMETRY_LOG_SECTOR_NUMBER * FLASH_SECTOR_SIZE;
+constexpr int RECORD_SIZE = 32;
+constexpr int RECORD_NUMBER = TELEMETRY_LOG_SECTOR_NUMBER * FLASH_SECTOR_SIZE / RECORD_SIZE;
+
+static FILE* File_ = nullptr;
+static uint8_t* Flash_ = nullptr;
+static size_t ProgramLimit_ = SIZE_MAX;	// 書き込みをここで打ち切る(電源断の再現)
+static unsigned long EraseCount_ = 0;
+
+static const uint8_t* FileFlashRead(uint32_t address)
+{
+	return &Flash_[address];
+}
+
+static void FileFlashEraseSector(uint32_t address)
+{
+	memset(&Flash_[address / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE], 0xff, FLASH_SECTOR_SIZE);
+	++EraseCount_;
+}
+
+static void FileFlashProgram(uint32_t address, const void* data, size_t size)
+{
+	if (size > ProgramLimit_) size = ProgramLimit_;
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i) Flash_[address + i] &= src[i];
+}
+
+static const TelemetryLogFlash FileFlash = { FileFlashRead, FileFlashEraseSector, FileFlashProgram };
+
+static void MapFlash()
+{
+	Flash_ = static_cast<uint8_t*>(mmap(nullptr, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(File_), 0));
+	TEST_ASSERT_TRUE(Flash_ != MAP_FAILED);
+}
+
+// 電源を入れ直す(ファイルを開き直してログを読み込む)
+static void Reboot()
+{
+	msync(Flash_, FLASH_SIZE, MS_SYNC);
+	munmap(Flash_, FLASH_SIZE);
+	MapFlash();
+	TelemetryLogInit(FileFlash);
+}
+
+static TelemetrySample Sample(unsigned long time)
+{
+	TelemetrySample sample = TelemetrySample();
+	sample.Time = time;
+	sample.Co2 = 400 + static_cast<int>(time % 1000);
+	sample.Humi = 50;
+	sample.Temp = 25.5f;
+	sample.Wbgt = 22.0f;
+	return sample;
+}
+
+void setUp()
+{
+	File_ = tmpfile();
+	TEST_ASSERT_NOT_NULL(File_);
+	TEST_ASSERT_EQUAL(0, ftruncate(fileno(File_), FLASH_SIZE));
+	MapFlash();
+	memset(Flash_, 0xff, FLASH_SIZE);
+	ProgramLimit_ = SIZE_MAX;
+	EraseCount_ = 0;
+	TelemetryLogInit(FileFlash);
+}
+
+void tearDown()
+{
+	munmap(Flash_, FLASH_SIZE);
+	fclose(File_);
+}
+
+static void test_empty_log()
+{
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	TEST_ASSERT_EQUAL(0, TelemetryLogPendingCount());
+	TEST_ASSERT_EQUAL(0, TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX));
+}
+
+static void test_replay_in_order_after_reboot()
+{
+	for (unsigned long t = 1; t <= 25; ++t) TEST_ASSERT_TRUE(TelemetryLogAppend(Sample(t)));
+	Reboot();
+	TEST_ASSERT_EQUAL(25, TelemetryLogPendingCount());
+
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	unsigned long expected = 1;
+	int count;
+	while ((count = TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX)) > 0)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			TEST_ASSERT_EQUAL(expected, samples[i].Time);
+			TEST_ASSERT_EQUAL(Sample(expected).Co2, samples[i].Co2);
+			TEST_ASSERT_EQUAL_FLOAT(25.5f, samples[i].Temp);
+			TEST_ASSERT_EQUAL(0, samples[i].Co2Stats.Count);
+			++expected;
+		}
+		TelemetryLogMarkSent(count);
+	}
+	TEST_ASSERT_EQUAL(26, expected);
+	TEST_ASSERT_EQUAL(0, TelemetryLogPendingCount());
+}
+
+static void test_sent_flag_survives_reboot()
+{
+	for (unsigned long t = 1; t <= 10; ++t) TelemetryLogAppend(Sample(t));
+
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	TEST_ASSERT_EQUAL(4, TelemetryLogPeek(samples, 4));
+	TelemetryLogMarkSent(4);
+	Reboot();
+
+	TEST_ASSERT_EQUAL(6, TelemetryLogPendingCount());
+	TEST_ASSERT_EQUAL(6, TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX));
+	TEST_ASSERT_EQUAL(5, samples[0].Time);
+
+	// 新しいレコードは続きに書かれる
+	TelemetryLogAppend(Sample(11));
+	Reboot();
+	TEST_ASSERT_EQUAL(7, TelemetryLogPendingCount());
+}
+
+// 書き込み途中の電源断で壊れたレコードは読み飛ばす
+static void test_torn_record_is_skipped()
+{
+	for (unsigned long t = 1; t <= 3; ++t) TelemetryLogAppend(Sample(t));
+
+	ProgramLimit_ = RECORD_SIZE / 2;
+	TEST_ASSERT_FALSE(TelemetryLogAppend(Sample(4)));
+	ProgramLimit_ = SIZE_MAX;
+	Reboot();
+
+	TEST_ASSERT_EQUAL(3, TelemetryLogPendingCount());
+	TEST_ASSERT_TRUE(TelemetryLogAppend(Sample(5)));
+	Reboot();
+
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	TEST_ASSERT_EQUAL(4, TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX));
+	TEST_ASSERT_EQUAL(1, samples[0].Time);
+	TEST_ASSERT_EQUAL(3, samples[2].Time);
+	TEST_ASSERT_EQUAL(5, samples[3].Time);
+}
+
+// 一周したら最も古いセクタを消去して書き続ける
+static void test_wrap_drops_oldest_sector()
+{
+	constexpr int RECORDS_PER_SECTOR = FLASH_SECTOR_SIZE / RECORD_SIZE;
+	constexpr int EXTRA = RECORDS_PER_SECTOR + 72;
+
+	for (unsigned long t = 1; t <= RECORD_NUMBER + EXTRA; ++t) TEST_ASSERT_TRUE(TelemetryLogAppend(Sample(t)));
+
+	TEST_ASSERT_EQUAL(2 * RECORDS_PER_SECTOR, TelemetryLogDroppedCount());
+	TEST_ASSERT_EQUAL(RECORD_NUMBER + EXTRA - 2 * RECORDS_PER_SECTOR, TelemetryLogPendingCount());
+	TEST_ASSERT_EQUAL(TELEMETRY_LOG_SECTOR_NUMBER + 2, EraseCount_);
+
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	TEST_ASSERT_EQUAL(TELEMETRY_BATCH_MAX, TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX));
+	TEST_ASSERT_EQUAL(2 * RECORDS_PER_SECTOR + 1, samples[0].Time);
+
+	Reboot();
+	TEST_ASSERT_EQUAL(RECORD_NUMBER + EXTRA - 2 * RECORDS_PER_SECTOR, TelemetryLogPendingCount());
+	TEST_ASSERT_EQUAL(TELEMETRY_BATCH_MAX, TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX));
+	TEST_ASSERT_EQUAL(2 * RECORDS_PER_SECTOR + 1, samples[0].Time);
+
+	// 再起動後も最新のレコードの続きに書く
+	TEST_ASSERT_TRUE(TelemetryLogAppend(Sample(RECORD_NUMBER + EXTRA + 1)));
+	TEST_ASSERT_EQUAL(RECORD_NUMBER + EXTRA - 2 * RECORDS_PER_SECTOR + 1, TelemetryLogPendingCount());
+}
+
+static void test_benchmark_throughput()
+{
+	constexpr int COUNT = RECORD_NUMBER;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < COUNT; ++i) TelemetryLogAppend(Sample(i + 1));
+	const double appendTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / COUNT;
+
+	int replayed = 0;
+	TelemetrySample samples[TELEMETRY_BATCH_MAX];
+	start = std::chrono::steady_clock::now();
+	int count;
+	while ((count = TelemetryLogPeek(samples, TELEMETRY_BATCH_MAX)) > 0)
+	{
+		TelemetryLogMarkSent(count);
+		replayed += count;
+	}
+	const double replayTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / replayed;
+
+	start = std::chrono::steady_clock::now();
+	Reboot();
+	const double initTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	char message[120];
+	snprintf(message, sizeof(message), "append %.0f ns/record, replay %.0f ns/record, init %.0f us (%d records)", appendTime, replayTime, initTime, COUNT);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_EQUAL(COUNT, replayed);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_empty_log);
+	RUN_TEST(test_replay_in_order_after_reboot);
+	RUN_TEST(test_sent_flag_survives_reboot);
+	RUN_TEST(test_torn_record_is_skipped);
+	RUN_TEST(test_wrap_drops_oldest_sector);
+	RUN_TEST(test_benchmark_throughput);
+	return UNITY_END();
+}
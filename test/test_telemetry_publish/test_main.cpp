@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "Config.h"
+#include "Telemetry.h"
+#include "MeasureStub.h"
+
+// ヒープ確保の回数を数える
+static unsigned long AllocCount_ = 0;
+
+void* operator new(size_t size)
+{
+	++AllocCount_;
+	void* p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+// AziotHub::GetPublishBuffer()の代わり
+static char PublishBuffer_[TELEMETRY_PAYLOAD_MAX_SIZE];
+
+// 測定1区間分(SCD30の2秒間隔で15秒)
+static void PushInterval(int base)
+{
+	for (int i = 0; i < 7; ++i) MeasureStubPush(base + i, 40 + i % 3, 25.0f + i * 0.1f, 22.0f + i * 0.1f);
+}
+
+// main.cppのTelemetryTask()と同じ流れで1回分を処理し、送るなら書き出した長さを返す
+static int PublishCycle(unsigned long epochTime)
+{
+	PushInterval(800 + static_cast<int>(epochTime % 100));
+	TelemetryAdd(TelemetryCapture(epochTime));
+	if (!TelemetryIsFlushDue(epochTime)) return 0;
+
+	const int length = TelemetrySerialize(PublishBuffer_, sizeof(PublishBuffer_));
+	TelemetryClear();
+	return length;
+}
+
+void setUp()
+{
+	TelemetryClear();
+	TelemetrySetBatch(1, 0);
+	TelemetrySetEncoding(TelemetryEncoding::JSON);
+	MeasureStubSetAverage(600, 50, 24.0f, 21.0f);
+	MeasureTakeInterval();
+}
+
+void tearDown()
+{
+}
+
+static void test_capture_uses_interval_stats()
+{
+	MeasureStubPush(800, 40, 25.0f, 22.0f);
+	MeasureStubPush(803, 42, 26.0f, 23.0f);
+	const TelemetrySample sample = TelemetryCapture(1000);
+
+	TEST_ASSERT_EQUAL(1000, sample.Time);
+	TEST_ASSERT_EQUAL(802, sample.Co2);		// 801.5を丸める
+	TEST_ASSERT_EQUAL(2, sample.Co2Stats.Count);
+	TEST_ASSERT_EQUAL_FLOAT(800.0f, sample.Co2Stats.Min);
+	TEST_ASSERT_EQUAL_FLOAT(803.0f, sample.Co2Stats.Max);
+	TEST_ASSERT_EQUAL_FLOAT(25.5f, sample.Temp);
+	TEST_ASSERT_EQUAL_FLOAT(0.5f, sample.TempStats.StdDev);
+
+	// 区間内に測定値が無ければ移動平均
+	const TelemetrySample empty = TelemetryCapture(1015);
+	TEST_ASSERT_EQUAL(600, empty.Co2);
+	TEST_ASSERT_EQUAL(0, empty.Co2Stats.Count);
+	TEST_ASSERT_EQUAL_FLOAT(24.0f, empty.Temp);
+}
+
+static void test_single_sample_is_an_object()
+{
+	MeasureStubPush(800, 40, 25.0f, 22.0f);
+	TelemetryAdd(TelemetryCapture(1000));
+
+	const int length = TelemetrySerialize(PublishBuffer_, sizeof(PublishBuffer_));
+	TEST_ASSERT_GREATER_THAN(0, length);
+	TEST_ASSERT_EQUAL(static_cast<int>(strlen(PublishBuffer_)), length);
+	TEST_ASSERT_EQUAL('{', PublishBuffer_[0]);
+	TEST_ASSERT_NOT_NULL(strstr(PublishBuffer_, "\"co2\":800"));
+	TEST_ASSERT_NOT_NULL(strstr(PublishBuffer_, "\"samples\":1"));
+	TEST_ASSERT_NULL(strstr(PublishBuffer_, "\"ts\""));
+}
+
+static void test_batch_is_an_array_with_timestamps()
+{
+	TelemetrySetBatch(3, 0);
+	TEST_ASSERT_EQUAL(0, PublishCycle(1000));
+	TEST_ASSERT_EQUAL(0, PublishCycle(1015));
+	const int length = PublishCycle(1030);
+	TEST_ASSERT_GREATER_THAN(0, length);
+
+	TEST_ASSERT_EQUAL('[', PublishBuffer_[0]);
+	TEST_ASSERT_NOT_NULL(strstr(PublishBuffer_, "\"ts\":1000"));
+	TEST_ASSERT_NOT_NULL(strstr(PublishBuffer_, "\"ts\":1030"));
+}
+
+static void test_too_small_buffer_fails()
+{
+	PushInterval(800);
+	TelemetryAdd(TelemetryCapture(1000));
+
+	char small[16];
+	TEST_ASSERT_EQUAL(-1, TelemetrySerialize(small, sizeof(small)));
+	TelemetrySetEncoding(TelemetryEncoding::MSGPACK);
+	TEST_ASSERT_EQUAL(-1, TelemetrySerialize(small, sizeof(small)));
+}
+
+// 測定値の取得から書き出しまで、どの形式・バッチ数でもヒープを使わない
+static void test_publish_cycle_does_not_allocate()
+{
+	const TelemetryEncoding encodings[] = { TelemetryEncoding::JSON, TelemetryEncoding::MSGPACK };
+	const int batchSizes[] = { 1, TELEMETRY_BATCH_MAX };
+
+	for (TelemetryEncoding encoding : encodings)
+	{
+		for (int batchSize : batchSizes)
+		{
+			TelemetrySetEncoding(encoding);
+			TelemetrySetBatch(batchSize, 0);
+
+			int published = 0;
+			const unsigned long start = AllocCount_;
+			for (unsigned long t = 0; t < 100; ++t)
+			{
+				if (PublishCycle(1000 + t * 15) > 0) ++published;
+			}
+			const unsigned long allocs = AllocCount_ - start;
+
+			char message[100];
+			snprintf(message, sizeof(message), "%s batch %d: %d messages, %lu allocations", encoding == TelemetryEncoding::JSON ? "JSON" : "MessagePack", batchSize, published, allocs);
+			TEST_MESSAGE(message);
+			TEST_ASSERT_EQUAL(100 / batchSize, published);
+			TEST_ASSERT_EQUAL(0, allocs);
+		}
+	}
+}
+
+static void test_benchmark_publish_cycle()
+{
+	constexpr int COUNT = 20000;
+	const TelemetryEncoding encodings[] = { TelemetryEncoding::JSON, TelemetryEncoding::MSGPACK };
+
+	for (TelemetryEncoding encoding : encodings)
+	{
+		TelemetrySetEncoding(encoding);
+		TelemetrySetBatch(1, 0);
+
+		volatile int sink = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < COUNT; ++i) sink = sink + PublishCycle(1000 + i * 15);
+		const double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / COUNT;
+
+		char message[100];
+		snprintf(message, sizeof(message), "%s capture+serialize: %.0f ns/message", encoding == TelemetryEncoding::JSON ? "JSON" : "MessagePack", time);
+		TEST_MESSAGE(message);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_capture_uses_interval_stats);
+	RUN_TEST(test_single_sample_is_an_object);
+	RUN_TEST(test_batch_is_an_array_with_timestamps);
+	RUN_TEST(test_too_small_buffer_fails);
+	RUN_TEST(test_publish_cycle_does_not_allocate);
+	RUN_TEST(test_benchmark_publish_cycle);
+	return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <unity.h>
+
+#include <climits>
+#include "Helper/ToneSequencer.h"
+
+static ToneSequencer Sequencer_;
+
+// 出力の変化を記録する
+struct Change
+{
+	unsigned long Time;
+	int Frequency;
+};
+
+static Change Changes_[64];
+static int ChangeCount_;
+
+static void UpdateAt(unsigned long now)
+{
+	int frequency;
+	if (Sequencer_.Update(now, &frequency) && ChangeCount_ < static_cast<int>(sizeof(Changes_) / sizeof(Changes_[0])))
+	{
+		Changes_[ChangeCount_++] = Change{ now, frequency };
+	}
+}
+
+// 1msごとにUpdate()を呼ぶ
+static void RunFor(unsigned long start, unsigned long ms)
+{
+	for (unsigned long t = start; t != start + ms; ++t) UpdateAt(t);
+}
+
+void setUp()
+{
+	Sequencer_.Clear();
+	ChangeCount_ = 0;
+	int frequency;
+	Sequencer_.Update(0, &frequency);	// 出力を0に戻す
+}
+
+void tearDown()
+{
+}
+
+static void test_single_tone()
+{
+	TEST_ASSERT_TRUE(Sequencer_.Enqueue(1000, 100));
+	TEST_ASSERT_TRUE(Sequencer_.IsPlaying());
+
+	RunFor(10, 200);
+	TEST_ASSERT_EQUAL(2, ChangeCount_);
+	TEST_ASSERT_EQUAL(10, Changes_[0].Time);
+	TEST_ASSERT_EQUAL(1000, Changes_[0].Frequency);
+	TEST_ASSERT_EQUAL(110, Changes_[1].Time);
+	TEST_ASSERT_EQUAL(0, Changes_[1].Frequency);
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+}
+
+static void test_pattern_repeats()
+{
+	static const ToneStep pattern[] = { { 2000, 50 }, { 0, 50 } };
+	TEST_ASSERT_TRUE(Sequencer_.Enqueue(pattern, 2, 3));
+
+	RunFor(0, 400);
+	TEST_ASSERT_EQUAL(6, ChangeCount_);
+	for (int i = 0; i < 6; ++i)
+	{
+		TEST_ASSERT_EQUAL(static_cast<unsigned long>(i * 50), Changes_[i].Time);
+		TEST_ASSERT_EQUAL(i % 2 == 0 ? 2000 : 0, Changes_[i].Frequency);
+	}
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+}
+
+static void test_queue_plays_in_order()
+{
+	Sequencer_.Enqueue(1000, 100);
+	Sequencer_.Enqueue(1500, 100);
+	Sequencer_.Enqueue(2000, 100);
+
+	RunFor(0, 400);
+	TEST_ASSERT_EQUAL(4, ChangeCount_);
+	TEST_ASSERT_EQUAL(1000, Changes_[0].Frequency);
+	TEST_ASSERT_EQUAL(1500, Changes_[1].Frequency);
+	TEST_ASSERT_EQUAL(100, Changes_[1].Time);
+	TEST_ASSERT_EQUAL(2000, Changes_[2].Frequency);
+	TEST_ASSERT_EQUAL(200, Changes_[2].Time);
+	TEST_ASSERT_EQUAL(0, Changes_[3].Frequency);
+	TEST_ASSERT_EQUAL(300, Changes_[3].Time);
+}
+
+// Update()の呼び出しが遅れても、パターン内の切り替え時刻は前の音の終了時刻から数える
+static void test_late_update_keeps_timing()
+{
+	static const ToneStep pattern[] = { { 1000, 100 }, { 1500, 100 }, { 2000, 100 } };
+	Sequencer_.Enqueue(pattern, 3, 1);
+
+	UpdateAt(0);
+	UpdateAt(130);
+	UpdateAt(210);
+	TEST_ASSERT_EQUAL(3, ChangeCount_);
+	TEST_ASSERT_EQUAL(2000, Changes_[2].Frequency);
+
+	// 飛ばしたステップは出力を変えずに進む
+	UpdateAt(1000);
+	TEST_ASSERT_EQUAL(4, ChangeCount_);
+	TEST_ASSERT_EQUAL(0, Changes_[3].Frequency);
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+}
+
+static void test_infinite_repeat_until_clear()
+{
+	static const ToneStep alarm[] = { { 3000, 100 }, { 0, 100 } };
+	Sequencer_.Enqueue(alarm, 2, 0);
+
+	RunFor(0, 10000);
+	TEST_ASSERT_TRUE(Sequencer_.IsPlaying());
+
+	Sequencer_.Clear();
+	UpdateAt(10000);
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+	TEST_ASSERT_EQUAL(0, Changes_[ChangeCount_ - 1].Frequency);
+}
+
+static void test_rejects_invalid_patterns()
+{
+	static const ToneStep silent[] = { { 1000, 0 }, { 0, 0 } };
+	TEST_ASSERT_FALSE(Sequencer_.Enqueue(silent, 2, 0));
+	TEST_ASSERT_FALSE(Sequencer_.Enqueue(nullptr, 1, 1));
+	TEST_ASSERT_FALSE(Sequencer_.Enqueue(silent, 0, 1));
+	TEST_ASSERT_FALSE(Sequencer_.Enqueue(1000, 0));
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+}
+
+static void test_queue_limit()
+{
+	for (int i = 0; i < TONE_SEQUENCER_QUEUE_MAX; ++i) TEST_ASSERT_TRUE(Sequencer_.Enqueue(1000, 10));
+	TEST_ASSERT_FALSE(Sequencer_.Enqueue(1000, 10));
+
+	RunFor(0, 10 * TONE_SEQUENCER_QUEUE_MAX + 1);
+	TEST_ASSERT_FALSE(Sequencer_.IsPlaying());
+	TEST_ASSERT_TRUE(Sequencer_.Enqueue(1000, 10));
+}
+
+static void test_millis_wraparound()
+{
+	Sequencer_.Enqueue(1000, 100);
+
+	RunFor(ULONG_MAX - 49, 200);
+	TEST_ASSERT_EQUAL(2, ChangeCount_);
+	TEST_ASSERT_EQUAL(50, Changes_[1].Time);
+	TEST_ASSERT_EQUAL(0, Changes_[1].Frequency);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_single_tone);
+	RUN_TEST(test_pattern_repeats);
+	RUN_TEST(test_queue_plays_in_order);
+	RUN_TEST(test_late_update_keeps_timing);
+	RUN_TEST(test_infinite_repeat_until_clear);
+	RUN_TEST(test_rejects_invalid_patterns);
+	RUN_TEST(test_queue_limit);
+	RUN_TEST(test_millis_wraparound);
+	return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+
+#include <cstring>
+#include <ArduinoJson.h>
+#include "Config.h"
+#include "Storage.h"
+#include "TwinProperty.h"
+
+static int Interval_;
+static float Offset_;
+static int Count_;
+
+static const TwinPropertyDef Defs_[] =
+{
+	{ "Interval", TwinPropertyType::INT  , 1, 3600, 15  , [](float value) { Interval_ = value; } },
+	{ "Offset"  , TwinPropertyType::FLOAT, -10, 10, 2.2f, [](float value) { Offset_ = value; } },
+	{ "Count"   , TwinPropertyType::INT  , 1, 30, 5     , [](float value) { Count_ = value; } },
+};
+constexpr int DEF_COUNT = sizeof(Defs_) / sizeof(Defs_[0]);
+
+// 受信バッファ(PubSubClientのバッファの代わり)
+static char Buffer_[256];
+
+struct Ack
+{
+	const char* Name;
+	float Value;
+	int AckCode;
+};
+static Ack Acks_[TWIN_PROPERTY_MAX];
+static int AckCount_;
+static int ConfirmCalls_;
+static int AckVersion_;
+
+// 実機ではackの送信で受信バッファが上書きされる
+static void Confirm(const TwinPropertyAck* acks, int count, int ackVersion)
+{
+	++ConfirmCalls_;
+	AckVersion_ = ackVersion;
+	for (int i = 0; i < count && AckCount_ < TWIN_PROPERTY_MAX; ++i) Acks_[AckCount_++] = Ack{ acks[i].Def->Name, acks[i].Value, acks[i].AckCode };
+	memset(Buffer_, 'x', sizeof(Buffer_));
+}
+
+static const Ack* FindAck(const char* name)
+{
+	for (int i = 0; i < AckCount_; ++i)
+	{
+		if (strcmp(Acks_[i].Name, name) == 0) return &Acks_[i];
+	}
+	return nullptr;
+}
+
+// 受信バッファの上で解析して渡す(main.cppのReceivedTwinDesiredPatch()と同じ)
+static void ReceivePatch(const char* json, bool confirmAll)
+{
+	const size_t length = strlen(json);
+	memcpy(Buffer_, json, length);
+
+	StaticJsonDocument<JSON_MAX_SIZE> doc;
+	TEST_ASSERT_FALSE(deserializeJson(doc, Buffer_, length));
+	TwinPropertyReceived(doc.as<JsonVariant>(), confirmAll, doc["$version"].as<int>());
+}
+
+void setUp()
+{
+	Storage::Properties.clear();
+	AckCount_ = 0;
+	ConfirmCalls_ = 0;
+	TwinPropertyInit(Defs_, DEF_COUNT, Confirm);
+	TwinPropertyRestore();
+}
+
+void tearDown()
+{
+}
+
+static void test_defaults_applied()
+{
+	TEST_ASSERT_EQUAL(15, Interval_);
+	TEST_ASSERT_EQUAL_FLOAT(2.2f, Offset_);
+	TEST_ASSERT_EQUAL(5, Count_);
+}
+
+// ackの送信で受信バッファが上書きされても、全ての項目を読んでから送るので取りこぼさない
+static void test_patch_applied_before_confirm()
+{
+	ReceivePatch("{\"Interval\":60,\"Offset\":-1.5,\"Count\":10,\"$version\":7}", false);
+
+	TEST_ASSERT_EQUAL(60, Interval_);
+	TEST_ASSERT_EQUAL_FLOAT(-1.5f, Offset_);
+	TEST_ASSERT_EQUAL(10, Count_);
+
+	TEST_ASSERT_EQUAL(1, ConfirmCalls_);
+	TEST_ASSERT_EQUAL(7, AckVersion_);
+	TEST_ASSERT_EQUAL(3, AckCount_);
+	TEST_ASSERT_EQUAL_FLOAT(60.0f, FindAck("Interval")->Value);
+	TEST_ASSERT_EQUAL_FLOAT(-1.5f, FindAck("Offset")->Value);
+	TEST_ASSERT_EQUAL_FLOAT(10.0f, FindAck("Count")->Value);
+	for (int i = 0; i < AckCount_; ++i) TEST_ASSERT_EQUAL(200, Acks_[i].AckCode);
+}
+
+// 範囲外や整数でない値は適用せず、現在値を400で返す
+static void test_invalid_values_rejected()
+{
+	ReceivePatch("{\"Interval\":0,\"Offset\":3,\"Count\":2.5,\"$version\":8}", false);
+
+	TEST_ASSERT_EQUAL(15, Interval_);
+	TEST_ASSERT_EQUAL_FLOAT(3.0f, Offset_);
+	TEST_ASSERT_EQUAL(5, Count_);
+
+	TEST_ASSERT_EQUAL(3, AckCount_);
+	TEST_ASSERT_EQUAL(400, FindAck("Interval")->AckCode);
+	TEST_ASSERT_EQUAL_FLOAT(15.0f, FindAck("Interval")->Value);
+	TEST_ASSERT_EQUAL(200, FindAck("Offset")->AckCode);
+	TEST_ASSERT_EQUAL(400, FindAck("Count")->AckCode);
+	TEST_ASSERT_EQUAL_FLOAT(5.0f, FindAck("Count")->Value);
+}
+
+// ツインのドキュメント全体を受け取ったら、含まれていない項目も現在値を返す
+static void test_document_confirms_all()
+{
+	ReceivePatch("{\"Count\":20,\"$version\":9}", true);
+
+	TEST_ASSERT_EQUAL(20, Count_);
+	TEST_ASSERT_EQUAL(1, ConfirmCalls_);
+	TEST_ASSERT_EQUAL(DEF_COUNT, AckCount_);
+	TEST_ASSERT_EQUAL_FLOAT(15.0f, FindAck("Interval")->Value);
+	TEST_ASSERT_EQUAL_FLOAT(20.0f, FindAck("Count")->Value);
+
+	// 差分の通知では含まれている項目だけ
+	AckCount_ = 0;
+	ReceivePatch("{\"Interval\":30,\"$version\":10}", false);
+	TEST_ASSERT_EQUAL(1, AckCount_);
+	TEST_ASSERT_EQUAL_STRING("Interval", Acks_[0].Name);
+
+	// 何も含まれていなければ送らない
+	ConfirmCalls_ = 0;
+	ReceivePatch("{\"Unknown\":1,\"$version\":11}", false);
+	TEST_ASSERT_EQUAL(0, ConfirmCalls_);
+}
+
+// 変更した値は保存され、次の起動で適用される(保存値が範囲外なら既定値)
+static void test_restore_saved_values()
+{
+	ReceivePatch("{\"Interval\":120,\"Offset\":0.5,\"$version\":12}", false);
+	TEST_ASSERT_FALSE(Storage::Properties.empty());
+
+	TwinPropertyInit(Defs_, DEF_COUNT, Confirm);
+	TwinPropertyRestore();
+	TEST_ASSERT_EQUAL(120, Interval_);
+	TEST_ASSERT_EQUAL_FLOAT(0.5f, Offset_);
+	TEST_ASSERT_EQUAL(5, Count_);
+
+	Storage::Properties = "{\"Interval\":99999,\"Offset\":1}";
+	TwinPropertyRestore();
+	TEST_ASSERT_EQUAL(15, Interval_);
+	TEST_ASSERT_EQUAL_FLOAT(1.0f, Offset_);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_defaults_applied);
+	RUN_TEST(test_patch_applied_before_confirm);
+	RUN_TEST(test_invalid_values_rejected);
+	RUN_TEST(test_document_confirms_all);
+	RUN_TEST(test_restore_saved_values);
+	return UNITY_END();
+}